@@ -14,19 +14,37 @@ struct Rect {
     uvec2 extent;
 };
 
+// voxel_ratio, model_dim and emission_coeff are not read from here, but from the specialization
+// constants below. They remain in the uniform buffer so that its layout matches ShaderParameters.
 struct RenderParameters {
     vec4 voxel_ratio;
     uvec4 model_dim;
     float emission_coeff;
+    float absorption_coeff;
+    float termination_threshold;
+    uint composite;
+    float lod_bias;
 };
 
-layout(local_size_x = 8, local_size_y = 8) in;
+// The workgroup size and the parameters that the traversal reads in its inner loops are specialization
+// constants, so that the driver can fold them into the shader. Their ids must match SpecializationData
+// in Renderer.cpp.
+layout(local_size_x_id = 0, local_size_y_id = 1) in;
 
-layout(push_constant) uniform PushConstant {
-    Camera camera;
-} push;
+layout(constant_id = 2) const float VOXEL_RATIO_X = 1.0;
+layout(constant_id = 3) const float VOXEL_RATIO_Y = 1.0;
+layout(constant_id = 4) const float VOXEL_RATIO_Z = 1.0;
+layout(constant_id = 5) const uint MODEL_DIM_X = 1u;
+layout(constant_id = 6) const uint MODEL_DIM_Y = 1u;
+layout(constant_id = 7) const uint MODEL_DIM_Z = 1u;
+layout(constant_id = 8) const float EMISSION_COEFF = 1.0;
+
+const vec3 VOXEL_RATIO = vec3(VOXEL_RATIO_X, VOXEL_RATIO_Y, VOXEL_RATIO_Z);
+const uvec3 MODEL_DIM = uvec3(MODEL_DIM_X, MODEL_DIM_Y, MODEL_DIM_Z);
 
+// The camera is updated every frame, the rest only when the display is resized
 layout(binding = 0) readonly uniform UniformBuffer {
+    Camera camera;
     Rect output_region;
     Rect display_region;
     RenderParameters params;
@@ -46,13 +64,13 @@ vec3 ray(vec2 uv) {
     uv -= 0.5;
     uv.y *= float(uniforms.display_region.extent.y) / float(uniforms.display_region.extent.x);
 
-    vec3 dir = push.camera.forward.xyz;
-    vec3 up = push.camera.up.xyz;
+    vec3 dir = uniforms.camera.forward.xyz;
+    vec3 up = uniforms.camera.up.xyz;
     vec3 right = normalize(cross(up, dir));
     up = normalize(cross(right, dir));
 
     vec3 rd = normalize(uv.x * right + uv.y * up + dir);
-    return adjust_ray(normalize(rd / uniforms.params.voxel_ratio.xyz));
+    return adjust_ray(normalize(rd / VOXEL_RATIO));
 }
 
 float min_elem(vec3 v) {
@@ -63,12 +81,52 @@ float max_elem(vec3 v) {
     return max(v.x, max(v.y, v.z));
 }
 
+// The amount a ray is stretched by the voxel ratio
+float ray_stretch(vec3 rd) {
+    vec3 rd2 = rd * rd;
+    vec3 dim2 = VOXEL_RATIO * VOXEL_RATIO;
+    return sqrt(dot(rd2, dim2) / dot(rd2, vec3(1)));
+}
+
 // Calculate the emission coefficient of a voxel for some ray. The user-supplied
 // base emission coefficient is multiplied by the amount the ray is stretched
 float voxel_emission_coeff(vec3 rd) {
-    vec3 rd2 = rd * rd;
-    vec3 dim2 = uniforms.params.voxel_ratio.xyz * uniforms.params.voxel_ratio.xyz;
-    return uniforms.params.emission_coeff * sqrt(dot(rd2, dim2) / dot(rd2, vec3(1)));
+    return EMISSION_COEFF * ray_stretch(rd);
+}
+
+// Calculate the absorption coefficient of a fully opaque voxel for some ray, per unit of
+// ray length in which the model has side 1.
+float voxel_absorption_coeff(vec3 rd) {
+    return uniforms.params.absorption_coeff * ray_stretch(rd);
+}
+
+// The side below which octree nodes are not descended into at distance t along a ray: a node of this
+// side covers about lod_bias pixels. Nodes smaller than this are rendered with their average color.
+// Returns 0 when level of detail is disabled, so that every node is descended into.
+float lod_side(float t) {
+    return max(t, 0) * uniforms.params.lod_bias / float(uniforms.display_region.extent.x);
+}
+
+// Accumulate the contribution of a segment of length dt through a voxel along a ray. By default, the
+// emission (voxel.rgb) of all segments is summed. In composite mode, segments are composited front to
+// back: the voxel absorbs light proportional to voxel.a * absorption, and the emission of the segment
+// is attenuated by the transmittance of the ray so far. Returns true when the transmittance dropped
+// below the termination threshold, after which the ray can be terminated.
+bool accumulate(inout vec3 total, inout float transmittance, vec4 voxel, float dt, float absorption) {
+    if (uniforms.params.composite == 0) {
+        total += voxel.rgb * dt;
+        return false;
+    }
+
+    float sigma = voxel.a * absorption;
+    float segment_transmittance = exp(-sigma * dt);
+
+    // Emission integrated over the segment, which reduces to dt for transparent voxels
+    float weight = sigma > 0 ? (1 - segment_transmittance) / sigma : dt;
+
+    total += voxel.rgb * (transmittance * weight);
+    transmittance *= segment_transmittance;
+    return transmittance < uniforms.params.termination_threshold;
 }
 
 #endif
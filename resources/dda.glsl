@@ -0,0 +1,138 @@
+#ifndef _XENODON_DDA_GLSL
+#define _XENODON_DDA_GLSL
+
+// Implementation of 'A Fast Voxel Traversal Algorithm for Ray Tracing' by Amanatides & Woo
+// Rays leap over empty blocks of voxels using the occupancy grid.
+// The including shader is required to declare the 'model' sampler, and to define
+// vec4 get_voxel(ivec3 p), which returns the emission color (rgb) and opacity (a) of the voxel at
+// the given position.
+
+// Blocks of OCCUPANCY_BLOCK_SIDE^3 voxels which are neither emissive nor (in composite mode) absorbent
+// according to the occupancy grid contribute nothing, and are leapt over in one go.
+layout(binding = 4) uniform usampler3D occupancy;
+
+const int OCCUPANCY_BLOCK_SIDE = 8;
+const uint OCCUPANCY_EMISSIVE = 1;
+const uint OCCUPANCY_ABSORBENT = 2;
+
+// Distance along the ray to the far side of the voxel at p, for each axis. This is computed from the
+// voxel position instead of incrementally, so that leaping over a block results in exactly the same
+// distances as stepping through it voxel by voxel. This keeps the output independent of the occupancy grid.
+vec3 side_distance(ivec3 p, vec3 ro, vec3 far_side, vec3 t_delta) {
+    // Precise prevents the compiler from evaluating this differently at each call site
+    precise vec3 dist = abs(vec3(p) + far_side - ro) * t_delta;
+    return dist;
+}
+
+// Find the voxel where the traversal continues after crossing the far side of the block at t_exit: each axis
+// is advanced until the far side of the voxel along that axis is crossed after t_exit.
+ivec3 leap(ivec3 pos, ivec3 step, vec3 ro, vec3 rd, vec3 far_side, vec3 t_delta, float t_exit) {
+    ivec3 q = ivec3(floor(ro + rd * t_exit));
+
+    // Never step backwards, and the estimate is at most one voxel off
+    q = pos + step * max((q - pos) * step, ivec3(0));
+
+    for (int i = 0; i < 2; ++i) {
+        bvec3 crossed = lessThanEqual(side_distance(q, ro, far_side, t_delta), vec3(t_exit));
+        q += mix(ivec3(0), step, crossed);
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        bvec3 not_crossed = greaterThan(side_distance(q - step, ro, far_side, t_delta), vec3(t_exit));
+        bvec3 advanced = greaterThan((q - pos) * step, ivec3(0));
+        q -= step * ivec3(not_crossed) * ivec3(advanced);
+    }
+
+    return q;
+}
+
+vec3 trace(vec3 ro, vec3 rd, float absorption) {
+    vec3 rrd = 1.0 / rd;
+    vec3 bias = rrd * ro;
+
+    vec3 box_min = -bias;
+    vec3 box_max = MODEL_DIM * rrd - bias;
+
+    float t_min = max_elem(min(box_min, box_max));
+    float t_max = min_elem(max(box_min, box_max));
+
+    if (t_min > t_max) {
+        // Ray misses bounding cube
+        return vec3(0);
+    }
+
+    t_min = max(t_min, 0);
+
+    ro += rd * t_min;
+    ivec3 pos = ivec3(ro);
+    ivec3 dim = ivec3(MODEL_DIM);
+
+    vec3 t_delta = abs(rrd);
+    ivec3 step = ivec3(sign(rd));
+    vec3 far_side = vec3(greaterThanEqual(rd, vec3(0)));
+    ivec3 far_voxel = ivec3(far_side) * (OCCUPANCY_BLOCK_SIDE - 1);
+    vec3 side_dist = side_distance(pos, ro, far_side, t_delta);
+
+    uint occupied_mask = uniforms.params.composite != 0 ?
+        OCCUPANCY_EMISSIVE | OCCUPANCY_ABSORBENT :
+        OCCUPANCY_EMISSIVE;
+
+    float t = 0;
+
+    vec3 total = vec3(0);
+    float transmittance = 1;
+    while (t < t_max - t_min) {
+        if (all(greaterThanEqual(pos, ivec3(0))) && all(lessThan(pos, dim))) {
+            ivec3 block = pos / OCCUPANCY_BLOCK_SIDE;
+
+            if ((texelFetch(occupancy, block, 0).r & occupied_mask) == 0) {
+                // The voxels of the block on its far side, which is limited to the model
+                ivec3 last = min(block * OCCUPANCY_BLOCK_SIDE + far_voxel, dim - 1);
+                float t_exit = min_elem(side_distance(last, ro, far_side, t_delta));
+
+                pos = leap(pos, step, ro, rd, far_side, t_delta, t_exit);
+                side_dist = side_distance(pos, ro, far_side, t_delta);
+                t = t_exit;
+                continue;
+            }
+        }
+
+        bvec3 mask = lessThanEqual(side_dist.xyz, min(side_dist.yzx, side_dist.zxy));
+
+        float t0 = min_elem(side_dist);
+        bool saturated = accumulate(total, transmittance, get_voxel(pos), t0 - t, absorption);
+        t = t0;
+
+        if (saturated) {
+            break;
+        }
+
+        pos += mix(ivec3(0), step, mask);
+        side_dist = side_distance(pos, ro, far_side, t_delta);
+    }
+
+    return total;
+}
+
+void main() {
+    uvec2 index = gl_GlobalInvocationID.xy;
+
+    if (any(greaterThanEqual(index, uniforms.output_region.extent))) {
+        return;
+    }
+
+    ivec2 pixel = uniforms.output_region.offset + ivec2(index);
+    vec2 uv = vec2(pixel - uniforms.display_region.offset) / vec2(uniforms.display_region.extent);
+
+    float side = max_elem(vec3(textureSize(model, 0)));
+    vec3 ro = uniforms.camera.translation.xyz * side;
+    vec3 rd = ray(uv);
+
+    float ec = voxel_emission_coeff(rd) / side;
+    float ac = voxel_absorption_coeff(rd) / side;
+    vec3 color = trace(ro, rd, ac) * ec;
+
+    imageStore(render_target, ivec2(index), vec4(color, 1));
+}
+
+#endif
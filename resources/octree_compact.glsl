@@ -0,0 +1,19 @@
+#ifndef _XENODON_OCTREE_COMPACT_GLSL
+#define _XENODON_OCTREE_COMPACT_GLSL
+
+// Define structures, bindings and constants for raytracing shaders of compact octrees,
+// see CompactOctree
+
+struct Node {
+    uint first_child;
+    uint color;
+};
+
+layout(binding = 2) readonly buffer Octree {
+    Node nodes[];
+} model;
+
+const uint LEAF_MASK = 1 << 31;
+const uint CHILD_MASK = 0x7FFFFFFF;
+
+#endif
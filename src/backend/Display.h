@@ -15,6 +15,9 @@ struct Display {
     virtual Output* output(size_t device_index, size_t output_index) = 0;
     virtual void swap_buffers() = 0;
     virtual void poll_events() = 0;
+
+    // Wait until all frames passed to swap_buffers have been presented (or saved, for offscreen displays).
+    virtual void finish() = 0;
 };
 
 #endif
@@ -4,17 +4,15 @@ SwapImage::SwapImage(const Swapchain::SwapImageResources& resources):
     image(resources.image),
     view(resources.view.get()),
     image_acquired(resources.image_acquired.get()),
-    render_finished(resources.render_finished.get()),
-    frame_fence(resources.frame_fence.get()) {
+    render_finished(resources.render_finished.get()) {
 }
 
-SwapImage::SwapImage(vk::Image image, vk::ImageView view, vk::Fence frame_fence):
+SwapImage::SwapImage(vk::Image image, vk::ImageView view):
     image(image),
-    view(view),
-    frame_fence(frame_fence) {
+    view(view) {
 }
 
-void SwapImage::submit(Queue queue, vk::CommandBuffer cmd_buf, vk::PipelineStageFlags flags) const {
+void SwapImage::submit(Queue queue, vk::CommandBuffer cmd_buf, vk::Fence fence, vk::PipelineStageFlags flags) const {
     auto submit_info = vk::SubmitInfo(
         static_cast<uint32_t>(this->image_acquired != vk::Semaphore()),
         &this->image_acquired,
@@ -25,5 +23,5 @@ void SwapImage::submit(Queue queue, vk::CommandBuffer cmd_buf, vk::PipelineStage
         &this->render_finished
     );
 
-    queue->submit(1, &submit_info, this->frame_fence);
+    queue->submit(1, &submit_info, fence);
 }
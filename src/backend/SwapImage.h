@@ -10,11 +10,12 @@ struct SwapImage {
     vk::ImageView view;
     vk::Semaphore image_acquired;
     vk::Semaphore render_finished;
-    vk::Fence frame_fence;
 
     SwapImage(const Swapchain::SwapImageResources& resources);
-    SwapImage(vk::Image image, vk::ImageView view, vk::Fence frame_fence = vk::Fence());
-    void submit(Queue queue, vk::CommandBuffer cmd_buf, vk::PipelineStageFlags flags = vk::PipelineStageFlagBits::eColorAttachmentOutput) const;
+    SwapImage(vk::Image image, vk::ImageView view);
+
+    // Submit the commands which render to this image. `fence` is signaled once they finished, if not null.
+    void submit(Queue queue, vk::CommandBuffer cmd_buf, vk::Fence fence, vk::PipelineStageFlags flags = vk::PipelineStageFlagBits::eColorAttachmentOutput) const;
 };
 
 #endif
@@ -66,3 +66,9 @@ void DirectDisplay::swap_buffers()  {
 void DirectDisplay::poll_events() {
     this->input.poll_events();
 }
+
+void DirectDisplay::finish() {
+    for (auto& screen_group : this->screen_groups) {
+        screen_group->render_device().device->waitIdle();
+    }
+}
@@ -27,6 +27,7 @@ public:
     Output* output(size_t device_index, size_t output_index) override;
     void swap_buffers() override;
     void poll_events() override;
+    void finish() override;
 };
 
 #endif
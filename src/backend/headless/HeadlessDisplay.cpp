@@ -1,10 +1,8 @@
 #include "backend/headless/HeadlessDisplay.h"
 #include <vector>
 #include <cassert>
-#include <fmt/format.h>
-#include <lodepng.h>
 #include "core/Logger.h"
-#include "core/Error.h"
+#include "backend/headless/png.h"
 #include "utility/rect_union.h"
 
 namespace {
@@ -14,7 +12,8 @@ namespace {
 HeadlessDisplay::HeadlessDisplay(const HeadlessConfig& config, std::string_view out_path):
     instance(nullptr),
     out_path(out_path),
-    frame(0) {
+    frame(0),
+    saved_frames(0) {
 
     auto gpus = this->instance.physical_devices();
     this->outputs.reserve(config.gpus.size());
@@ -37,17 +36,14 @@ Output* HeadlessDisplay::output(size_t device_index, size_t output_index) {
 }
 
 void HeadlessDisplay::swap_buffers() {
-    for (const auto& output : this->outputs) {
-        output.synchronize();
+    for (auto& output : this->outputs) {
+        output.present();
     }
 
-    if (!this->out_path.empty()) {
-        try {
-            auto path = fmt::format(this->out_path, this->frame);
-            this->save(path);
-        } catch (const fmt::format_error& e) {
-            throw Error("Failed to format output filename: {}", e.what());
-        }
+    // Instead of waiting for this frame, the previous frame is saved while the GPU renders this one.
+    // It may already have been finished by finish(), whose fence must then not be waited on again.
+    if (this->saved_frames < this->frame) {
+        this->finish_frame(this->frame - 1);
     }
 
     ++this->frame;
@@ -56,12 +52,30 @@ void HeadlessDisplay::swap_buffers() {
 void HeadlessDisplay::poll_events() {
 }
 
-void HeadlessDisplay::save(const std::filesystem::path& path) {
+void HeadlessDisplay::finish() {
+    if (this->saved_frames < this->frame) {
+        this->finish_frame(this->frame - 1);
+    }
+}
+
+void HeadlessDisplay::finish_frame(size_t frame) {
+    for (auto& output : this->outputs) {
+        output.synchronize(static_cast<uint32_t>(frame % output.num_swap_images()));
+    }
+
+    if (!this->out_path.empty()) {
+        this->save(frame);
+    }
+
+    this->saved_frames = frame + 1;
+}
+
+void HeadlessDisplay::save(size_t frame) {
     vk::Rect2D enclosing = rect_union(this->outputs.begin(), this->outputs.end(), [](HeadlessOutput& output){
         return output.region();
     });
 
-    LOGGER.log("Saving frame {}...", this->frame);
+    LOGGER.log("Saving frame {}...", frame);
 
     auto image = std::vector<Pixel>(enclosing.extent.width * enclosing.extent.height, BLACK_PIXEL);
     size_t stride = enclosing.extent.width;
@@ -72,21 +86,8 @@ void HeadlessDisplay::save(const std::filesystem::path& path) {
         size_t start_y = static_cast<size_t>(region.offset.y - enclosing.offset.y);
 
         size_t offset = start_y * stride + start_x;
-        output.download(image.data() + offset, stride);
+        output.download(static_cast<uint32_t>(frame % output.num_swap_images()), image.data() + offset, stride);
     }
 
-    LOGGER.log("Compressing...");
-
-    unsigned error = lodepng::encode(
-        path.c_str(),
-        reinterpret_cast<const unsigned char*>(image.data()),
-        enclosing.extent.width,
-        enclosing.extent.height
-    );
-
-    if (error) {
-        LOGGER.log("Error saving output: {}", lodepng_error_text(error));
-    } else {
-        LOGGER.log("Saved output to '{}'", path.native());
-    }
+    save_png(format_frame_path(this->out_path, frame), image.data(), enclosing.extent.width, enclosing.extent.height);
 }
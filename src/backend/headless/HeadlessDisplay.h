@@ -20,6 +20,9 @@ class HeadlessDisplay final: public Display {
     std::string out_path;
     size_t frame;
 
+    // Frames are saved one frame late, see swap_buffers
+    size_t saved_frames;
+
 public:
     HeadlessDisplay(const HeadlessConfig& config, std::string_view out_path);
 
@@ -28,9 +31,11 @@ public:
     Output* output(size_t device_index, size_t output_index) override;
     void swap_buffers() override;
     void poll_events() override;
+    void finish() override;
 
 private:
-    void save(const std::filesystem::path& path);
+    void finish_frame(size_t frame);
+    void save(size_t frame);
 };
 
 #endif
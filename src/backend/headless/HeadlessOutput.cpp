@@ -5,6 +5,9 @@
 #include "graphics/memory/Buffer.h"
 
 namespace {
+    // One frame is downloaded while the next is rendered
+    constexpr const uint32_t RENDER_TARGETS = 2;
+
     constexpr const auto RENDER_TARGET_FORMAT = vk::Format::eR8G8B8A8Unorm;
 
     const vk::ImageUsageFlags RENDER_TARGET_USAGE = vk::ImageUsageFlagBits::eColorAttachment
@@ -38,8 +41,7 @@ namespace {
 HeadlessOutput::HeadlessOutput(const PhysicalDevice& physdev, vk::Rect2D render_region):
     render_region(render_region),
     rendev(create_render_device(physdev)),
-    frame_fence(this->rendev.device->createFenceUnique({})),
-    render_target(this->rendev.device, render_region.extent, RENDER_TARGET_FORMAT, RENDER_TARGET_USAGE) {
+    current_target(0) {
 
     auto sub_resource_range = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
 
@@ -50,29 +52,40 @@ HeadlessOutput::HeadlessOutput(const PhysicalDevice& physdev, vk::Rect2D render_
         vk::ComponentSwizzle::eA
     );
 
-    auto view_create_info = vk::ImageViewCreateInfo(
-        {},
-        this->render_target.get(),
-        vk::ImageViewType::e2D,
-        RENDER_TARGET_FORMAT,
-        component_mapping,
-        sub_resource_range
-    );
+    this->render_targets.reserve(RENDER_TARGETS);
+    for (uint32_t i = 0; i < RENDER_TARGETS; ++i) {
+        auto image = Image(this->rendev.device, render_region.extent, RENDER_TARGET_FORMAT, RENDER_TARGET_USAGE);
+
+        auto view_create_info = vk::ImageViewCreateInfo(
+            {},
+            image.get(),
+            vk::ImageViewType::e2D,
+            RENDER_TARGET_FORMAT,
+            component_mapping,
+            sub_resource_range
+        );
+
+        auto view = this->rendev.device->createImageViewUnique(view_create_info);
 
-    this->render_target_view = this->rendev.device->createImageViewUnique(view_create_info);
+        this->render_targets.push_back({
+            std::move(image),
+            std::move(view),
+            this->rendev.device->createFenceUnique({})
+        });
+    }
 }
 
 uint32_t HeadlessOutput::num_swap_images() const {
-    return 1;
+    return RENDER_TARGETS;
 }
 
 uint32_t HeadlessOutput::current_swap_index() const {
-    return 0;
+    return this->current_target;
 }
 
 SwapImage HeadlessOutput::swap_image(uint32_t index) {
-    assert(index == 0);
-    return SwapImage(this->render_target.get(), this->render_target_view.get(), this->frame_fence.get());
+    const auto& target = this->render_targets[index];
+    return SwapImage(target.image.get(), target.view.get());
 }
 
 vk::Rect2D HeadlessOutput::region() const {
@@ -87,12 +100,19 @@ vk::AttachmentDescription HeadlessOutput::color_attachment_descr() const {
     return descr;
 }
 
-void HeadlessOutput::synchronize() const {
-    this->rendev.device->waitForFences(this->frame_fence.get(), true, std::numeric_limits<uint64_t>::max());
-    this->rendev.device->resetFences(this->frame_fence.get());
+void HeadlessOutput::present() {
+    // A submission without any commands signals its fence once all previous submissions completed
+    this->rendev.compute_queue->submit(nullptr, this->render_targets[this->current_target].fence.get());
+    this->current_target = (this->current_target + 1) % RENDER_TARGETS;
+}
+
+void HeadlessOutput::synchronize(uint32_t index) const {
+    const auto fence = this->render_targets[index].fence.get();
+    this->rendev.device->waitForFences(fence, true, std::numeric_limits<uint64_t>::max());
+    this->rendev.device->resetFences(fence);
 }
 
-void HeadlessOutput::download(Pixel* output, size_t stride) {
+void HeadlessOutput::download(uint32_t index, Pixel* output, size_t stride) {
     if (stride == 0) {
         stride = this->render_region.extent.width;
     }
@@ -106,7 +126,8 @@ void HeadlessOutput::download(Pixel* output, size_t stride) {
         vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
     );
 
-    this->rendev.graphics_command_pool.one_time_submit([this, &staging_buffer](vk::CommandBuffer cmd_buf) {
+    // Only wait for the copy: the next frame, which was submitted before it, may still be rendering.
+    this->rendev.graphics_command_pool.one_time_submit_fenced([this, index, &staging_buffer](vk::CommandBuffer cmd_buf) {
         auto copy_info = vk::BufferImageCopy(
             0,
             0,
@@ -117,7 +138,7 @@ void HeadlessOutput::download(Pixel* output, size_t stride) {
         );
 
         cmd_buf.copyImageToBuffer(
-            this->render_target.get(),
+            this->render_targets[index].image.get(),
             vk::ImageLayout::eTransferSrcOptimal,
             staging_buffer.get(),
             copy_info
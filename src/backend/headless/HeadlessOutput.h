@@ -2,6 +2,7 @@
 #define _XENODON_BACKEND_HEADLESS_HEADLESSOUTPUT_H
 
 #include <functional>
+#include <vector>
 #include <cstdint>
 #include "graphics/core/PhysicalDevice.h"
 #include "graphics/core/Device.h"
@@ -12,13 +13,21 @@
 
 using Pixel = uint32_t;
 
+// Renders to a number of images in turn, as a swapchain does, so that a frame can be downloaded while
+// the next frame is rendered.
 class HeadlessOutput final: public Output {
+    struct RenderTarget {
+        Image image;
+        vk::UniqueImageView view;
+
+        // Signaled once rendering of the frame in this image finished, see present
+        vk::UniqueFence fence;
+    };
+
     vk::Rect2D render_region;
     RenderDevice rendev;
-    vk::UniqueFence frame_fence;
-
-    Image render_target;
-    vk::UniqueImageView render_target_view;
+    std::vector<RenderTarget> render_targets;
+    uint32_t current_target;
 
 public:
     HeadlessOutput(const PhysicalDevice& physdev, vk::Rect2D render_region);
@@ -29,8 +38,13 @@ public:
     vk::Rect2D region() const override;
     vk::AttachmentDescription color_attachment_descr() const override;
 
-    void synchronize() const;
-    void download(Pixel* output, size_t stride);
+    // Finish the current frame once all rendering commands submitted so far have completed, and
+    // advance to the next image.
+    void present();
+
+    // Wait until rendering of the frame in the given image finished.
+    void synchronize(uint32_t index) const;
+    void download(uint32_t index, Pixel* output, size_t stride);
 
     RenderDevice& render_device() {
         return this->rendev;
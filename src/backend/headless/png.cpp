@@ -0,0 +1,45 @@
+#include "backend/headless/png.h"
+#include <cstring>
+#include <fmt/format.h>
+#include <lodepng.h>
+#include "core/Logger.h"
+#include "core/Error.h"
+
+std::string format_frame_path(std::string_view format, size_t frame) {
+    try {
+        return fmt::format(format, frame);
+    } catch (const fmt::format_error& e) {
+        throw Error("Failed to format output filename: {}", e.what());
+    }
+}
+
+void save_png(const std::filesystem::path& path, const uint32_t* pixels, uint32_t width, uint32_t height) {
+    LOGGER.log("Compressing...");
+
+    unsigned error = lodepng::encode(
+        path.c_str(),
+        reinterpret_cast<const unsigned char*>(pixels),
+        width,
+        height
+    );
+
+    if (error) {
+        LOGGER.log("Error saving output: {}", lodepng_error_text(error));
+    } else {
+        LOGGER.log("Saved output to '{}'", path.native());
+    }
+}
+
+PngImage load_png(const std::filesystem::path& path) {
+    std::vector<unsigned char> data;
+    unsigned width, height;
+
+    unsigned error = lodepng::decode(data, width, height, path.native());
+    if (error) {
+        throw Error("Failed to load '{}': {}", path.native(), lodepng_error_text(error));
+    }
+
+    auto image = PngImage{width, height, std::vector<uint32_t>(size_t{width} * height)};
+    std::memcpy(image.pixels.data(), data.data(), data.size());
+    return image;
+}
@@ -0,0 +1,29 @@
+#ifndef _XENODON_BACKEND_HEADLESS_PNG_H
+#define _XENODON_BACKEND_HEADLESS_PNG_H
+
+#include <string>
+#include <string_view>
+#include <filesystem>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Format the path of the image of a frame, where the frame number is the first argument of `format`.
+std::string format_frame_path(std::string_view format, size_t frame);
+
+// Save an image of RGBA pixels, packed in 32-bit integers with red in the lowest byte, as PNG.
+// Failures are logged rather than thrown, so that rendering can continue.
+void save_png(const std::filesystem::path& path, const uint32_t* pixels, uint32_t width, uint32_t height);
+
+struct PngImage {
+    uint32_t width;
+    uint32_t height;
+
+    // Packed in the same way as the pixels passed to save_png
+    std::vector<uint32_t> pixels;
+};
+
+// Load a PNG image, converting it to RGBA. Failures are thrown as Error.
+PngImage load_png(const std::filesystem::path& path);
+
+#endif
@@ -50,3 +50,9 @@ void XorgDisplay::poll_events() {
         output->poll_events();
     }
 }
+
+void XorgDisplay::finish() {
+    for (auto& output : this->outputs) {
+        output->render_device().device->waitIdle();
+    }
+}
@@ -0,0 +1,119 @@
+#include "bench_scan.h"
+#include <filesystem>
+#include <chrono>
+#include <memory>
+#include <fmt/format.h>
+#include "core/arg_parse.h"
+#include "core/Error.h"
+#include "model/Grid.h"
+#include "model/GridScan.h"
+
+namespace {
+    struct ScanTiming {
+        double seconds;
+        size_t bytes;
+    };
+
+    // Run `scan_row` over every row of every `block`^3 block of the grid, the access pattern of octree construction.
+    // The entire grid is scanned at once with `block` equal to 0.
+    template <typename Accumulator, typename F>
+    ScanTiming time_scan(const Grid& grid, size_t block, size_t repeat, F scan_row) {
+        const auto dim = grid.dimensions();
+        const auto block_dim = block == 0 ? dim : Vec3Sz{block, block, block};
+        const Pixel* data = grid.pixels().data();
+
+        auto accum = Accumulator();
+        const auto start = std::chrono::high_resolution_clock::now();
+
+        for (size_t i = 0; i < repeat; ++i) {
+            for (size_t bz = 0; bz < dim.z; bz += block_dim.z) {
+                for (size_t by = 0; by < dim.y; by += block_dim.y) {
+                    for (size_t bx = 0; bx < dim.x; bx += block_dim.x) {
+                        const size_t width = std::min(block_dim.x, dim.x - bx);
+                        const size_t z_end = std::min(bz + block_dim.z, dim.z);
+                        const size_t y_end = std::min(by + block_dim.y, dim.y);
+
+                        for (size_t z = bz; z < z_end; ++z) {
+                            for (size_t y = by; y < y_end; ++y) {
+                                scan_row(&data[(z * dim.y + y) * dim.x + bx], width, accum);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        const auto stop = std::chrono::high_resolution_clock::now();
+
+        // Make sure the scan is not optimized away
+        [[maybe_unused]] volatile uint64_t sink = accum.sum[0];
+
+        return {
+            std::chrono::duration<double>(stop - start).count(),
+            repeat * dim.x * dim.y * dim.z * sizeof(Pixel)
+        };
+    }
+
+    double gbps(const ScanTiming& timing) {
+        return static_cast<double>(timing.bytes) / timing.seconds / 1e9;
+    }
+}
+
+void bench_scan(Span<const char*> args) {
+    auto src = std::filesystem::path();
+    size_t repeat = 10;
+    size_t block = 32;
+
+    auto cmd = args::Command {
+        .parameters = {
+            {args::int_range_opt<size_t>(&repeat, 1), "repeat", "--repeat"},
+            {args::int_range_opt<size_t>(&block, 1), "block size", "--block"}
+        },
+        .positional = {
+            {args::path_opt(&src), "source tiff path"}
+        }
+    };
+
+    try {
+        args::parse(args, cmd);
+    } catch (const args::ParseError& e) {
+        fmt::print("Error: {}\n", e.what());
+        return;
+    }
+
+    fmt::print("Loading source...\n");
+    std::unique_ptr<Grid> grid;
+
+    try {
+        grid = std::make_unique<Grid>(Grid::is_volume(src) ? Grid::load_volume(src) : Grid::load_tiff(src));
+    } catch (const Error& e) {
+        fmt::print("Error reading '{}': {}\n", src.native(), e.what());
+        return;
+    }
+
+    if (grid->format() != VoxelFormat::Rgba8) {
+        fmt::print("Error: Scanning requires a grid of format {}\n", voxel_format_to_string(VoxelFormat::Rgba8));
+        return;
+    }
+
+    fmt::print("Scanning {:n} bytes {} times, in blocks of {}^3 voxels and as a whole\n", grid->memory_footprint(), repeat, block);
+    fmt::print("{:<8} {:>16} {:>16} {:>16} {:>16}\n", "kernel", "vol (block)", "vol (grid)", "stddev (block)", "stddev (grid)");
+
+    for (const auto& kernels : scan_kernels::supported_kernels()) {
+        const auto vol_block = time_scan<scan_kernels::VolAccumulator>(*grid, block, repeat, kernels.vol_scan_row);
+        const auto vol_grid = time_scan<scan_kernels::VolAccumulator>(*grid, 0, repeat, kernels.vol_scan_row);
+        const auto stddev_block = time_scan<scan_kernels::StdDevAccumulator>(*grid, block, repeat, kernels.stddev_scan_row);
+        const auto stddev_grid = time_scan<scan_kernels::StdDevAccumulator>(*grid, 0, repeat, kernels.stddev_scan_row);
+
+        fmt::print(
+            "{:<8} {:>11.2f} GB/s {:>11.2f} GB/s {:>11.2f} GB/s {:>11.2f} GB/s\n",
+            kernels.name,
+            gbps(vol_block),
+            gbps(vol_grid),
+            gbps(stddev_block),
+            gbps(stddev_grid)
+        );
+    }
+
+    fmt::print("Grid scans use the {} kernels\n", scan_kernels::kernels().name);
+}
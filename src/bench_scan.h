@@ -0,0 +1,8 @@
+#ifndef _XENODON_BENCH_SCAN_H
+#define _XENODON_BENCH_SCAN_H
+
+#include "utility/Span.h"
+
+void bench_scan(Span<const char*> args);
+
+#endif
@@ -0,0 +1,136 @@
+#include "compare.h"
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <fmt/format.h>
+#include "core/arg_parse.h"
+#include "core/Error.h"
+#include "backend/headless/png.h"
+#include "model/Pixel.h"
+
+namespace {
+    struct FrameDifference {
+        // The largest difference of a color channel over all pixels, from 0-255
+        int max_difference;
+
+        // The number of pixels of which a color channel differs more than the tolerance
+        size_t differing_pixels;
+
+        // Infinite if the images are equal
+        double psnr;
+    };
+
+    // Compare the color channels of two images of equal size, the alpha channel is ignored.
+    FrameDifference difference(const PngImage& reference, const PngImage& image, int tolerance) {
+        auto diff = FrameDifference{0, 0, 0};
+        double squared_error = 0;
+
+        for (size_t i = 0; i < reference.pixels.size(); ++i) {
+            const auto a = Pixel::unpack(reference.pixels[i]);
+            const auto b = Pixel::unpack(image.pixels[i]);
+
+            int pixel_max = 0;
+            for (auto [x, y] : {std::pair(a.r, b.r), std::pair(a.g, b.g), std::pair(a.b, b.b)}) {
+                const int d = std::abs(static_cast<int>(x) - static_cast<int>(y));
+                pixel_max = std::max(pixel_max, d);
+                squared_error += d * d;
+            }
+
+            diff.max_difference = std::max(diff.max_difference, pixel_max);
+            if (pixel_max > tolerance) {
+                ++diff.differing_pixels;
+            }
+        }
+
+        const double mse = squared_error / static_cast<double>(reference.pixels.size() * 3);
+        diff.psnr = mse == 0 ? std::numeric_limits<double>::infinity() : 10 * std::log10(255 * 255 / mse);
+        return diff;
+    }
+}
+
+bool compare(Span<const char*> args) {
+    std::string_view reference_format;
+    std::string_view image_format;
+    int tolerance = 2;
+    double min_psnr = 40;
+
+    auto cmd = args::Command {
+        .parameters = {
+            {args::int_range_opt(&tolerance, 0, 255), "tolerance", "--tolerance"},
+            {args::float_range_opt(&min_psnr, 0.), "psnr", "--min-psnr"}
+        },
+        .positional = {
+            {args::string_opt(&reference_format), "reference path"},
+            {args::string_opt(&image_format), "image path"}
+        }
+    };
+
+    try {
+        args::parse(args, cmd);
+    } catch (const args::ParseError& e) {
+        fmt::print("Error: {}\n", e.what());
+        return false;
+    }
+
+    size_t frames = 0;
+    size_t failed = 0;
+
+    try {
+        // Paths without a frame number are compared once
+        const bool single = format_frame_path(reference_format, 0) == format_frame_path(reference_format, 1);
+
+        for (size_t frame = 0; frame == 0 || !single; ++frame) {
+            const auto reference_path = std::filesystem::path(format_frame_path(reference_format, frame));
+            if (frame > 0 && !std::filesystem::exists(reference_path)) {
+                break;
+            }
+
+            const auto reference = load_png(reference_path);
+            const auto image = load_png(format_frame_path(image_format, frame));
+
+            ++frames;
+
+            if (reference.width != image.width || reference.height != image.height) {
+                fmt::print(
+                    "frame {}: size {}x{} differs from reference size {}x{}\n",
+                    frame,
+                    image.width,
+                    image.height,
+                    reference.width,
+                    reference.height
+                );
+
+                ++failed;
+                continue;
+            }
+
+            const auto diff = difference(reference, image, tolerance);
+            const bool passed = diff.differing_pixels == 0 && diff.psnr >= min_psnr;
+
+            fmt::print(
+                "frame {}: {}, psnr {:.2f} dB, max difference {}, {} pixels over tolerance\n",
+                frame,
+                passed ? "ok" : "FAILED",
+                diff.psnr,
+                diff.max_difference,
+                diff.differing_pixels
+            );
+
+            if (!passed) {
+                ++failed;
+            }
+        }
+    } catch (const Error& e) {
+        fmt::print("Error: {}\n", e.what());
+        return false;
+    }
+
+    fmt::print("{} of {} frames matched the reference\n", frames - failed, frames);
+    return failed == 0;
+}
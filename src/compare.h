@@ -0,0 +1,9 @@
+#ifndef _XENODON_COMPARE_H
+#define _XENODON_COMPARE_H
+
+#include "utility/Span.h"
+
+// Returns whether all frames matched their reference.
+bool compare(Span<const char*> args);
+
+#endif
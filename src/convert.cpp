@@ -3,12 +3,134 @@
 #include <filesystem>
 #include <stdexcept>
 #include <memory>
+#include <optional>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <fmt/format.h>
 #include "core/arg_parse.h"
 #include "core/Error.h"
 #include "model/Grid.h"
 #include "model/Octree.h"
+#include "model/CompactOctree.h"
 #include "model/OctreeConstruction.h"
+#include "utility/parallel.h"
+
+namespace {
+    // The error of the leaf colors of an octree with respect to the voxels of its source, per channel
+    struct Quality {
+        uint64_t squared_error = 0;
+        uint64_t absolute_error = 0;
+        uint8_t max_error = 0;
+        uint64_t samples = 0;
+
+        void operator+=(const Quality& other) {
+            this->squared_error += other.squared_error;
+            this->absolute_error += other.absolute_error;
+            this->max_error = std::max(this->max_error, other.max_error);
+            this->samples += other.samples;
+        }
+    };
+
+    struct QualityTask {
+        uint32_t index;
+        Vec3Sz offset;
+        size_t extent;
+    };
+
+    // Accumulate the error of the leaves of the subtree at `task.index`, which covers [offset, offset + extent)
+    void measure_error(const Grid& grid, Span<Octree::Node> nodes, const QualityTask& task, Quality& quality) {
+        const auto dim = grid.dimensions();
+        if (task.offset.x >= dim.x || task.offset.y >= dim.y || task.offset.z >= dim.z) {
+            return;
+        }
+
+        const auto& node = nodes[task.index];
+
+        if (!node.is_leaf()) {
+            const size_t half = task.extent / 2;
+
+            for (size_t i = 0; i < 8; ++i) {
+                const auto offset = task.offset + Vec3Sz{
+                    (i & Octree::X_POS) != 0 ? half : 0,
+                    (i & Octree::Y_POS) != 0 ? half : 0,
+                    (i & Octree::Z_POS) != 0 ? half : 0
+                };
+
+                measure_error(grid, nodes, {node.children[i], offset, half}, quality);
+            }
+
+            return;
+        }
+
+        const uint8_t color[4] = {node.color.r, node.color.g, node.color.b, node.color.a};
+
+        for (size_t z = task.offset.z; z < std::min(dim.z, task.offset.z + task.extent); ++z) {
+            for (size_t y = task.offset.y; y < std::min(dim.y, task.offset.y + task.extent); ++y) {
+                for (size_t x = task.offset.x; x < std::min(dim.x, task.offset.x + task.extent); ++x) {
+                    const auto pix = grid.at({x, y, z});
+                    const uint8_t source[4] = {pix.r, pix.g, pix.b, pix.a};
+
+                    for (size_t c = 0; c < 4; ++c) {
+                        const auto error = static_cast<uint8_t>(std::abs(int{source[c]} - int{color[c]}));
+                        quality.squared_error += uint64_t{error} * error;
+                        quality.absolute_error += error;
+                        quality.max_error = std::max(quality.max_error, error);
+                    }
+                }
+            }
+        }
+
+        quality.samples += 4 * (std::min(dim.x, task.offset.x + task.extent) - task.offset.x) *
+            (std::min(dim.y, task.offset.y + task.extent) - task.offset.y) *
+            (std::min(dim.z, task.offset.z + task.extent) - task.offset.z);
+    }
+
+    Quality measure_quality(const Grid& grid, const Octree& octree, size_t threads) {
+        const auto nodes = octree.data();
+
+        // Split the tree into enough subtrees to give every thread work
+        auto tasks = std::vector<QualityTask>{{static_cast<uint32_t>(Octree::ROOT), Vec3Sz(0), octree.side()}};
+        for (size_t depth = 0; depth < 4 && tasks.size() < threads * 8; ++depth) {
+            auto next = std::vector<QualityTask>();
+
+            for (const auto& task : tasks) {
+                const auto& node = nodes[task.index];
+
+                if (node.is_leaf()) {
+                    next.push_back(task);
+                    continue;
+                }
+
+                const size_t half = task.extent / 2;
+                for (size_t i = 0; i < 8; ++i) {
+                    const auto offset = task.offset + Vec3Sz{
+                        (i & Octree::X_POS) != 0 ? half : 0,
+                        (i & Octree::Y_POS) != 0 ? half : 0,
+                        (i & Octree::Z_POS) != 0 ? half : 0
+                    };
+
+                    next.push_back({node.children[i], offset, half});
+                }
+            }
+
+            tasks = std::move(next);
+        }
+
+        auto partial = std::vector<Quality>(tasks.size());
+        parallel_for(threads, tasks.size(), [&](size_t i) {
+            measure_error(grid, nodes, tasks[i], partial[i]);
+        });
+
+        auto quality = Quality();
+        for (const auto& part : partial) {
+            quality += part;
+        }
+
+        return quality;
+    }
+}
 
 void convert(Span<const char*> args) {
     auto src = std::filesystem::path();
@@ -17,18 +139,40 @@ void convert(Span<const char*> args) {
     // uint8_t split_difference = 0;
     bool dag = false;
     bool rope = false;
+    bool compact = false;
+    bool bottom_up = false;
+    bool merge_depths = false;
+    bool report_quality = false;
+    bool volume = false;
 
     int channel_difference = -1;
+    int color_tolerance = 0;
     double stddev = -1;
+    size_t threads = 1;
+    size_t max_memory = 0;
+    size_t summed_table_memory = 0;
+    std::string_view grid_layout = "bricked";
+    std::string_view voxel_format;
 
     auto cmd = args::Command {
         .flags = {
             {&dag, "--dag"},
-            {&rope, "--rope"}
+            {&rope, "--rope"},
+            {&compact, "--compact"},
+            {&bottom_up, "--bottom-up"},
+            {&merge_depths, "--merge-depths"},
+            {&report_quality, "--report-quality"},
+            {&volume, "--volume"}
         },
         .parameters = {
             {args::int_range_opt<int>(&channel_difference, 0, 255), "channel difference", "--chan-diff"},
-            {args::float_range_opt(&stddev, 0.0), "std. dev", "--std-dev"}
+            {args::float_range_opt(&stddev, 0.0), "std. dev", "--std-dev"},
+            {args::int_range_opt<int>(&color_tolerance, 0, 255), "color tolerance", "--color-tolerance"},
+            {args::int_range_opt<size_t>(&threads, 1), "threads", "--threads"},
+            {args::int_range_opt<size_t>(&max_memory, 1), "MiB", "--max-memory"},
+            {args::int_range_opt<size_t>(&summed_table_memory, 1), "MiB", "--summed-volume-table"},
+            {args::string_opt(&grid_layout), "layout", "--grid-layout"},
+            {args::string_opt(&voxel_format), "format", "--voxel-format"}
         },
         .positional = {
             {args::path_opt(&src), "source tiff path"},
@@ -48,41 +192,175 @@ void convert(Span<const char*> args) {
         return;
     }
 
+    if (compact && rope) {
+        fmt::print("Error: --compact and --rope are mutually exclusive\n");
+        return;
+    }
+
     if (channel_difference >= 0 && stddev >= 0) {
         fmt::print("Error: --std-dev and --chan-diff are mutually exclusive\n");
         return;
     }
 
-    fmt::print("Loading source...\n");
-    std::unique_ptr<Grid> grid;
+    if ((color_tolerance > 0 || merge_depths) && !dag && !compact) {
+        fmt::print("Error: --color-tolerance and --merge-depths require --dag or --compact\n");
+        return;
+    }
 
-    try {
-        grid = std::make_unique<Grid>(Grid::load_tiff(src));
-    } catch (const Error& e) {
-        fmt::print("Error reading '{}': {}\n", src.native(), e.what());
+    if (grid_layout != "linear" && grid_layout != "bricked") {
+        fmt::print("Error: Invalid grid layout '{}'\n", grid_layout);
         return;
     }
 
-    {
-        auto dim = grid->dimensions();
-        fmt::print("Source grid:\n");
-        fmt::print(" Dimensions: {}x{}x{}\n", dim.x, dim.y, dim.z);
-        fmt::print(" Size: {:n} bytes\n", grid->memory_footprint());
+    const auto format = voxel_format.empty() ? std::optional(VoxelFormat::Rgba8) : parse_voxel_format(voxel_format);
+    if (!format) {
+        fmt::print("Error: Invalid voxel format '{}'\n", voxel_format);
+        return;
+    }
+
+    if (!voxel_format.empty() && !volume) {
+        fmt::print("Error: --voxel-format requires --volume\n");
+        return;
+    }
+
+    if (report_quality && max_memory > 0) {
+        fmt::print("Error: --report-quality and --max-memory are mutually exclusive\n");
+        return;
+    }
+
+    if (summed_table_memory > 0 && stddev < 0) {
+        fmt::print("Error: --summed-volume-table requires --std-dev\n");
+        return;
     }
 
-    fmt::print("Converting to octree...\n");
+    if (summed_table_memory > 0 && (max_memory > 0 || bottom_up)) {
+        fmt::print("Error: --summed-volume-table is mutually exclusive with --max-memory and --bottom-up\n");
+        return;
+    }
+
+    const bool octree_options = dag || rope || compact || bottom_up || merge_depths || report_quality ||
+        channel_difference >= 0 || stddev >= 0 || color_tolerance > 0 || max_memory > 0 || summed_table_memory > 0;
+
+    if (volume && octree_options) {
+        fmt::print("Error: --volume cannot be combined with octree options\n");
+        return;
+    }
 
     auto stats = ConstructionStats();
-    auto convert_octree = [&](auto heuristic) {
-        const auto type = dag ? Octree::Type::Dag : rope ? Octree::Type::Rope : Octree::Type::Sparse;
-        return build_octree(*grid, stats, heuristic, type);
+    auto options = ConstructionOptions();
+    options.type = compact ? Octree::Type::Compact :
+        dag ? Octree::Type::Dag :
+        rope ? Octree::Type::Rope :
+        Octree::Type::Sparse;
+    options.bottom_up = bottom_up;
+    options.threads = threads;
+    options.color_tolerance = static_cast<uint8_t>(color_tolerance);
+    options.merge_depths = merge_depths;
+    options.layout = grid_layout == "linear" ? Grid::Layout::Linear : Grid::Layout::Bricked;
+
+    auto convert_octree = [&](auto construct) {
+        return stddev >= 0 ?
+            construct(StdDevHeuristic{stddev}) :
+            construct(ChannelDiffHeuristic{
+                    static_cast<uint8_t>(std::max(channel_difference, 0))
+            });
     };
 
-    auto octree = stddev >= 0 ?
-        convert_octree(StdDevHeuristic{stddev}) :
-        convert_octree(ChannelDiffHeuristic{
-                static_cast<uint8_t>(std::max(channel_difference, 0))
+    auto octree = Octree(0, {});
+    std::unique_ptr<Grid> grid;
+
+    if (max_memory > 0) {
+        // Stream the source in slabs instead of loading the entire grid
+        if (Grid::is_volume(src)) {
+            fmt::print("Error: --max-memory requires a TIFF source\n");
+            return;
+        }
+
+        try {
+            auto dim = Grid::tiff_dimensions(src);
+            fmt::print("Source grid:\n");
+            fmt::print(" Dimensions: {}x{}x{}\n", dim.x, dim.y, dim.z);
+            fmt::print(" Size: {:n} bytes\n", dim.x * dim.y * dim.z * sizeof(Pixel));
+
+            fmt::print("Converting to octree using at most {:n} bytes of source memory...\n", max_memory * 1024 * 1024);
+
+            auto spill_path = dst;
+            spill_path += ".tmp";
+
+            octree = convert_octree([&](auto heuristic) {
+                return build_octree_streaming(src, spill_path, stats, heuristic, options, max_memory * 1024 * 1024);
+            });
+        } catch (const Error& e) {
+            fmt::print("Error converting '{}': {}\n", src.native(), e.what());
+            return;
+        }
+    } else {
+        fmt::print("Loading source...\n");
+
+        try {
+            // Raw volumes can only be written from the linear layout
+            const auto layout = volume ? Grid::Layout::Linear : options.layout;
+
+            if (Grid::is_volume(src)) {
+                if (!voxel_format.empty()) {
+                    fmt::print("Error: --voxel-format requires a TIFF source\n");
+                    return;
+                }
+
+                grid = std::make_unique<Grid>(Grid::load_volume(src));
+                if (grid->format() != VoxelFormat::Rgba8 && !volume) {
+                    fmt::print("Error: Only {} grids can be converted to an octree\n", voxel_format_to_string(VoxelFormat::Rgba8));
+                    return;
+                }
+
+                if (grid->layout() != layout) {
+                    *grid = grid->with_layout(layout);
+                }
+            } else {
+                grid = std::make_unique<Grid>(Grid::load_tiff(src, threads, layout, format.value()));
+            }
+        } catch (const Error& e) {
+            fmt::print("Error reading '{}': {}\n", src.native(), e.what());
+            return;
+        }
+
+        {
+            auto dim = grid->dimensions();
+            fmt::print("Source grid:\n");
+            fmt::print(" Dimensions: {}x{}x{}\n", dim.x, dim.y, dim.z);
+            fmt::print(" Format: {}\n", voxel_format_to_string(grid->format()));
+            fmt::print(" Size: {:n} bytes\n", grid->memory_footprint());
+        }
+
+        if (volume) {
+            fmt::print("Writing raw volume...\n");
+
+            try {
+                grid->save_volume(dst);
+            } catch (const std::runtime_error& e) {
+                fmt::print("Error writing '{}': {}\n", dst.native(), e.what());
+            }
+
+            return;
+        }
+
+        if (summed_table_memory > 0) {
+            const size_t required = SummedVolumeTable::memory_required(grid->dimensions());
+
+            if (required > summed_table_memory * 1024 * 1024) {
+                fmt::print("Summed-volume table requires {:n} bytes, which exceeds the budget; scanning the source instead\n", required);
+            } else {
+                fmt::print("Building summed-volume table of {:n} bytes...\n", required);
+                grid->build_summed_volume_table(threads);
+            }
+        }
+
+        fmt::print("Converting to octree...\n");
+
+        octree = convert_octree([&](auto heuristic) {
+            return build_octree(*grid, stats, heuristic, options);
         });
+    }
 
     {
         auto k_ary_nodes = [](size_t k, size_t h) {
@@ -112,11 +390,62 @@ void convert(Span<const char*> args) {
         fmt::print(" Total leaves: {:n}\n", stats.total_leaves);
         fmt::print(" Unique leaves: {:n}\n", stats.unique_leaves);
         fmt::print(" Depth: {:n}\n", stats.depth);
+
+        if (stats.cache_slots > 0) {
+            const double load_factor = static_cast<double>(stats.cache_entries) / static_cast<double>(stats.cache_slots);
+            const double probes_per_lookup = static_cast<double>(stats.cache_probes) / static_cast<double>(stats.cache_lookups);
+
+            fmt::print(" Hash table slots: {:n} ({:.2f} load factor)\n", stats.cache_slots, load_factor);
+            fmt::print(" Hash table lookups: {:n} ({:.3f} probes per lookup)\n", stats.cache_lookups, probes_per_lookup);
+        }
     }
 
-    try {
-        octree.save_svo(dst);
-    } catch (const std::runtime_error& e) {
-        fmt::print("Error writing '{}': {}\n", dst.native(), e.what());
+    size_t output_size = octree.memory_footprint();
+
+    if (!compact) {
+        try {
+            octree.save_svo(dst);
+        } catch (const std::runtime_error& e) {
+            fmt::print("Error writing '{}': {}\n", dst.native(), e.what());
+            return;
+        }
+    } else {
+        fmt::print("Converting to compact octree...\n");
+
+        try {
+            const auto compact_octree = CompactOctree::from_octree(octree);
+            const double proportion = static_cast<double>(compact_octree.memory_footprint()) / static_cast<double>(octree.memory_footprint());
+
+            fmt::print("Compact octree:\n");
+            fmt::print(" Size: {:n} bytes ({:.2f}% of the generated octree)\n", compact_octree.memory_footprint(), proportion * 100);
+            fmt::print(" Nodes: {:n}\n", compact_octree.data().size());
+
+            output_size = compact_octree.memory_footprint();
+            compact_octree.save_svo(dst);
+        } catch (const std::runtime_error& e) {
+            fmt::print("Error writing '{}': {}\n", dst.native(), e.what());
+            return;
+        }
+    }
+
+    if (report_quality) {
+        fmt::print("Measuring quality...\n");
+
+        const auto quality = measure_quality(*grid, octree, threads);
+        const double source_size = static_cast<double>(grid->size() * sizeof(Pixel));
+        const double samples = static_cast<double>(quality.samples);
+        const double mse = static_cast<double>(quality.squared_error) / samples;
+
+        fmt::print("Quality:\n");
+        fmt::print(" Compression ratio: {:.2f}x\n", source_size / static_cast<double>(output_size));
+
+        if (quality.squared_error == 0) {
+            fmt::print(" PSNR: lossless\n");
+        } else {
+            fmt::print(" PSNR: {:.2f} dB\n", 10.0 * std::log10(255.0 * 255.0 / mse));
+        }
+
+        fmt::print(" Mean absolute channel error: {:.4f}\n", static_cast<double>(quality.absolute_error) / samples);
+        fmt::print(" Maximum channel error: {}\n", quality.max_error);
     }
 }
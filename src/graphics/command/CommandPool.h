@@ -2,6 +2,7 @@
 #define _XENODON_GRAPHICS_COMMAND_COMMANDPOOL_H
 
 #include <vector>
+#include <limits>
 #include <vulkan/vulkan.hpp>
 #include "graphics/core/Device.h"
 #include "graphics/core/Queue.h"
@@ -28,6 +29,11 @@ public:
     template <typename F>
     void one_time_submit(F f) const;
 
+    // As one_time_submit, but only waits for this submission instead of for the whole queue, so that
+    // work submitted earlier can still be executing when it returns.
+    template <typename F>
+    void one_time_submit_fenced(F f) const;
+
     vk::CommandPool get() const {
         return this->pool;
     }
@@ -53,4 +59,25 @@ void CommandPool::one_time_submit(F f) const {
     this->queue.waitIdle();
 }
 
+template <typename F>
+void CommandPool::one_time_submit_fenced(F f) const {
+    auto cmdbuf = this->allocate_command_buffer();
+
+    cmdbuf->begin({
+        vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+    });
+
+    f(cmdbuf.get());
+
+    cmdbuf->end();
+
+    auto submit_info = vk::SubmitInfo();
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmdbuf.get();
+
+    auto fence = this->device.createFenceUnique({});
+    this->queue.submit(submit_info, fence.get());
+    this->device.waitForFences(fence.get(), true, std::numeric_limits<uint64_t>::max());
+}
+
 #endif
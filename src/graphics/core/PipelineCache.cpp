@@ -0,0 +1,164 @@
+#include "graphics/core/PipelineCache.h"
+#include <fstream>
+#include <iterator>
+#include <chrono>
+#include <system_error>
+#include <cstdlib>
+#include <unistd.h>
+#include <fmt/format.h>
+#include "core/Logger.h"
+#include "utility/serialization.h"
+
+namespace {
+    // Hash of the shader source and specialization constants in the file name of an entry. This needs
+    // to be the same for every launch, so std::hash is not used.
+    uint64_t fnv1a(std::string_view data, uint64_t hash = 0xCBF29CE484222325ull) {
+        for (char c : data) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 0x100000001B3ull;
+        }
+
+        return hash;
+    }
+
+    uint64_t fnv1a(const std::vector<uint8_t>& data) {
+        return fnv1a(std::string_view(reinterpret_cast<const char*>(data.data()), data.size()));
+    }
+
+    // Pipelines of the same shader with different specialization constants are different entries.
+    std::string entry_name(const Device& device, std::string_view shader_source, const vk::SpecializationInfo* specialization) {
+        const auto props = device.physical_device().getProperties();
+
+        auto name = fmt::format("{:04x}-{:04x}-{:08x}-", props.vendorID, props.deviceID, props.driverVersion);
+        for (uint8_t byte : props.pipelineCacheUUID) {
+            name += fmt::format("{:02x}", byte);
+        }
+
+        uint64_t hash = fnv1a(shader_source);
+        if (specialization) {
+            const auto data = std::string_view(static_cast<const char*>(specialization->pData), specialization->dataSize);
+            hash = fnv1a(data, hash);
+        }
+
+        name += fmt::format("-{:016x}.cache", hash);
+        return name;
+    }
+}
+
+PipelineCache::PipelineCache(const std::filesystem::path& dir):
+    dir(dir) {
+}
+
+vk::UniquePipeline PipelineCache::create_compute_pipeline(const Device& device, std::string_view shader_source, const vk::ComputePipelineCreateInfo& info) {
+    const auto name = entry_name(device, shader_source, info.stage.pSpecializationInfo);
+    auto& entry = this->find_entry(name);
+    const bool cached = !entry.data.empty();
+
+    // Vulkan ignores cached data of a different device or driver, so it is always safe to pass
+    const auto cache = device->createPipelineCacheUnique({
+        {},
+        entry.data.size(),
+        entry.data.data()
+    });
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    auto pipeline = device->createComputePipelineUnique(cache.get(), info);
+    const auto stop = std::chrono::high_resolution_clock::now();
+    const double time = std::chrono::duration<double, std::milli>(stop - start).count();
+
+    if (!cached) {
+        entry.uncached_time = time;
+        LOGGER.log("Created pipeline in {:.2f}ms", time);
+    } else if (entry.uncached_time > 0) {
+        LOGGER.log("Created pipeline in {:.2f}ms, the pipeline cache saved {:.2f}ms", time, entry.uncached_time - time);
+    } else {
+        LOGGER.log("Created pipeline from the pipeline cache in {:.2f}ms", time);
+    }
+
+    auto data = device->getPipelineCacheData(cache.get());
+    if (data != entry.data) {
+        entry.data = std::move(data);
+        this->save_entry(name, entry);
+    }
+
+    return pipeline;
+}
+
+PipelineCache::Entry& PipelineCache::find_entry(const std::string& name) {
+    auto it = this->entries.find(name);
+    if (it != this->entries.end()) {
+        return it->second;
+    }
+
+    auto& entry = this->entries[name];
+    entry.uncached_time = 0;
+
+    if (this->dir.empty()) {
+        return entry;
+    }
+
+    // An entry file consists of the uncached time in microseconds, the size and hash of the data, and the
+    // data itself. A missing or damaged file simply leaves the entry empty, as the data of a partially written
+    // or corrupted file is not necessarily rejected by the driver.
+    auto in = std::ifstream(this->dir / name, std::ios::binary);
+    const auto uncached_time_us = read_uint_le<uint64_t>(in);
+    const auto size = read_uint_le<uint64_t>(in);
+    const auto hash = read_uint_le<uint64_t>(in);
+    if (!in) {
+        return entry;
+    }
+
+    auto data = std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (data.size() != size || fnv1a(data) != hash) {
+        LOGGER.log("Ignoring damaged pipeline cache '{}'", (this->dir / name).native());
+        return entry;
+    }
+
+    entry.data = std::move(data);
+    entry.uncached_time = static_cast<double>(uncached_time_us) / 1'000.0;
+    return entry;
+}
+
+void PipelineCache::save_entry(const std::string& name, const Entry& entry) const {
+    if (this->dir.empty()) {
+        return;
+    }
+
+    // The cache is only an optimization, so failing to save it is not an error
+    auto ec = std::error_code();
+    std::filesystem::create_directories(this->dir, ec);
+
+    // The entry is written to a file of this process first, and then renamed into place, so that other
+    // instances never read a partially written entry
+    const auto path = this->dir / name;
+    const auto tmp_path = this->dir / fmt::format("{}.{}.tmp", name, getpid());
+
+    auto out = std::ofstream(tmp_path, std::ios::binary);
+    write_uint_le(out, static_cast<uint64_t>(entry.uncached_time * 1'000.0));
+    write_uint_le(out, static_cast<uint64_t>(entry.data.size()));
+    write_uint_le(out, fnv1a(entry.data));
+    out.write(reinterpret_cast<const char*>(entry.data.data()), static_cast<std::streamsize>(entry.data.size()));
+    out.close();
+
+    if (!out) {
+        LOGGER.log("Failed to save pipeline cache to '{}'", path.native());
+        std::filesystem::remove(tmp_path, ec);
+        return;
+    }
+
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+        LOGGER.log("Failed to save pipeline cache to '{}': {}", path.native(), ec.message());
+        std::filesystem::remove(tmp_path, ec);
+    }
+}
+
+std::filesystem::path default_pipeline_cache_dir() {
+    if (const char* cache_home = std::getenv("XDG_CACHE_HOME"); cache_home && cache_home[0] != 0) {
+        return std::filesystem::path(cache_home) / "xenodon";
+    } else if (const char* home = std::getenv("HOME"); home && home[0] != 0) {
+        return std::filesystem::path(home) / ".cache" / "xenodon";
+    }
+
+    return std::filesystem::path();
+}
@@ -0,0 +1,43 @@
+#ifndef _XENODON_GRAPHICS_CORE_PIPELINECACHE_H
+#define _XENODON_GRAPHICS_CORE_PIPELINECACHE_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <filesystem>
+#include <cstdint>
+#include <vulkan/vulkan.hpp>
+#include "graphics/core/Device.h"
+
+// Keeps compiled pipelines around, so that they don't need to be compiled again for every device and every launch.
+// Pipelines are stored per shader, specialization constants and kind of device, identified by the pipeline cache
+// UUID and driver version of the physical device: all devices of the same kind share their compiled pipelines.
+// If a directory is given, pipelines are also loaded from and saved to a file per entry in it.
+class PipelineCache {
+    struct Entry {
+        std::vector<uint8_t> data;
+
+        // The time it took to create the pipeline without cached data, in milliseconds, or 0 if unknown.
+        double uncached_time;
+    };
+
+    std::filesystem::path dir;
+    std::unordered_map<std::string, Entry> entries;
+
+public:
+    explicit PipelineCache(const std::filesystem::path& dir);
+
+    // Create a compute pipeline of which the shader has the given source, see Shader.
+    vk::UniquePipeline create_compute_pipeline(const Device& device, std::string_view shader_source, const vk::ComputePipelineCreateInfo& info);
+
+private:
+    Entry& find_entry(const std::string& name);
+    void save_entry(const std::string& name, const Entry& entry) const;
+};
+
+// The directory in which pipelines are cached by default: xenodon/ in $XDG_CACHE_HOME or ~/.cache, or
+// an empty path if neither is available.
+std::filesystem::path default_pipeline_cache_dir();
+
+#endif
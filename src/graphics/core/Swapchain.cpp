@@ -134,7 +134,6 @@ void Swapchain::recreate(vk::Extent2D surface_extent) {
         for (size_t i = 0; i < this->images.size(); ++i) {
             this->images[i].image_acquired = dev.createSemaphoreUnique(vk::SemaphoreCreateInfo());
             this->images[i].render_finished = dev.createSemaphoreUnique(vk::SemaphoreCreateInfo());
-            this->images[i].frame_fence = dev.createFenceUnique({});
         }
     }
 
@@ -160,9 +159,11 @@ vk::Result Swapchain::swap_buffers() {
     auto& current_image = this->current_image();
     auto dev = this->device->get();
 
-    dev.waitForFences(current_image.frame_fence.get(), true, std::numeric_limits<uint64_t>::max());
-    dev.resetFences(current_image.frame_fence.get());
-
+    // Presenting waits for rendering on the GPU, the CPU does not wait here so that it can record
+    // the next frame in the meantime. The number of frames in flight is limited by the renderer.
+    // The semaphores of an image are only reused once the renderer waited for the fence of the frame
+    // which last rendered to it. This requires Renderer::MAX_FRAMES_IN_FLIGHT to be at most the number
+    // of swapchain images, which is at least minImageCount + 1, and is asserted by the renderer.
     auto present_info = vk::PresentInfoKHR(
         1,
         &current_image.render_finished.get(),
@@ -15,7 +15,6 @@ public:
         vk::UniqueImageView view;
         vk::UniqueSemaphore image_acquired;
         vk::UniqueSemaphore render_finished;
-        vk::UniqueFence frame_fence;
     };
 
 private:
@@ -0,0 +1,42 @@
+#ifndef _XENODON_GRAPHICS_MEMORY_TEXTURE1D_H
+#define _XENODON_GRAPHICS_MEMORY_TEXTURE1D_H
+
+#include "graphics/core/Device.h"
+#include "graphics/memory/Buffer.h"
+#include "utility/Span.h"
+
+class Texture1D {
+    vk::Device dev;
+    vk::Image image;
+    vk::DeviceMemory mem;
+    vk::ImageView image_view;
+
+public:
+    Texture1D(const Device& dev, vk::Format format, uint32_t width, vk::ImageUsageFlags flags);
+
+    Texture1D(const Texture1D&) = delete;
+    Texture1D& operator=(const Texture1D&) = delete;
+
+    Texture1D(Texture1D&& other);
+    Texture1D& operator=(Texture1D&& other);
+
+    ~Texture1D();
+
+    vk::Image get() const {
+        return this->image;
+    }
+
+    vk::DeviceMemory memory() const {
+        return this->mem;
+    }
+
+    vk::ImageView view() const {
+        return this->image_view;
+    }
+
+    vk::Device device() const {
+        return this->dev;
+    }
+};
+
+#endif
@@ -11,11 +11,16 @@
 #include "backend/backend.h"
 #include "backend/Display.h"
 #include "backend/Event.h"
+#include "graphics/core/PipelineCache.h"
+#include "render/TuneProfile.h"
 #include "utility/Span.h"
+#include "utility/parallel.h"
 #include "resources.h"
 #include "main_loop.h"
 #include "sysinfo.h"
 #include "convert.h"
+#include "bench_scan.h"
+#include "compare.h"
 
 namespace {
     struct HelpTopic {
@@ -28,6 +33,9 @@ namespace {
         HelpTopic{"sysinfo", resources::open("resources/help/sysinfo.txt")},
         HelpTopic{"convert", resources::open("resources/help/convert.txt")},
         HelpTopic{"render", resources::open("resources/help/render.txt")},
+        HelpTopic{"bench-scan", resources::open("resources/help/bench_scan.txt")},
+        HelpTopic{"compare", resources::open("resources/help/compare.txt")},
+        HelpTopic{"tune", resources::open("resources/help/tune.txt")},
         HelpTopic{"xorg-multi-gpu", resources::open("resources/help/xorg_multi_gpu.txt")},
         HelpTopic{"headless-config", resources::open("resources/help/headless_config.txt")},
         HelpTopic{"direct-config", resources::open("resources/help/direct_config.txt")},
@@ -37,6 +45,7 @@ namespace {
         bool quiet = false;
         std::filesystem::path log_output;
         RenderParameters render_params;
+        bool no_pipeline_cache = false;
 
         struct {
             std::filesystem::path config;
@@ -60,8 +69,38 @@ namespace {
             bool enabled = false;
             std::filesystem::path multi_gpu_config;
         } xorg;
+
+        struct {
+            Vec2<uint32_t> extent = {0, 0};
+            // 0 uses all hardware threads
+            size_t threads = 0;
+            std::string_view simd;
+
+            bool enabled() const {
+                return this->extent.x != 0;
+            }
+        } cpu;
     };
 
+    auto extent_opt(Vec2<uint32_t>* var) {
+        return [var](std::string_view arg) {
+            const auto sep = arg.find('x');
+            if (sep == std::string_view::npos) {
+                return false;
+            }
+
+            Vec2<uint32_t> value;
+            uint32_t max = std::numeric_limits<uint32_t>::max();
+            if (!args::int_range_opt<uint32_t>(&value.x, 1, max)(arg.substr(0, sep)) ||
+                !args::int_range_opt<uint32_t>(&value.y, 1, max)(arg.substr(sep + 1))) {
+                return false;
+            }
+
+            *var = value;
+            return true;
+        };
+    }
+
     auto voxel_ratio_opt(Vec3F* var) {
         return [var](std::string_view arg) {
             const auto first = arg.find(':');
@@ -101,7 +140,10 @@ namespace {
             .flags = {
                 {&opts.quiet, "--quiet", 'q'},
                 {&opts.xorg.enabled, "--xorg"},
-                {&opts.headless.discard_output, "--discard-output"}
+                {&opts.headless.discard_output, "--discard-output"},
+                {&opts.render_params.disable_empty_space_skipping, "--no-empty-space-skipping"},
+                {&opts.render_params.composite, "--composite"},
+                {&opts.no_pipeline_cache, "--no-pipeline-cache"}
             },
             .parameters = {
                 {args::path_opt(&opts.log_output), "output path", "--log-output"},
@@ -109,13 +151,24 @@ namespace {
                 {args::string_opt(&opts.headless.output), "output path", "--output"},
                 {args::path_opt(&opts.direct.config), "config path", "--direct"},
                 {args::path_opt(&opts.xorg.multi_gpu_config), "config path", "--xorg-multi-gpu"},
+                {extent_opt(&opts.cpu.extent), "resolution", "--cpu"},
+                {args::int_range_opt<size_t>(&opts.cpu.threads, 1), "threads", "--threads"},
+                {args::string_opt(&opts.cpu.simd), "instruction set", "--simd"},
                 {args::float_range_opt(&opts.render_params.emission_coeff, 0.f), "emission coefficient", "--emission-coeff", 'e'},
+                {args::float_range_opt(&opts.render_params.absorption_coeff, 0.f), "absorption coefficient", "--absorption-coeff"},
+                {args::float_range_opt(&opts.render_params.termination_threshold, 0.f, 1.f), "transmittance", "--termination-threshold"},
+                {args::float_range_opt(&opts.render_params.lod_bias, 0.f), "pixels", "--lod-bias"},
                 {args::string_opt(&opts.render_params.volume_type_override), "volume type", "--volume-type"},
+                {args::string_opt(&opts.render_params.voxel_format), "voxel format", "--voxel-format"},
+                {args::path_opt(&opts.render_params.transfer_function_path), "transfer function", "--transfer-function"},
                 {args::string_opt(&opts.render_params.shader), "shader", "--shader", 's'},
                 {voxel_ratio_opt(&opts.render_params.voxel_ratio), "voxel dimension ratio", "--voxel-ratio", 'r'},
                 {args::path_opt(&opts.render_params.stats_save_path), "stats output", "--stats-output"},
+                {args::path_opt(&opts.render_params.pipeline_cache_dir), "cache directory", "--pipeline-cache"},
                 {args::string_opt(&opts.render_params.camera), "camera", "--camera"},
-                {args::int_range_opt(&opts.render_params.repeat), "frame repeat", "--repeat"}
+                {args::int_range_opt(&opts.render_params.repeat), "frame repeat", "--repeat"},
+                {extent_opt(&opts.render_params.workgroup_size), "workgroup size", "--workgroup"},
+                {args::path_opt(&opts.render_params.profile_path), "profile", "--profile"}
             },
             .positional = {
                 {args::path_opt(&opts.render_params.volume_path), "volume path"}
@@ -127,20 +180,24 @@ namespace {
         int enabled_backends =
             static_cast<int>(opts.xorg.enabled) +
             static_cast<int>(opts.headless.enabled()) +
-            static_cast<int>(opts.direct.enabled());
+            static_cast<int>(opts.direct.enabled()) +
+            static_cast<int>(opts.cpu.enabled());
 
         if (enabled_backends == 0) {
-            throw Error("Missing required backend --xorg, --headless or --direct");
+            throw Error("Missing required backend --xorg, --headless, --direct or --cpu");
         } else if (enabled_backends > 1) {
-            throw Error("--xorg, --headless and --direct are mutually exclusive");
+            throw Error("--xorg, --headless, --direct and --cpu are mutually exclusive");
         }
 
-        if (!opts.headless.enabled() && opts.headless.discard_output) {
-            throw Error("--dont-save requires --headless");
+        // The cpu backend saves its output in the same way as the headless backend
+        const bool saves_output = opts.headless.enabled() || opts.cpu.enabled();
+
+        if (!saves_output && opts.headless.discard_output) {
+            throw Error("--dont-save requires --headless or --cpu");
         }
 
-        if (!opts.headless.output.empty() && !opts.headless.enabled()) {
-            throw Error("--output requires --headless");
+        if (!opts.headless.output.empty() && !saves_output) {
+            throw Error("--output requires --headless or --cpu");
         } else if (opts.headless.output.empty()) {
             opts.headless.output = "out-{}.png";
         } else if (opts.headless.discard_output) {
@@ -151,16 +208,41 @@ namespace {
             throw Error("--xorg-multi-gpu requires --xorg");
         }
 
+        if (opts.cpu.threads != 0 && !opts.cpu.enabled()) {
+            throw Error("--threads requires --cpu");
+        }
+
+        if (!opts.cpu.simd.empty() && !opts.cpu.enabled()) {
+            throw Error("--simd requires --cpu");
+        }
+
+        if (opts.render_params.workgroup_size.x != 0 && opts.cpu.enabled()) {
+            throw Error("--workgroup cannot be used with --cpu");
+        }
+
+        if (!opts.render_params.profile_path.empty() && opts.cpu.enabled()) {
+            throw Error("--profile cannot be used with --cpu");
+        }
+
+        if ((opts.no_pipeline_cache || !opts.render_params.pipeline_cache_dir.empty()) && opts.cpu.enabled()) {
+            throw Error("--pipeline-cache and --no-pipeline-cache cannot be used with --cpu");
+        } else if (opts.no_pipeline_cache && !opts.render_params.pipeline_cache_dir.empty()) {
+            throw Error("--pipeline-cache and --no-pipeline-cache are mutually exclusive");
+        } else if (!opts.no_pipeline_cache && opts.render_params.pipeline_cache_dir.empty()) {
+            opts.render_params.pipeline_cache_dir = default_pipeline_cache_dir();
+        }
+
         return opts;
     }
 
-    void render(Span<const char*> args) {
+    // Returns false if the frames could not be rendered.
+    bool render(Span<const char*> args) {
         RenderOptions opts;
         try {
             opts = parse_render_args(args);
         } catch (const Error& e) {
             fmt::print("Error: {}\n", e.what());
-            return;
+            return false;
         }
 
         if (!opts.quiet) {
@@ -172,6 +254,25 @@ namespace {
         }
 
         auto dispatcher = EventDispatcher();
+
+        if (opts.cpu.enabled()) {
+            auto cpu_params = CpuParameters {
+                .extent = opts.cpu.extent,
+                .threads = opts.cpu.threads != 0 ? opts.cpu.threads : hardware_threads(),
+                .simd = opts.cpu.simd,
+                .output = opts.headless.discard_output ? "" : opts.headless.output
+            };
+
+            try {
+                cpu_main_loop(dispatcher, cpu_params, opts.render_params);
+            } catch (const Error& e) {
+                fmt::print("Error: {}\n", e.what());
+                return false;
+            }
+
+            return true;
+        }
+
         std::unique_ptr<Display> display;
 
         try {
@@ -185,11 +286,89 @@ namespace {
             }
         } catch (const Error& e) {
             fmt::print("Error: Failed to initialize backend: {}\n", e.what());
-            return;
+            return false;
         }
 
         try {
             main_loop(dispatcher, display.get(), opts.render_params);
+        } catch (const Error& e) {
+            fmt::print("Error: {}\n", e.what());
+            return false;
+        }
+
+        return true;
+    }
+
+    void tune(Span<const char*> args) {
+        bool quiet = false;
+        std::filesystem::path log_output;
+        std::filesystem::path headless_config;
+        bool no_pipeline_cache = false;
+        auto render_params = RenderParameters();
+        auto tune_params = TuneParameters{100, std::filesystem::path()};
+
+        auto cmd = args::Command {
+            .flags = {
+                {&quiet, "--quiet", 'q'},
+                {&render_params.composite, "--composite"},
+                {&no_pipeline_cache, "--no-pipeline-cache"}
+            },
+            .parameters = {
+                {args::path_opt(&log_output), "output path", "--log-output"},
+                {args::path_opt(&headless_config), "config path", "--headless"},
+                {args::int_range_opt<size_t>(&tune_params.frames, 1), "frames", "--frames"},
+                {args::path_opt(&tune_params.profile_path), "profile", "--profile"},
+                {args::float_range_opt(&render_params.absorption_coeff, 0.f), "absorption coefficient", "--absorption-coeff"},
+                {args::float_range_opt(&render_params.termination_threshold, 0.f, 1.f), "transmittance", "--termination-threshold"},
+                {args::float_range_opt(&render_params.lod_bias, 0.f), "pixels", "--lod-bias"},
+                {args::string_opt(&render_params.volume_type_override), "volume type", "--volume-type"},
+                {args::string_opt(&render_params.voxel_format), "voxel format", "--voxel-format"},
+                {voxel_ratio_opt(&render_params.voxel_ratio), "voxel dimension ratio", "--voxel-ratio", 'r'}
+            },
+            .positional = {
+                {args::path_opt(&render_params.volume_path), "volume path"}
+            }
+        };
+
+        try {
+            args::parse(args, cmd);
+
+            if (headless_config.empty()) {
+                throw Error("Missing required backend --headless");
+            }
+        } catch (const Error& e) {
+            fmt::print("Error: {}\n", e.what());
+            return;
+        }
+
+        if (tune_params.profile_path.empty()) {
+            tune_params.profile_path = default_tune_profile_path(render_params.volume_path);
+        }
+
+        if (!no_pipeline_cache) {
+            render_params.pipeline_cache_dir = default_pipeline_cache_dir();
+        }
+
+        if (!quiet) {
+            LOGGER.add_sink<ConsoleSink>();
+        }
+
+        if (!log_output.empty()) {
+            LOGGER.add_sink<FileSink>(log_output);
+        }
+
+        std::unique_ptr<Display> display;
+
+        try {
+            // Only the render times are measured, so the frames are not saved
+            display = create_headless_backend(headless_config, "");
+        } catch (const Error& e) {
+            fmt::print("Error: Failed to initialize backend: {}\n", e.what());
+            return;
+        }
+
+        try {
+            tune_main_loop(display.get(), render_params, tune_params);
         } catch (const Error& e) {
             fmt::print("Error: {}\n", e.what());
         }
@@ -235,9 +414,17 @@ int main(int argc, const char* argv[]) {
     } else if (subcommand == "sysinfo") {
         sysinfo();
     } else if (subcommand == "render") {
-        render(args);
+        // Failures are reported in the exit status as well, so that the render tests notice them
+        return render(args) ? EXIT_SUCCESS : EXIT_FAILURE;
     } else if (subcommand == "convert") {
         convert(args);
+    } else if (subcommand == "bench-scan") {
+        bench_scan(args);
+    } else if (subcommand == "compare") {
+        // Report mismatches in the exit status, so that comparisons can be scripted
+        return compare(args) ? EXIT_SUCCESS : EXIT_FAILURE;
+    } else if (subcommand == "tune") {
+        tune(args);
     } else {
         fmt::print("Error: Invalid subcommand '{}', see '{} help'\n", subcommand, argv[0]);
     }
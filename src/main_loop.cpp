@@ -1,30 +1,44 @@
 #include "main_loop.h"
 #include <chrono>
+#include <filesystem>
+#include <system_error>
 #include <memory>
 #include <array>
 #include <algorithm>
+#include <utility>
+#include <limits>
 #include <cassert>
 #include <fmt/format.h>
 #include "backend/Event.h"
 #include "backend/Display.h"
 #include "render/RenderAlgorithm.h"
 #include "render/SvoRaytraceAlgorithm.h"
+#include "render/CompactSvoRaytraceAlgorithm.h"
 #include "render/DdaRaytraceAlgorithm.h"
 #include "render/RenderContext.h"
 #include "render/MultiplexRenderer.h"
+#include "render/TuneProfile.h"
+#include "render/cpu/CpuRenderer.h"
+#include "render/cpu/CpuDdaAlgorithm.h"
+#include "render/cpu/CpuSvoAlgorithm.h"
 #include "camera/Camera.h"
 #include "camera/OrbitCameraController.h"
 #include "camera/ScriptCameraController.h"
+#include "math/Quat.h"
 #include "core/Logger.h"
 #include "core/Error.h"
 #include "model/Grid.h"
 #include "model/Octree.h"
+#include "model/CompactOctree.h"
+#include "model/TransferFunction.h"
 #include "resources.h"
 
 namespace {
     enum class FileType {
         Tiff,
+        Volume,
         Svo,
+        CompactSvo,
         Unknown
     };
 
@@ -39,7 +53,9 @@ namespace {
         ShaderOption{"svo-naive", FileType::Svo, resources::open("resources/svo_naive.comp")},
         ShaderOption{"esvo", FileType::Svo, resources::open("resources/esvo.comp")},
         ShaderOption{"svo-df", FileType::Svo, resources::open("resources/svo_df.comp")},
-        ShaderOption{"svo-rope", FileType::Svo, resources::open("resources/svo_rope.comp")}
+        ShaderOption{"svo-rope", FileType::Svo, resources::open("resources/svo_rope.comp")},
+        ShaderOption{"esvo-compact", FileType::CompactSvo, resources::open("resources/esvo_compact.comp")},
+        ShaderOption{"svo-df-compact", FileType::CompactSvo, resources::open("resources/svo_df_compact.comp")}
     };
 
     void check_setup(Display* display) {
@@ -72,8 +88,12 @@ namespace {
         switch (ft) {
             case FileType::Tiff:
                 return "tiff";
+            case FileType::Volume:
+                return "volume";
             case FileType::Svo:
                 return "svo";
+            case FileType::CompactSvo:
+                return "compact-svo";
             default:
             case FileType::Unknown:
                 return "unknown";
@@ -83,8 +103,12 @@ namespace {
     FileType parse_file_type(std::string_view str) {
         if (str == "tiff" || str == "tif") {
             return FileType::Tiff;
+        } else if (str == "volume" || str == "vol") {
+            return FileType::Volume;
         } else if (str == "svo") {
             return FileType::Svo;
+        } else if (str == "compact-svo") {
+            return FileType::CompactSvo;
         }
 
         return FileType::Unknown;
@@ -95,6 +119,11 @@ namespace {
             return parse_file_type(render_params.volume_type_override);
         }
 
+        // Raw volumes can be told apart by their header regardless of their extension
+        if (Grid::is_volume(render_params.volume_path)) {
+            return FileType::Volume;
+        }
+
         std::string_view extension = render_params.volume_path.extension().native();
         if (extension.empty()) {
             return FileType::Unknown;
@@ -103,7 +132,20 @@ namespace {
         // Move past the dot
         extension.remove_prefix(1);
 
-        return parse_file_type(extension);
+        auto file_type = parse_file_type(extension);
+
+        // Compact octrees share the svo extension, but can be told apart by their header
+        if (file_type == FileType::Svo && CompactOctree::is_compact_svo(render_params.volume_path)) {
+            return FileType::CompactSvo;
+        }
+
+        return file_type;
+    }
+
+    // Raw volumes are loaded into the same kind of grid as TIFF images, and so are rendered by the same shaders.
+    bool shader_accepts(const ShaderOption& opt, FileType volume_type) {
+        return opt.required_type == volume_type ||
+            (opt.required_type == FileType::Tiff && volume_type == FileType::Volume);
     }
 
     const ShaderOption& select_shader(const RenderParameters& render_params, FileType volume_type) {
@@ -114,7 +156,7 @@ namespace {
 
             if (it == SHADER_OPTIONS.end()) {
                 throw Error("Invalid shader '{}'", render_params.shader);
-            } else if (it->required_type == volume_type) {
+            } else if (shader_accepts(*it, volume_type)) {
                 return *it;
             } else {
                 throw Error(
@@ -128,7 +170,7 @@ namespace {
             // Select a default: the first one of the right file type appearing in the SHADER_OPTIONS list
 
             for (const auto& opt : SHADER_OPTIONS) {
-                if (opt.required_type == volume_type) {
+                if (shader_accepts(opt, volume_type)) {
                     return opt;
                 }
             }
@@ -137,34 +179,192 @@ namespace {
         }
     }
 
-    struct CreateRenderAlgorithmResult {
-        std::unique_ptr<RenderAlgorithm> algo;
-        Vec3Sz model_dim;
+    // How often the transfer function file is checked for modifications
+    constexpr const auto TRANSFER_FUNCTION_POLL_INTERVAL = std::chrono::milliseconds{250};
+
+    // See --workgroup
+    constexpr const auto DEFAULT_WORKGROUP_SIZE = Vec2<uint32_t>{8, 8};
+
+    // The workgroup sizes that are timed by tune_main_loop
+    constexpr const auto TUNE_WORKGROUP_SIZES = std::array {
+        Vec2<uint32_t>{8, 4},
+        Vec2<uint32_t>{8, 8},
+        Vec2<uint32_t>{16, 4},
+        Vec2<uint32_t>{16, 8},
+        Vec2<uint32_t>{8, 16},
+        Vec2<uint32_t>{16, 16},
+        Vec2<uint32_t>{32, 4},
+        Vec2<uint32_t>{32, 8}
     };
 
-    CreateRenderAlgorithmResult create_render_algorithm(const RenderParameters& render_params) {
+    // Frames which are rendered before each configuration is timed, so that the first frames, which
+    // may be slower for reasons unrelated to the configuration, are not counted
+    constexpr const size_t TUNE_WARMUP_FRAMES = 5;
+
+    TransferFunction load_transfer_function(const RenderParameters& render_params, const Grid& grid) {
+        if (render_params.transfer_function_path.empty()) {
+            return TransferFunction::grayscale();
+        }
+
+        if (grid.format() == VoxelFormat::Rgba8) {
+            throw Error("--transfer-function requires a volume of a scalar voxel format");
+        }
+
+        LOGGER.log("Loading transfer function from '{}'", render_params.transfer_function_path.native());
+        return TransferFunction::load(render_params.transfer_function_path);
+    }
+
+    std::shared_ptr<Grid> load_grid(const RenderParameters& render_params, FileType model_type) {
+        if (model_type == FileType::Volume) {
+            if (!render_params.voxel_format.empty()) {
+                throw Error("--voxel-format is not applicable to volume files, which store their own format");
+            }
+
+            auto grid = std::make_shared<Grid>(Grid::load_volume(render_params.volume_path));
+            LOGGER.log("Voxel format: '{}'", voxel_format_to_string(grid->format()));
+            return grid;
+        }
+
+        auto format = VoxelFormat::Rgba8;
+        if (!render_params.voxel_format.empty()) {
+            auto parsed = parse_voxel_format(render_params.voxel_format);
+            if (!parsed) {
+                throw Error("Invalid voxel format '{}'", render_params.voxel_format);
+            }
+
+            format = parsed.value();
+        }
+
+        LOGGER.log("Voxel format: '{}'", voxel_format_to_string(format));
+        return std::make_shared<Grid>(Grid::load_tiff(render_params.volume_path, hardware_threads(), Grid::Layout::Linear, format));
+    }
+
+    // Determine the type of the model, and the shader with which it is rendered.
+    std::pair<FileType, const ShaderOption&> select_model_shader(const RenderParameters& render_params) {
         FileType model_type = guess_file_type(render_params);
         if (model_type == FileType::Unknown) {
             throw Error("Failed to parse model file type");
         }
 
+        if (!render_params.transfer_function_path.empty() && model_type != FileType::Tiff && model_type != FileType::Volume) {
+            throw Error("--transfer-function requires a volume of a scalar voxel format");
+        }
+
         LOGGER.log("Model file type: '{}'", file_type_to_string(model_type));
-        const ShaderOption shader = select_shader(render_params, model_type);
+        const ShaderOption& shader = select_shader(render_params, model_type);
         LOGGER.log("Using shader '{}'", shader.option);
 
+        return {model_type, shader};
+    }
+
+    SvoTraversal svo_traversal(const ShaderOption& shader) {
+        if (shader.option == "svo-naive") {
+            return SvoTraversal::Naive;
+        } else if (shader.option == "esvo" || shader.option == "esvo-compact") {
+            return SvoTraversal::Esvo;
+        } else if (shader.option == "svo-rope") {
+            return SvoTraversal::Rope;
+        }
+
+        return SvoTraversal::DepthFirst;
+    }
+
+    // A volume which is loaded once, and can then be rendered by every shader that accepts its type.
+    struct Model {
+        FileType type;
+        std::shared_ptr<Grid> grid;
+        std::shared_ptr<Octree> octree;
+        std::shared_ptr<CompactOctree> compact_octree;
+        Vec3Sz dim;
+    };
+
+    Model load_model(const RenderParameters& render_params, FileType model_type) {
+        auto model = Model{model_type, nullptr, nullptr, nullptr, Vec3Sz(0)};
+
         switch (model_type) {
-            case FileType::Tiff: {
+            case FileType::Tiff:
+            case FileType::Volume:
+                model.grid = load_grid(render_params, model_type);
+                model.dim = model.grid->dimensions();
+                break;
+            case FileType::Svo:
+                model.octree = std::make_shared<Octree>(Octree::load_svo(render_params.volume_path));
+                model.dim = Vec3Sz(model.octree->side());
+                break;
+            case FileType::CompactSvo:
+                model.compact_octree = std::make_shared<CompactOctree>(CompactOctree::load_svo(render_params.volume_path));
+                model.dim = Vec3Sz(model.compact_octree->side());
+                break;
+            default:
+                assert(false); // make compiler happy
+        }
+
+        return model;
+    }
+
+    std::unique_ptr<RenderAlgorithm> create_render_algorithm(const Model& model, const ShaderOption& shader, const RenderParameters& render_params) {
+        switch (model.type) {
+            case FileType::Tiff:
+            case FileType::Volume:
                 // There is only one DDA shader, so that should always be picked here
-                auto grid = std::make_shared<Grid>(Grid::load_tiff(render_params.volume_path));
+                return std::make_unique<DdaRaytraceAlgorithm>(
+                    model.grid,
+                    load_transfer_function(render_params, *model.grid),
+                    !render_params.disable_empty_space_skipping
+                );
+            case FileType::Svo:
+                return std::make_unique<SvoRaytraceAlgorithm>(shader.source, model.octree);
+            case FileType::CompactSvo:
+                return std::make_unique<CompactSvoRaytraceAlgorithm>(shader.source, model.compact_octree);
+            default:
+                assert(false); // make compiler happy
+        }
+    }
+
+    struct CreateRenderAlgorithmResult {
+        std::unique_ptr<RenderAlgorithm> algo;
+        Vec3Sz model_dim;
+    };
+
+    CreateRenderAlgorithmResult create_render_algorithm(const RenderParameters& render_params) {
+        auto [model_type, shader] = select_model_shader(render_params);
+        auto model = load_model(render_params, model_type);
+        return {create_render_algorithm(model, shader, render_params), model.dim};
+    }
+
+    struct CreateCpuRenderAlgorithmResult {
+        std::unique_ptr<CpuRenderAlgorithm> algo;
+        Vec3Sz model_dim;
+    };
+
+    // Create the CPU implementation of the selected shader, see create_render_algorithm.
+    CreateCpuRenderAlgorithmResult create_cpu_render_algorithm(const RenderParameters& render_params) {
+        auto [model_type, shader] = select_model_shader(render_params);
+
+        switch (model_type) {
+            case FileType::Tiff:
+            case FileType::Volume: {
+                auto grid = load_grid(render_params, model_type);
                 return {
-                    std::make_unique<DdaRaytraceAlgorithm>(grid),
+                    std::make_unique<CpuDdaAlgorithm>(
+                        grid,
+                        load_transfer_function(render_params, *grid),
+                        !render_params.disable_empty_space_skipping
+                    ),
                     grid->dimensions()
                 };
             }
             case FileType::Svo: {
                 auto octree = std::make_shared<Octree>(Octree::load_svo(render_params.volume_path));
                 return {
-                    std::make_unique<SvoRaytraceAlgorithm>(shader.source, octree),
+                    std::make_unique<CpuSvoAlgorithm>(octree, svo_traversal(shader)),
+                    Vec3Sz(octree->side())
+                };
+            }
+            case FileType::CompactSvo: {
+                auto octree = std::make_shared<CompactOctree>(CompactOctree::load_svo(render_params.volume_path));
+                return {
+                    std::make_unique<CpuCompactSvoAlgorithm>(octree, svo_traversal(shader)),
                     Vec3Sz(octree->side())
                 };
             }
@@ -186,94 +386,349 @@ namespace {
             return std::make_unique<ScriptCameraController>(render_params.camera);
         }
     }
+
+    RenderContext::ShaderParameters shader_parameters(const RenderParameters& render_params, Vec3Sz dim) {
+        LOGGER.log("Model dimensions: {}x{}x{}", dim.x, dim.y, dim.z);
+
+        if (render_params.composite) {
+            LOGGER.log(
+                "Compositing with absorption coefficient {} and termination threshold {}",
+                render_params.absorption_coeff,
+                render_params.termination_threshold
+            );
+        }
+
+        if (render_params.lod_bias > 0) {
+            LOGGER.log("Octree level of detail bias: {} pixels", render_params.lod_bias);
+        }
+
+        return RenderContext::ShaderParameters {
+            .voxel_ratio = Vec4F(render_params.voxel_ratio, 0),
+            .model_dim = Vec4<unsigned>(static_cast<Vec3<unsigned>>(dim), 0),
+            .emission_coeff = render_params.emission_coeff,
+            .absorption_coeff = render_params.absorption_coeff,
+            .termination_threshold = render_params.termination_threshold,
+            .composite = render_params.composite ? 1u : 0u,
+            .lod_bias = render_params.lod_bias
+        };
+    }
+
+    // The name of a render device, by which it is found in a TuneProfile.
+    std::string device_name(Display* display, size_t device_index) {
+        return std::string(display->render_device(device_index).device.physical_device().getProperties().deviceName);
+    }
+
+    bool workgroup_size_supported(Display* display, Vec2<uint32_t> workgroup_size) {
+        for (size_t i = 0; i < display->num_render_devices(); ++i) {
+            const auto& limits = display->render_device(i).device.physical_device().getProperties().limits;
+            if (workgroup_size.x > limits.maxComputeWorkGroupSize[0] ||
+                workgroup_size.y > limits.maxComputeWorkGroupSize[1] ||
+                workgroup_size.x * workgroup_size.y > limits.maxComputeWorkGroupInvocations) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Fill in the shader and workgroup size from the tuning profile, if they were not given. `profile` must
+    // outlive the returned parameters, as the shader name refers into it.
+    RenderParameters apply_tune_profile(Display* display, const RenderParameters& render_params, TuneProfile& profile) {
+        auto params = render_params;
+        if (!params.shader.empty() && params.workgroup_size.x != 0) {
+            return params;
+        }
+
+        auto path = render_params.profile_path;
+        if (path.empty()) {
+            path = default_tune_profile_path(render_params.volume_path);
+            if (!std::filesystem::exists(path)) {
+                return params;
+            }
+        }
+
+        profile = TuneProfile::load(path);
+
+        const auto name = device_name(display, 0);
+        const auto* entry = profile.find(name);
+        if (!entry) {
+            LOGGER.log("Profile '{}' has no entry for '{}'", path.native(), name);
+            return params;
+        }
+
+        LOGGER.log("Using profile '{}'", path.native());
+
+        // The workgroup size was tuned for the shader of the entry, so it does not apply to others
+        if (!params.shader.empty() && params.shader != entry->shader) {
+            return params;
+        }
+
+        params.shader = entry->shader;
+        if (params.workgroup_size.x == 0) {
+            params.workgroup_size = {entry->workgroup_size.width, entry->workgroup_size.height};
+        }
+
+        return params;
+    }
+
+    // The camera of a frame of the sweep with which tune_main_loop times each configuration: one orbit
+    // around the volume, slightly from above, so that rays cross both dense and empty parts of it.
+    Camera sweep_camera(size_t frame, size_t frames) {
+        const float yaw = 2.f * 3.14159265f * static_cast<float>(frame) / static_cast<float>(frames);
+        const auto rotation = QuatF::axis_angle(0, 1, 0, yaw) * QuatF::axis_angle(1, 0, 0, 0.4f);
+        const auto forward = rotation.forward();
+
+        return Camera {
+            .forward = forward,
+            .up = rotation.up(),
+            .translation = Vec3F(0.5f) - forward * 2.f
+        };
+    }
+
+    // The average render time per frame of the sweep, in ms.
+    double time_sweep(MultiplexRenderer& renderer, size_t frames) {
+        auto warmup = RenderStatsAccumulator();
+        for (size_t i = 0; i < TUNE_WARMUP_FRAMES; ++i) {
+            renderer.render(sweep_camera(i, frames));
+        }
+
+        renderer.finish();
+        renderer.collect_stats(warmup);
+
+        auto accum = RenderStatsAccumulator();
+        for (size_t i = 0; i < frames; ++i) {
+            renderer.render(sweep_camera(i, frames));
+            renderer.collect_stats(accum);
+        }
+
+        renderer.finish();
+        renderer.collect_stats(accum);
+
+        return accum.total_render_time() / static_cast<double>(frames);
+    }
+
+    // Render frames until the camera controller is done or the program is closed. The renderer is either
+    // a MultiplexRenderer or a CpuRenderer. The display is null when rendering on the CPU.
+    template <typename R>
+    void render_loop(EventDispatcher& dispatcher, Display* display, R& renderer, const RenderParameters& render_params) {
+        auto controller = create_camera_controller(dispatcher, render_params);
+
+        bool quit = false;
+        dispatcher.bind_close([&quit] {
+            quit = true;
+        });
+
+        dispatcher.bind(Key::Escape, [&quit](Action) {
+            quit = true;
+        });
+
+        const auto& tf_path = render_params.transfer_function_path;
+        auto tf_write_time = tf_path.empty() ? std::filesystem::file_time_type() : std::filesystem::last_write_time(tf_path);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        auto last_tf_poll = start;
+        auto last_frame = start;
+        size_t frames = 0;
+        size_t total_frames = 0;
+
+        auto accum = RenderStatsAccumulator();
+        accum.start();
+
+        LOGGER.log("Starting render loop...");
+        while (!quit) {
+            ++frames;
+            ++total_frames;
+
+            renderer.render(controller->camera());
+            renderer.collect_stats(accum);
+
+            auto frame_end = std::chrono::high_resolution_clock::now();
+            float dt = std::chrono::duration<float>(frame_end - last_frame).count();
+
+            if (total_frames % render_params.repeat == 0) {
+                if (controller->update(dt)) {
+                    break;
+                }
+            }
+
+            last_frame = frame_end;
+
+            auto now = std::chrono::high_resolution_clock::now();
+            auto diff = std::chrono::duration<double>(now - start);
+
+            if (diff > std::chrono::seconds{5}) {
+                LOGGER.log("FPS: {}", static_cast<double>(frames) / diff.count());
+                frames = 0;
+                start = now;
+            }
+
+            if (!tf_path.empty() && now - last_tf_poll > TRANSFER_FUNCTION_POLL_INTERVAL) {
+                last_tf_poll = now;
+
+                // Keep rendering with the previous transfer function if the new one is incomplete or invalid,
+                // as it might be in the middle of being edited.
+                auto ec = std::error_code();
+                const auto write_time = std::filesystem::last_write_time(tf_path, ec);
+
+                if (!ec && write_time != tf_write_time) {
+                    tf_write_time = write_time;
+
+                    try {
+                        renderer.upload_transfer_function(TransferFunction::load(tf_path));
+                        LOGGER.log("Reloaded transfer function");
+                    } catch (const Error& e) {
+                        LOGGER.log("Failed to reload transfer function: {}", e.what());
+                    }
+                }
+            }
+
+            if (display) {
+                display->poll_events();
+            }
+        }
+
+        renderer.finish();
+        renderer.collect_stats(accum);
+
+        accum.stop();
+        LOGGER.log(
+            "total rays: {}, total render time: {}ms, mray/s: {}",
+            accum.total_rays(),
+            accum.total_render_time(),
+            accum.mrays_per_s()
+        );
+
+        LOGGER.log(
+            "frames: {}, fps: {}, total time: {}s",
+            accum.frames(),
+            accum.fps(),
+            accum.total_time().count()
+        );
+
+        if (!render_params.stats_save_path.empty()) {
+            accum.save(render_params.stats_save_path);
+            LOGGER.log("Saved stats to '{}'", render_params.stats_save_path.native());
+        }
+    }
 }
 
 void main_loop(EventDispatcher& dispatcher, Display* display, const RenderParameters& render_params) {
     check_setup(display);
 
-    auto [algo, dim] = create_render_algorithm(render_params);
-    LOGGER.log("Model dimensions: {}x{}x{}", dim.x, dim.y, dim.z);
-
-    auto shader_params = RenderContext::ShaderParameters {
-        .voxel_ratio = Vec4F(render_params.voxel_ratio, 0),
-        .model_dim = Vec4<unsigned>(static_cast<Vec3<unsigned>>(dim), 0),
-        .emission_coeff = render_params.emission_coeff
-    };
+    auto profile = TuneProfile();
+    const auto params = apply_tune_profile(display, render_params, profile);
 
-    auto renderer = MultiplexRenderer(display, std::move(algo), shader_params);
-
-    auto controller = create_camera_controller(dispatcher, render_params);
+    auto [algo, dim] = create_render_algorithm(params);
+    auto workgroup_size = params.workgroup_size;
+    if (workgroup_size.x == 0) {
+        workgroup_size = DEFAULT_WORKGROUP_SIZE;
+    }
 
-    bool quit = false;
-    dispatcher.bind_close([&quit] {
-        quit = true;
-    });
+    LOGGER.log("Workgroup size: {}x{}", workgroup_size.x, workgroup_size.y);
 
-    dispatcher.bind(Key::Escape, [&quit](Action) {
-        quit = true;
-    });
+    auto renderer = MultiplexRenderer(
+        display,
+        std::move(algo),
+        shader_parameters(params, dim),
+        workgroup_size,
+        params.pipeline_cache_dir
+    );
 
     dispatcher.bind_swapchain_recreate([&renderer](size_t device, size_t output) {
         LOGGER.log("Resizing device {}, output {}", device, output);
         renderer.recreate(device, output);
     });
 
-    auto start = std::chrono::high_resolution_clock::now();
-    auto last_frame = start;
-    size_t frames = 0;
-    size_t total_frames = 0;
+    render_loop(dispatcher, display, renderer, params);
+}
 
-    auto accum = RenderStatsAccumulator();
-    accum.start();
+void tune_main_loop(Display* display, const RenderParameters& render_params, const TuneParameters& tune_params) {
+    check_setup(display);
 
-    LOGGER.log("Starting render loop...");
-    while (!quit) {
-        ++frames;
-        ++total_frames;
+    const FileType model_type = guess_file_type(render_params);
+    if (model_type == FileType::Unknown) {
+        throw Error("Failed to parse model file type");
+    }
 
-        renderer.render(controller->camera());
-        accum(renderer.stats());
+    LOGGER.log("Model file type: '{}'", file_type_to_string(model_type));
 
-        auto frame_end = std::chrono::high_resolution_clock::now();
-        float dt = std::chrono::duration<float>(frame_end - last_frame).count();
+    const auto model = load_model(render_params, model_type);
+    const auto shader_params = shader_parameters(render_params, model.dim);
 
-        if (total_frames % render_params.repeat == 0) {
-            if (controller->update(dt)) {
-                break;
-            }
-        }
+    const ShaderOption* best_shader = nullptr;
+    auto best_workgroup_size = Vec2<uint32_t>{0, 0};
+    double best_time = std::numeric_limits<double>::max();
 
-        last_frame = frame_end;
+    for (const auto& shader : SHADER_OPTIONS) {
+        if (!shader_accepts(shader, model_type)) {
+            continue;
+        }
 
-        auto now = std::chrono::high_resolution_clock::now();
-        auto diff = std::chrono::duration<double>(now - start);
+        for (const auto workgroup_size : TUNE_WORKGROUP_SIZES) {
+            if (!workgroup_size_supported(display, workgroup_size)) {
+                LOGGER.log("Skipping workgroup size {}x{}, which is not supported", workgroup_size.x, workgroup_size.y);
+                continue;
+            }
 
-        if (diff > std::chrono::seconds{5}) {
-            LOGGER.log("FPS: {}", static_cast<double>(frames) / diff.count());
-            frames = 0;
-            start = now;
+            auto renderer = MultiplexRenderer(
+                display,
+                create_render_algorithm(model, shader, render_params),
+                shader_params,
+                workgroup_size,
+                render_params.pipeline_cache_dir
+            );
+
+            const double time = time_sweep(renderer, tune_params.frames);
+            LOGGER.log("Shader '{}', workgroup size {}x{}: {:.3f}ms", shader.option, workgroup_size.x, workgroup_size.y, time);
+
+            if (time < best_time) {
+                best_shader = &shader;
+                best_workgroup_size = workgroup_size;
+                best_time = time;
+            }
         }
+    }
 
-        display->poll_events();
+    if (!best_shader) {
+        throw Error("None of the workgroup sizes are supported by the render devices");
     }
 
-    accum.stop();
     LOGGER.log(
-        "total rays: {}, total render time: {}ms, mray/s: {}",
-        accum.total_rays(),
-        accum.total_render_time(),
-        accum.mrays_per_s()
+        "Fastest: shader '{}', workgroup size {}x{} ({:.3f}ms)",
+        best_shader->option,
+        best_workgroup_size.x,
+        best_workgroup_size.y,
+        best_time
     );
 
-    LOGGER.log(
-        "frames: {}, fps: {}, total time: {}s",
-        accum.frames(),
-        accum.fps(),
-        accum.total_time().count()
-    );
+    // Keep the entries of other kinds of devices which were tuned before
+    auto profile = TuneProfile();
+    if (std::filesystem::exists(tune_params.profile_path)) {
+        profile = TuneProfile::load(tune_params.profile_path);
+    }
 
-    if (!render_params.stats_save_path.empty()) {
-        accum.save(render_params.stats_save_path);
-        LOGGER.log("Saved stats to '{}'", render_params.stats_save_path.native());
+    for (size_t i = 0; i < display->num_render_devices(); ++i) {
+        profile.update({
+            device_name(display, i),
+            std::string(best_shader->option),
+            vk::Extent2D{best_workgroup_size.x, best_workgroup_size.y}
+        });
     }
+
+    profile.save(tune_params.profile_path);
+    LOGGER.log("Saved profile to '{}'", tune_params.profile_path.native());
+}
+
+void cpu_main_loop(EventDispatcher& dispatcher, const CpuParameters& cpu_params, const RenderParameters& render_params) {
+    auto [algo, dim] = create_cpu_render_algorithm(render_params);
+    auto renderer = CpuRenderer(
+        std::move(algo),
+        shader_parameters(render_params, dim),
+        cpu_params.extent,
+        cpu_params.threads,
+        find_packet_isa(cpu_params.simd),
+        cpu_params.output
+    );
+
+    render_loop(dispatcher, nullptr, renderer, render_params);
 }
@@ -4,6 +4,7 @@
 #include <string_view>
 #include <filesystem>
 #include <cstddef>
+#include <cstdint>
 #include "utility/Span.h"
 #include "math/Vec.h"
 
@@ -13,14 +14,58 @@ struct Display;
 struct RenderParameters {
     std::filesystem::path volume_path;
     std::string_view volume_type_override;
+    std::string_view voxel_format;
+    std::filesystem::path transfer_function_path;
+    bool disable_empty_space_skipping = false;
     std::string_view shader;
     std::filesystem::path stats_save_path;
+
+    // The directory in which compiled pipelines are cached, or empty to not cache them on disk
+    std::filesystem::path pipeline_cache_dir;
     Vec3F voxel_ratio = Vec3F(1, 1, 1);
     std::string_view camera;
     float emission_coeff = 1.f;
+    bool composite = false;
+    float absorption_coeff = 1.f;
+    float termination_threshold = 0.01f;
+    float lod_bias = 0.f;
     size_t repeat = 1;
+
+    // The workgroup size of the shaders, or 0x0 for the default
+    Vec2<uint32_t> workgroup_size = {0, 0};
+
+    // The tuning profile from which the shader and workgroup size are taken if they are not given, or empty
+    // for the default profile of the volume, see 'xenodon help tune'
+    std::filesystem::path profile_path;
+};
+
+// Parameters of rendering on the CPU instead of with Vulkan, see CpuRenderer.
+struct CpuParameters {
+    Vec2<uint32_t> extent;
+    size_t threads;
+
+    // The instruction set with which rays are traced in packets, or empty for the default, see find_packet_isa
+    std::string_view simd;
+
+    // The output path format of the frames, or empty to discard them
+    std::string_view output;
+};
+
+// Parameters of 'xenodon tune', see tune_main_loop.
+struct TuneParameters {
+    // The number of frames of the camera sweep with which each configuration is timed
+    size_t frames;
+
+    // The profile which is written, see TuneProfile
+    std::filesystem::path profile_path;
 };
 
 void main_loop(EventDispatcher& dispatcher, Display* display, const RenderParameters& render_params);
 
+// Time the camera sweep with every shader that accepts the volume, and a number of workgroup sizes, and
+// save the fastest to the profile.
+void tune_main_loop(Display* display, const RenderParameters& render_params, const TuneParameters& tune_params);
+
+void cpu_main_loop(EventDispatcher& dispatcher, const CpuParameters& cpu_params, const RenderParameters& render_params);
+
 #endif
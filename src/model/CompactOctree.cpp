@@ -0,0 +1,158 @@
+#include "model/CompactOctree.h"
+#include <unordered_map>
+#include <array>
+#include <fstream>
+#include <string_view>
+#include <cstring>
+#include <fmt/format.h>
+#include "core/Error.h"
+#include "utility/serialization.h"
+
+namespace {
+    constexpr const std::string_view COMPACT_SVO_FMT_ID = "XNDN-SVC";
+
+    // The 8 consecutive children of a node
+    using Children = std::array<CompactOctree::Node, 8>;
+
+    struct ChildrenHash {
+        size_t operator()(const Children& children) const {
+            // Combined like boost's hash_combine
+            size_t v = 0;
+            for (const auto& child : children) {
+                v ^= std::hash<uint32_t>{}(child.first_child) + 0x9e3779b9 + (v << 6) + (v >> 2);
+                v ^= std::hash<uint32_t>{}(child.color.pack()) + 0x9e3779b9 + (v << 6) + (v >> 2);
+            }
+
+            return v;
+        }
+    };
+
+    struct ChildrenEqual {
+        bool operator()(const Children& lhs, const Children& rhs) const {
+            return std::memcmp(lhs.data(), rhs.data(), sizeof(Children)) == 0;
+        }
+    };
+
+    struct Converter {
+        Span<Octree::Node> src;
+        std::vector<CompactOctree::Node> nodes;
+
+        // Index of the children of source nodes that were already converted
+        std::unordered_map<uint32_t, uint32_t> converted;
+
+        // Index of each distinct group of children
+        std::unordered_map<Children, uint32_t, ChildrenHash, ChildrenEqual> cache;
+
+        CompactOctree::Node convert(uint32_t index) {
+            const auto& node = this->src[index];
+            if (node.is_leaf()) {
+                return {CompactOctree::LEAF, node.color};
+            }
+
+            return {this->convert_children(index), node.color};
+        }
+
+        // Convert the children of an interior node, and return the index of the first child
+        uint32_t convert_children(uint32_t index) {
+            if (auto it = this->converted.find(index); it != this->converted.end()) {
+                return it->second;
+            }
+
+            auto children = Children();
+            for (size_t i = 0; i < 8; ++i) {
+                children[i] = this->convert(this->src[index].children[i]);
+            }
+
+            // Nodes are inserted after their children, so that shared groups are detected. This means that
+            // unlike in Octree, a first child index can be lower than the index of the node itself.
+            const auto [it, inserted] = this->cache.insert({children, static_cast<uint32_t>(this->nodes.size())});
+            if (inserted) {
+                if (this->nodes.size() + 8 > CompactOctree::CHILD_MASK) {
+                    throw Error("Octree too large for the compact format");
+                }
+
+                this->nodes.insert(this->nodes.end(), children.begin(), children.end());
+            }
+
+            this->converted.insert({index, it->second});
+            return it->second;
+        }
+    };
+}
+
+CompactOctree::CompactOctree(size_t dim, std::vector<Node>&& nodes):
+    dim(dim), nodes(std::move(nodes)), view(this->nodes) {
+}
+
+CompactOctree::CompactOctree(size_t dim, MappedFile&& mapping, Span<Node> view):
+    dim(dim), mapping(std::move(mapping)), view(view) {
+}
+
+CompactOctree CompactOctree::from_octree(const Octree& octree) {
+    auto converter = Converter{octree.data(), {}, {}, {}};
+
+    // Reserve the first node for the root
+    converter.nodes.push_back({LEAF, Pixel{0, 0, 0, 0}});
+    converter.nodes[0] = converter.convert(Octree::ROOT);
+    converter.nodes.shrink_to_fit();
+
+    return CompactOctree(octree.side(), std::move(converter.nodes));
+}
+
+bool CompactOctree::is_compact_svo(const std::filesystem::path& path) {
+    auto in = std::ifstream(path, std::ios::binary);
+
+    char id[COMPACT_SVO_FMT_ID.size()];
+    in.read(id, COMPACT_SVO_FMT_ID.size());
+
+    return in && COMPACT_SVO_FMT_ID == std::string_view(id, COMPACT_SVO_FMT_ID.size());
+}
+
+CompactOctree CompactOctree::load_svo(const std::filesystem::path& path) {
+    auto mapping = MappedFile(path);
+    constexpr const size_t header_size = COMPACT_SVO_FMT_ID.size() + 2 * sizeof(uint64_t);
+
+    if (mapping.size() < header_size) {
+        throw Error("File too small");
+    }
+
+    const auto id = std::string_view(reinterpret_cast<const char*>(mapping.data()), COMPACT_SVO_FMT_ID.size());
+    if (COMPACT_SVO_FMT_ID != id) {
+        throw Error("Invalid format id");
+    }
+
+    uint64_t dim, num_nodes;
+    std::memcpy(&dim, mapping.data() + COMPACT_SVO_FMT_ID.size(), sizeof(uint64_t));
+    std::memcpy(&num_nodes, mapping.data() + COMPACT_SVO_FMT_ID.size() + sizeof(uint64_t), sizeof(uint64_t));
+
+    // See Octree::load_svo
+    const size_t data_size = mapping.size() - header_size;
+    if (data_size % sizeof(Node) != 0 || num_nodes != data_size / sizeof(Node)) {
+        throw Error("File size does not match number of nodes");
+    }
+
+    // See Octree::load_svo
+    static_assert(header_size % alignof(Node) == 0);
+    const auto view = Span<Node>(
+        static_cast<size_t>(num_nodes),
+        reinterpret_cast<const Node*>(mapping.data() + header_size)
+    );
+
+    return CompactOctree(static_cast<size_t>(dim), std::move(mapping), view);
+}
+
+void CompactOctree::save_svo(const std::filesystem::path& path) const {
+    auto out = std::ofstream(path, std::ios::binary);
+    if (!out) {
+        throw Error("Failed to open");
+    }
+
+    out.write(COMPACT_SVO_FMT_ID.data(), COMPACT_SVO_FMT_ID.size());
+    write_uint_le(out, this->dim);
+    write_uint_le(out, this->view.size());
+
+    for (const auto& node : this->view) {
+        write_uint_le(out, node.first_child);
+        write_uint_le(out, node.color.pack());
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef _XENODON_MODEL_COMPACTOCTREE_H
+#define _XENODON_MODEL_COMPACTOCTREE_H
+
+#include <vector>
+#include <filesystem>
+#include <cstddef>
+#include <cstdint>
+#include "model/Octree.h"
+#include "model/Pixel.h"
+#include "utility/Span.h"
+#include "utility/MappedFile.h"
+
+// An octree stored in 8-byte nodes, similar to 'Efficient Sparse Voxel Octrees' by Laine and Karras.
+// Instead of a pointer to each child, the 8 children of a node are stored consecutively, and each node
+// only points to its first child. Identical groups of children are shared, so the tree is stored as a DAG.
+// The root is always the first node.
+class CompactOctree {
+public:
+    constexpr const static uint32_t LEAF = Octree::LEAF;
+    constexpr const static uint32_t CHILD_MASK = ~LEAF;
+
+    // This struct should be kept in sync with resources/octree_compact.glsl
+    struct Node {
+        // For interior nodes, the index of the first of the 8 children. Leaves have the LEAF bit set.
+        uint32_t first_child;
+        Pixel color;
+
+        bool is_leaf() const {
+            return (this->first_child & LEAF) != 0;
+        }
+    };
+
+    static_assert(sizeof(Node) == 8, "Compiler didnt pack Node struct properly");
+
+private:
+    size_t dim;
+
+    // See Octree
+    std::vector<Node> nodes;
+    MappedFile mapping;
+    Span<Node> view;
+
+public:
+    CompactOctree(size_t dim, std::vector<Node>&& nodes);
+
+    static CompactOctree from_octree(const Octree& octree);
+
+    // Check whether the file at `path` is a compact svo file, without loading it.
+    static bool is_compact_svo(const std::filesystem::path& path);
+
+    static CompactOctree load_svo(const std::filesystem::path& path);
+
+    void save_svo(const std::filesystem::path& path) const;
+
+    Span<Node> data() const {
+        return this->view;
+    }
+
+    size_t memory_footprint() const {
+        return sizeof(CompactOctree) + this->view.size() * sizeof(CompactOctree::Node);
+    }
+
+    size_t side() const {
+        return this->dim;
+    }
+
+private:
+    CompactOctree(size_t dim, MappedFile&& mapping, Span<Node> view);
+};
+
+#endif
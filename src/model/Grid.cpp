@@ -1,9 +1,18 @@
 #include "model/Grid.h"
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include <limits>
 #include <tiffio.h>
-#include <x86intrin.h>
+#include "model/GridScan.h"
 #include "core/Error.h"
+#include "utility/parallel.h"
+#include "utility/serialization.h"
 #include "fmt/format.h"
 
 namespace {
@@ -14,17 +23,280 @@ namespace {
     };
 
     using TiffPtr = std::unique_ptr<TIFF, TiffCloser>;
+
+    // Regions smaller than this are scanned directly even if a summed-volume table is present, as
+    // that is faster than the 8 scattered lookups into the table.
+    constexpr const size_t MIN_SUMMED_TABLE_QUERY = 4096;
+
+    constexpr const std::string_view VOL_FMT_ID = "XNDN-VOL";
+
+    // The voxel data of a volume file starts at an offset which is a multiple of this value, so that
+    // it is page aligned when the file is mapped.
+    constexpr const size_t VOL_DATA_ALIGNMENT = 4096;
+
+    // The number of layer ranges each TIFF decoding thread is given, see Grid::decode_tiff_layers.
+    constexpr const size_t RANGES_PER_THREAD = 4;
+
+    // Convert a float to the nearest half-precision float, rounding ties to even.
+    uint16_t float_to_half(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(float));
+
+        const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+        const uint32_t abs = bits & 0x7FFFFFFF;
+
+        if (abs > 0x7F800000) {
+            // NaN
+            return sign | 0x7E00;
+        } else if (abs >= 0x477FF000) {
+            // Infinity, or a value which rounds to 65520 or more
+            return sign | 0x7C00;
+        } else if (abs < 0x33000000) {
+            // Values of at most 2^-25 round to zero
+            return sign;
+        }
+
+        uint32_t half;
+        uint32_t shift;
+
+        if (abs < 0x38800000) {
+            // Subnormal halfs, which store the mantissa including the implicit bit shifted right
+            const uint32_t exponent = abs >> 23;
+            half = (abs & 0x7FFFFF) | 0x800000;
+            shift = 126 - exponent;
+        } else {
+            // Rebias the exponent from 127 to 15
+            half = abs - 0x38000000;
+            shift = 13;
+        }
+
+        const uint32_t remainder = half & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        half >>= shift;
+
+        if (remainder > halfway || (remainder == halfway && (half & 1) != 0)) {
+            // This may carry into the exponent, which is correct
+            ++half;
+        }
+
+        return sign | static_cast<uint16_t>(half);
+    }
+
+    // Store a voxel of a scalar format at index i of dst. For the normalized formats, the value is
+    // clamped to [0, 1].
+    void store_scalar(VoxelFormat format, uint8_t* dst, size_t i, float value) {
+        switch (format) {
+            case VoxelFormat::R8:
+                dst[i] = static_cast<uint8_t>(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+                break;
+            case VoxelFormat::R16: {
+                const auto v = static_cast<uint16_t>(std::clamp(value, 0.f, 1.f) * 65535.f + 0.5f);
+                std::memcpy(&dst[i * sizeof(uint16_t)], &v, sizeof(uint16_t));
+                break;
+            }
+            case VoxelFormat::R16F: {
+                const uint16_t v = float_to_half(value);
+                std::memcpy(&dst[i * sizeof(uint16_t)], &v, sizeof(uint16_t));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    // Decode the current directory of `tiff` into `dst` as the scalar `format`. `raster` is scratch space of
+    // at least width * height pixels. Rows are stored bottom to top, the same as TIFFReadRGBAImage does.
+    void decode_scalar_layer(TIFF* tiff, uint32_t width, uint32_t height, VoxelFormat format, uint8_t* dst, std::vector<uint32_t>& raster) {
+        uint16_t bits_per_sample, samples_per_pixel, sample_format, planar_config;
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLEFORMAT, &sample_format);
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_PLANARCONFIG, &planar_config);
+
+        const bool integer = sample_format == SAMPLEFORMAT_UINT && (bits_per_sample == 8 || bits_per_sample == 16);
+        const bool floating = sample_format == SAMPLEFORMAT_IEEEFP && bits_per_sample == 32;
+        const bool contiguous = samples_per_pixel == 1 || planar_config == PLANARCONFIG_CONTIG;
+
+        if (TIFFIsTiled(tiff) || !(integer || floating) || !contiguous) {
+            // TIFFReadRGBAImage handles every other kind of image, at the cost of precision
+            raster.resize(size_t{width} * height);
+            if (!TIFFReadRGBAImage(tiff, width, height, raster.data())) {
+                throw Error("Failed to decode layer");
+            }
+
+            for (size_t i = 0; i < raster.size(); ++i) {
+                store_scalar(format, dst, i, static_cast<float>(raster[i] & 0xFF) / 255.f);
+            }
+
+            return;
+        }
+
+        const auto scanline = std::unique_ptr<uint8_t[]>(new uint8_t[static_cast<size_t>(TIFFScanlineSize(tiff))]);
+        const size_t stride = samples_per_pixel * (bits_per_sample / 8);
+
+        for (uint32_t row = 0; row < height; ++row) {
+            if (TIFFReadScanline(tiff, scanline.get(), row, 0) < 0) {
+                throw Error("Failed to decode row {}", row);
+            }
+
+            const size_t base = size_t{height - row - 1} * width;
+
+            for (size_t x = 0; x < width; ++x) {
+                const uint8_t* sample = &scanline[x * stride];
+                float value;
+
+                if (bits_per_sample == 8) {
+                    value = static_cast<float>(sample[0]) / 255.f;
+                } else if (bits_per_sample == 16) {
+                    uint16_t v;
+                    std::memcpy(&v, sample, sizeof(uint16_t));
+                    value = static_cast<float>(v) / 65535.f;
+                } else {
+                    std::memcpy(&value, sample, sizeof(float));
+                }
+
+                store_scalar(format, dst, base + x, value);
+            }
+        }
+    }
+
+    // Assign consecutive slots to the bricks in the cube [offset, offset + side) of brick coordinates,
+    // in Morton order. Bricks outside the grid are skipped.
+    void assign_brick_slots(std::vector<uint32_t>& slots, Vec3Sz bricks, Vec3Sz offset, size_t side, uint32_t& next) {
+        if (offset.x >= bricks.x || offset.y >= bricks.y || offset.z >= bricks.z) {
+            return;
+        } else if (side == 1) {
+            slots[offset.x + (offset.y + offset.z * bricks.y) * bricks.x] = next++;
+            return;
+        }
+
+        const size_t h_side = side / 2;
+
+        for (auto xoff : {size_t{0}, h_side}) {
+            for (auto yoff : {size_t{0}, h_side}) {
+                for (auto zoff : {size_t{0}, h_side}) {
+                    assign_brick_slots(slots, bricks, {offset.x + xoff, offset.y + yoff, offset.z + zoff}, h_side, next);
+                }
+            }
+        }
+    }
+
+    // Call f(run, n) for the runs of voxels of the region [lo, hi) of a Morton ordered cube of `side`^3
+    // voxels, which starts at `cube` and lies at `offset` (in the same coordinates as the region).
+    template <typename F>
+    void scan_morton_cube(const Pixel* cube, Vec3Sz offset, size_t side, Vec3Sz lo, Vec3Sz hi, F& f) {
+        const bool disjoint = offset.x >= hi.x || offset.x + side <= lo.x ||
+            offset.y >= hi.y || offset.y + side <= lo.y ||
+            offset.z >= hi.z || offset.z + side <= lo.z;
+
+        const bool inside = offset.x >= lo.x && offset.x + side <= hi.x &&
+            offset.y >= lo.y && offset.y + side <= hi.y &&
+            offset.z >= lo.z && offset.z + side <= hi.z;
+
+        if (disjoint) {
+            return;
+        } else if (inside) {
+            f(cube, side * side * side);
+            return;
+        }
+
+        // The children of the cube are stored one after the other, in the same order as they are visited here
+        const size_t h_side = side / 2;
+        const size_t child_voxels = h_side * h_side * h_side;
+        const Pixel* child = cube;
+
+        for (auto xoff : {size_t{0}, h_side}) {
+            for (auto yoff : {size_t{0}, h_side}) {
+                for (auto zoff : {size_t{0}, h_side}) {
+                    scan_morton_cube(child, {offset.x + xoff, offset.y + yoff, offset.z + zoff}, h_side, lo, hi, f);
+                    child += child_voxels;
+                }
+            }
+        }
+    }
 }
 
 Grid::Grid(Vec3Sz dim):
-    dim(dim), data(std::make_unique<Pixel[]>(this->size())) {
+    dim(dim),
+    voxel_format(VoxelFormat::Rgba8),
+    voxel_layout(Layout::Linear),
+    data(std::make_unique<uint8_t[]>(this->size() * sizeof(Pixel))),
+    view(this->size() * sizeof(Pixel), this->data.get()),
+    bricks(0) {
+}
+
+Grid::Grid(Vec3Sz dim, Layout layout, VoxelFormat format):
+    dim(dim), voxel_format(format), voxel_layout(layout), view(nullptr), bricks(0) {
 
-    for (size_t i = 0; i < this->size(); ++i) {
-        this->data[i] = {0, 0, 0, 0};
+    if (layout == Layout::Linear) {
+        const size_t bytes = this->size() * voxel_size(format);
+        this->data = std::unique_ptr<uint8_t[]>(new uint8_t[bytes]);
+        this->view = Span<uint8_t>(bytes, this->data.get());
+        return;
+    } else if (format != VoxelFormat::Rgba8) {
+        throw Error("Only grids of the rgba8 format can have the bricked layout");
     }
+
+    this->bricks = (dim + (BRICK_SIDE - 1)) / BRICK_SIDE;
+    const size_t num_bricks = this->bricks.x * this->bricks.y * this->bricks.z;
+
+    if (num_bricks > std::numeric_limits<uint32_t>::max()) {
+        throw Error("Grid too large for the bricked layout");
+    }
+
+    size_t side = 1;
+    while (side < std::max({this->bricks.x, this->bricks.y, this->bricks.z})) {
+        side *= 2;
+    }
+
+    this->brick_slots.resize(num_bricks);
+    uint32_t next = 0;
+    assign_brick_slots(this->brick_slots, this->bricks, Vec3Sz(0), side, next);
+
+    // The padding of the bricks is never written otherwise, so all voxels are value-initialized.
+    const size_t bytes = num_bricks * BRICK_VOXELS * sizeof(Pixel);
+    this->data = std::make_unique<uint8_t[]>(bytes);
+    this->view = Span<uint8_t>(bytes, this->data.get());
+}
+
+size_t Grid::memory_required(Vec3Sz dim, Layout layout, VoxelFormat format) {
+    if (layout == Layout::Linear) {
+        return dim.x * dim.y * dim.z * voxel_size(format);
+    }
+
+    // See the bricked constructor: every dimension is padded up to whole bricks
+    const auto bricks = (dim + (BRICK_SIDE - 1)) / BRICK_SIDE;
+    return bricks.x * bricks.y * bricks.z * (BRICK_VOXELS * sizeof(Pixel) + sizeof(uint32_t));
 }
 
-Grid Grid::load_tiff(const std::filesystem::path& path) {
+Grid Grid::load_tiff(const std::filesystem::path& path, size_t threads, Layout layout, VoxelFormat format) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    const auto dim = Grid::tiff_dimensions(path);
+    const auto scanned = std::chrono::high_resolution_clock::now();
+    fmt::print("{}x{}x{} = {} pixels\n", dim.x, dim.y, dim.z, dim.x * dim.y * dim.z);
+
+    // Every layer is overwritten by the decoder, so the voxels are not value-initialized. This also
+    // means that their pages are first touched by the decoding threads.
+    auto grid = Grid(dim, layout, format);
+    const auto allocated = std::chrono::high_resolution_clock::now();
+
+    grid.decode_tiff_layers(path, 0, threads);
+    const auto decoded = std::chrono::high_resolution_clock::now();
+
+    const double decode_time = std::chrono::duration<double>(decoded - allocated).count();
+    fmt::print(
+        "Scanned directories in {:.3f}s, allocated in {:.3f}s, decoded in {:.3f}s ({:.2f} MiB/s, {} threads)\n",
+        std::chrono::duration<double>(scanned - start).count(),
+        std::chrono::duration<double>(allocated - scanned).count(),
+        decode_time,
+        static_cast<double>(grid.voxel_data().size()) / (1024.0 * 1024.0) / decode_time,
+        std::min(threads, dim.z)
+    );
+
+    return grid;
+}
+
+Vec3Sz Grid::tiff_dimensions(const std::filesystem::path& path) {
     auto tiff = TiffPtr(TIFFOpen(path.c_str(), "r"));
     if (!tiff) {
         throw Error("Failed to open");
@@ -57,32 +329,290 @@ Grid Grid::load_tiff(const std::filesystem::path& path) {
         ++depth;
     } while (TIFFReadDirectory(tiff.get()));
 
-    const size_t size = static_cast<size_t>(depth) * width * height;
-    auto data = std::make_unique<Pixel[]>(size);
+    return {width, height, depth};
+}
+
+Grid Grid::load_tiff_layers(const std::filesystem::path& path, size_t first_layer, size_t layers, size_t threads, Layout layout) {
+    uint32_t width, height;
+
+    {
+        auto tiff = TiffPtr(TIFFOpen(path.c_str(), "r"));
+        if (!tiff) {
+            throw Error("Failed to open");
+        }
+
+        TIFFGetField(tiff.get(), TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(tiff.get(), TIFFTAG_IMAGELENGTH, &height);
+    }
+
+    auto grid = Grid({width, height, layers}, layout, VoxelFormat::Rgba8);
+    grid.decode_tiff_layers(path, first_layer, threads);
+    return grid;
+}
+
+void Grid::decode_tiff_layers(const std::filesystem::path& path, size_t first_layer, size_t threads) {
+    // Each range is decoded with its own handle, so that only the first layer of a range requires
+    // TIFFSetDirectory (which rescans the directory chain from the start), and the remaining layers
+    // are reached with TIFFReadDirectory. Using some more ranges than threads balances layers
+    // that are more expensive to decode.
+    const size_t ranges = std::min(this->dim.z, std::max(threads, size_t{1}) * RANGES_PER_THREAD);
+    const size_t layer_stride = this->dim.x * this->dim.y;
+
+    parallel_for(threads, ranges, [&](size_t range) {
+        const size_t begin = range * this->dim.z / ranges;
+        const size_t end = (range + 1) * this->dim.z / ranges;
+
+        auto tiff = TiffPtr(TIFFOpen(path.c_str(), "r"));
+        if (!tiff) {
+            throw Error("Failed to open");
+        }
+
+        // Layers of a linear grid are decoded in place, other layouts require a layer to be reordered.
+        auto scratch = std::unique_ptr<Pixel[]>();
+        if (this->voxel_layout != Layout::Linear) {
+            scratch = std::unique_ptr<Pixel[]>(new Pixel[layer_stride]);
+        }
+
+        auto raster = std::vector<uint32_t>();
+
+        for (size_t i = begin; i < end; ++i) {
+            const size_t layer = first_layer + i;
+            const bool found = i == begin ?
+                TIFFSetDirectory(tiff.get(), static_cast<uint16_t>(layer)) :
+                TIFFReadDirectory(tiff.get());
+
+            if (!found) {
+                throw Error("Failed to read layer {}", layer);
+            }
+
+            const auto width = static_cast<uint32_t>(this->dim.x);
+            const auto height = static_cast<uint32_t>(this->dim.y);
+
+            if (this->voxel_format != VoxelFormat::Rgba8) {
+                uint8_t* dst = &this->data[layer_stride * i * voxel_size(this->voxel_format)];
+                decode_scalar_layer(tiff.get(), width, height, this->voxel_format, dst, raster);
+                continue;
+            }
+
+            Pixel* dst = scratch ? scratch.get() : &this->owned_pixel_data()[layer_stride * i];
+
+            // TIFFReadRGBAImage writes uint32_t's to the raster, which are in the form ABGR. This means
+            // that in-memory, their layout is RGBA if the host machine is little-endian, so instead of
+            // an expensive copy routine just do a reinterpret cast.
+            if (!TIFFReadRGBAImage(tiff.get(), width, height, reinterpret_cast<uint32_t*>(dst))) {
+                throw Error("Failed to decode layer {}", layer);
+            }
+
+            if (scratch) {
+                this->store_layer(i, scratch.get());
+            }
+        }
+    });
+}
+
+void Grid::store_layer(size_t z, const Pixel* layer) {
+    if (this->voxel_layout == Layout::Linear) {
+        std::copy(layer, layer + this->dim.x * this->dim.y, &this->owned_pixel_data()[z * this->dim.x * this->dim.y]);
+        return;
+    }
+
+    for (size_t y = 0; y < this->dim.y; ++y) {
+        const Pixel* row = &layer[y * this->dim.x];
+        const uint32_t* brick_row = &this->brick_slots[(y / BRICK_SIDE + z / BRICK_SIDE * this->bricks.y) * this->bricks.x];
+        const size_t yz_morton = brick_morton(0, y % BRICK_SIDE, z % BRICK_SIDE);
 
-    fmt::print("{}x{}x{} = {} pixels\n", width, height, depth, size);
+        for (size_t bx = 0; bx < this->bricks.x; ++bx) {
+            Pixel* brick = &this->owned_pixel_data()[size_t{brick_row[bx]} * BRICK_VOXELS + yz_morton];
+            const size_t x_base = bx * BRICK_SIDE;
+            const size_t n = std::min(BRICK_SIDE, this->dim.x - x_base);
 
-    size_t layer_stride = width * height;
-    for (uint16_t i = 0; i < depth; ++i) {
-        TIFFSetDirectory(tiff.get(), i);
+            for (size_t x = 0; x < n; ++x) {
+                brick[brick_morton(x, 0, 0)] = row[x_base + x];
+            }
+        }
+    }
+}
 
-        // TIFFReadRGBAImage writes uint32_t's to the raster, which are in the form ABGR. This means
-        // that in-memory, their layout is RGBA if the host machine is little-endian, so instead of
-        // an expensive copy routine just do a reinterpret cast.
-        TIFFReadRGBAImage(tiff.get(), width, height, reinterpret_cast<uint32_t*>(&data.get()[layer_stride * i]));
+bool Grid::is_volume(const std::filesystem::path& path) {
+    auto in = std::ifstream(path, std::ios::binary);
+    if (!in) {
+        return false;
     }
 
-    return Grid(
-        {width, height, depth},
-        std::move(data)
+    char id[VOL_FMT_ID.size()];
+    in.read(id, VOL_FMT_ID.size());
+    return in && VOL_FMT_ID == std::string_view(id, VOL_FMT_ID.size());
+}
+
+Grid Grid::load_volume(const std::filesystem::path& path) {
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    auto mapping = MappedFile(path);
+    constexpr const size_t header_size = VOL_FMT_ID.size() + 3 * sizeof(uint64_t) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+
+    if (mapping.size() < header_size) {
+        throw Error("File too small");
+    }
+
+    const auto id = std::string_view(reinterpret_cast<const char*>(mapping.data()), VOL_FMT_ID.size());
+    if (VOL_FMT_ID != id) {
+        throw Error("Invalid format id");
+    }
+
+    const uint8_t* header = mapping.data() + VOL_FMT_ID.size();
+    auto read = [&header](auto& value) {
+        std::memcpy(&value, header, sizeof(value));
+        header += sizeof(value);
+    };
+
+    uint64_t x, y, z, data_offset;
+    uint32_t format, reserved;
+    read(x);
+    read(y);
+    read(z);
+    read(format);
+    read(reserved);
+    read(data_offset);
+
+    if (format > static_cast<uint32_t>(VoxelFormat::R16F)) {
+        throw Error("Unsupported voxel format {}", format);
+    }
+
+    const auto voxel_format = static_cast<VoxelFormat>(format);
+    const size_t bytes_per_voxel = voxel_size(voxel_format);
+
+    const auto dim = Vec3Sz{static_cast<size_t>(x), static_cast<size_t>(y), static_cast<size_t>(z)};
+    if (data_offset < header_size || data_offset % bytes_per_voxel != 0 || data_offset > mapping.size()) {
+        throw Error("Invalid voxel data offset");
+    }
+
+    size_t voxels;
+    if (__builtin_mul_overflow(dim.x, dim.y, &voxels) || __builtin_mul_overflow(voxels, dim.z, &voxels) || voxels == 0) {
+        throw Error("Volume has invalid dimensions ({}x{}x{})", dim.x, dim.y, dim.z);
+    }
+
+    const size_t data_size = mapping.size() - static_cast<size_t>(data_offset);
+    if (data_size % bytes_per_voxel != 0 || data_size / bytes_per_voxel != voxels) {
+        throw Error("File size does not match volume dimensions");
+    }
+
+    fmt::print("{}x{}x{} = {} pixels ({})\n", dim.x, dim.y, dim.z, voxels, voxel_format_to_string(voxel_format));
+
+    const auto view = Span<uint8_t>(data_size, mapping.data() + data_offset);
+
+    const auto stop = std::chrono::high_resolution_clock::now();
+    fmt::print("Mapped volume in {:.3f}s\n", std::chrono::duration<double>(stop - start).count());
+
+    return Grid(dim, voxel_format, std::move(mapping), view);
+}
+
+void Grid::save_volume(const std::filesystem::path& path) const {
+    if (this->voxel_layout != Layout::Linear) {
+        throw Error("Only grids with the linear layout can be saved");
+    }
+
+    auto out = std::ofstream(path, std::ios::binary);
+    if (!out) {
+        throw Error("Failed to open");
+    }
+
+    out.write(VOL_FMT_ID.data(), VOL_FMT_ID.size());
+    write_uint_le(out, uint64_t{this->dim.x});
+    write_uint_le(out, uint64_t{this->dim.y});
+    write_uint_le(out, uint64_t{this->dim.z});
+    write_uint_le(out, static_cast<uint32_t>(this->voxel_format));
+    write_uint_le(out, uint32_t{0});
+    write_uint_le(out, uint64_t{VOL_DATA_ALIGNMENT});
+
+    // Pad the header up to the voxel data
+    const size_t header_size = static_cast<size_t>(out.tellp());
+    const auto padding = std::vector<char>(VOL_DATA_ALIGNMENT - header_size, 0);
+    out.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+
+    // Voxels are stored in the layout of the format on little-endian hosts, so no conversion is required.
+    out.write(
+        reinterpret_cast<const char*>(this->view.data()),
+        static_cast<std::streamsize>(this->view.size())
     );
+
+    if (!out) {
+        throw Error("Failed to write");
+    }
 }
 
-Grid::VolScanResult Grid::vol_scan(Vec3Sz bmin, Vec3Sz bmax) const {
-    struct {
-        size_t r, g, b, a;
-    } accum = {0, 0, 0, 0};
+Grid Grid::with_layout(Layout layout) const {
+    if (this->voxel_format != VoxelFormat::Rgba8) {
+        throw Error("Only grids of the rgba8 format can change layout");
+    }
+
+    auto grid = Grid(this->dim, layout, VoxelFormat::Rgba8);
+
+    if (this->voxel_layout == Layout::Linear) {
+        for (size_t z = 0; z < this->dim.z; ++z) {
+            grid.store_layer(z, &this->pixel_data()[z * this->dim.x * this->dim.y]);
+        }
+    } else {
+        for (size_t z = 0; z < this->dim.z; ++z) {
+            for (size_t y = 0; y < this->dim.y; ++y) {
+                for (size_t x = 0; x < this->dim.x; ++x) {
+                    grid.set({x, y, z}, this->at({x, y, z}));
+                }
+            }
+        }
+    }
+
+    return grid;
+}
+
+// Call f(run, n) for runs of voxels that together make up the region [bmin, bmax), which must lie
+// inside the grid. The order of the runs depends on the layout.
+template <typename F>
+void Grid::scan_runs(Vec3Sz bmin, Vec3Sz bmax, F f) const {
+    const Pixel* voxels = this->pixel_data();
+
+    if (this->voxel_layout == Layout::Linear) {
+        for (size_t z = bmin.z; z < bmax.z; ++z) {
+            size_t z_base = z * this->dim.x * this->dim.y;
+            for (size_t y = bmin.y; y < bmax.y; ++y) {
+                size_t y_base = y * this->dim.x + z_base;
+                f(&voxels[y_base + bmin.x], bmax.x - bmin.x);
+            }
+        }
+
+        return;
+    }
+
+    // Octree construction scans aligned power-of-two cubes, which are stored contiguously
+    const size_t side = bmax.x - bmin.x;
+    const bool aligned_cube = (side & (side - 1)) == 0 &&
+        bmax.y - bmin.y == side && bmax.z - bmin.z == side &&
+        bmin.x % side == 0 && bmin.y % side == 0 && bmin.z % side == 0;
 
+    if (aligned_cube) {
+        f(&voxels[this->index(bmin)], side * side * side);
+        return;
+    }
+
+    for (size_t bz = bmin.z / BRICK_SIDE; bz <= (bmax.z - 1) / BRICK_SIDE; ++bz) {
+        for (size_t by = bmin.y / BRICK_SIDE; by <= (bmax.y - 1) / BRICK_SIDE; ++by) {
+            for (size_t bx = bmin.x / BRICK_SIDE; bx <= (bmax.x - 1) / BRICK_SIDE; ++bx) {
+                const auto brick_min = Vec3Sz{bx, by, bz} * BRICK_SIDE;
+                const size_t slot = this->brick_slots[bx + (by + bz * this->bricks.y) * this->bricks.x];
+
+                scan_morton_cube(
+                    &voxels[slot * BRICK_VOXELS],
+                    brick_min,
+                    BRICK_SIDE,
+                    bmin,
+                    bmax,
+                    f
+                );
+            }
+        }
+    }
+}
+
+Grid::VolScanResult Grid::vol_scan(Vec3Sz bmin, Vec3Sz bmax) const {
     bmin.x = std::min(this->dim.x, bmin.x);
     bmin.y = std::min(this->dim.y, bmin.y);
     bmin.z = std::min(this->dim.z, bmin.z);
@@ -99,43 +629,35 @@ Grid::VolScanResult Grid::vol_scan(Vec3Sz bmin, Vec3Sz bmax) const {
         };
     }
 
-    __m128i xmin = _mm_cvtsi32_si128(static_cast<int>(0xFFFFFFFF));
-    __m128i xmax = _mm_cvtsi32_si128(0x00000000);
-
-    for (size_t z = bmin.z; z < bmax.z; ++z) {
-        size_t z_base = z * this->dim.x * this->dim.y;
-        for (size_t y = bmin.y; y < bmax.y; ++y) {
-            size_t y_base = y * this->dim.x + z_base;
-            for (size_t x = bmin.x; x < bmax.x; ++x) {
-                const auto pix = this->data[y_base + x];
+    const auto scan_row = scan_kernels::kernels().vol_scan_row;
+    auto accum = scan_kernels::VolAccumulator();
 
-                __m128i xpix = _mm_cvtsi32_si128(static_cast<int>(pix.pack()));
-                xmin = _mm_min_epu8(xmin, xpix);
-                xmax = _mm_max_epu8(xmax, xpix);
-
-                accum.r += static_cast<size_t>(pix.r);
-                accum.g += static_cast<size_t>(pix.g);
-                accum.b += static_cast<size_t>(pix.b);
-                accum.a += static_cast<size_t>(pix.a);
-            }
-        }
-    }
-
-    auto diff = Pixel::unpack(static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_subs_epu8(xmax, xmin))));
+    this->scan_runs(bmin, bmax, [&](const Pixel* run, size_t count) {
+        scan_row(run, count, accum);
+    });
 
     auto avg = Pixel{
-        static_cast<uint8_t>(accum.r / n),
-        static_cast<uint8_t>(accum.g / n),
-        static_cast<uint8_t>(accum.b / n),
-        static_cast<uint8_t>(accum.a / n)
+        static_cast<uint8_t>(accum.sum[0] / n),
+        static_cast<uint8_t>(accum.sum[1] / n),
+        static_cast<uint8_t>(accum.sum[2] / n),
+        static_cast<uint8_t>(accum.sum[3] / n)
     };
 
     return VolScanResult{
         .avg = avg,
-        .max_diff = static_cast<uint8_t>(std::max({diff.r, diff.g, diff.b, diff.a}))
+        .max_diff = std::max({
+            static_cast<uint8_t>(accum.max.r - accum.min.r),
+            static_cast<uint8_t>(accum.max.g - accum.min.g),
+            static_cast<uint8_t>(accum.max.b - accum.min.b),
+            static_cast<uint8_t>(accum.max.a - accum.min.a)
+        })
     };
 }
 
+void Grid::scan_voxels(Vec3Sz bmin, Vec3Sz bmax, const std::function<void(const Pixel*, size_t)>& f) const {
+    this->scan_runs(bmin, bmax, f);
+}
+
 Grid::StdDevResult Grid::stddev_scan(Vec3Sz bmin, Vec3Sz bmax) const {
     bmin.x = std::min(this->dim.x, bmin.x);
     bmin.y = std::min(this->dim.y, bmin.y);
@@ -153,62 +675,46 @@ Grid::StdDevResult Grid::stddev_scan(Vec3Sz bmin, Vec3Sz bmax) const {
         };
     }
 
-    struct {
-        size_t r, g, b, a;
-    } accum = {0, 0, 0, 0};
+    auto accum = scan_kernels::StdDevAccumulator();
 
-    for (size_t z = bmin.z; z < bmax.z; ++z) {
-        size_t z_base = z * this->dim.x * this->dim.y;
-        for (size_t y = bmin.y; y < bmax.y; ++y) {
-            size_t y_base = y * this->dim.x + z_base;
-            for (size_t x = bmin.x; x < bmax.x; ++x) {
-                const auto pix = this->data[y_base + x];
+    if (this->summed_table && n >= MIN_SUMMED_TABLE_QUERY) {
+        accum = this->summed_table->query(bmin, bmax);
+    } else {
+        const auto scan_row = scan_kernels::kernels().stddev_scan_row;
 
-                accum.r += static_cast<size_t>(pix.r);
-                accum.g += static_cast<size_t>(pix.g);
-                accum.b += static_cast<size_t>(pix.b);
-                accum.a += static_cast<size_t>(pix.a);
-            }
-        }
+        this->scan_runs(bmin, bmax, [&](const Pixel* run, size_t count) {
+            scan_row(run, count, accum);
+        });
     }
 
-    double nd = static_cast<double>(n);
-
-    struct {
-        double r, g, b, a;
-    } avg = {
-        static_cast<double>(accum.r) / nd,
-        static_cast<double>(accum.g) / nd,
-        static_cast<double>(accum.b) / nd,
-        static_cast<double>(accum.a) / nd
-    };
-
-    double stddev = 0;
-
-    auto diff = [](uint8_t x, double u) {
-        double y = static_cast<double>(x) - u;
-        return y * y;
-    };
-
-    for (size_t z = bmin.z; z < bmax.z; ++z) {
-        size_t z_base = z * this->dim.x * this->dim.y;
-        for (size_t y = bmin.y; y < bmax.y; ++y) {
-            size_t y_base = y * this->dim.x + z_base;
-            for (size_t x = bmin.x; x < bmax.x; ++x) {
-                const auto pix = this->data[y_base + x];
-
-                stddev += diff(pix.r, avg.r) + diff(pix.g, avg.g) + diff(pix.b, avg.b) + diff(pix.a, avg.a);
-            }
-        }
+    // The sum of squared deviations from the mean is (n * sum_sq - sum^2) / n per channel. This is
+    // computed exactly in integers, in the same way as VoxelAggregate::squared_deviation, so that both
+    // construction methods make the same decisions.
+    unsigned __int128 deviation = 0;
+    for (size_t c = 0; c < 4; ++c) {
+        deviation += static_cast<unsigned __int128>(n) * accum.sum_sq[c]
+            - static_cast<unsigned __int128>(accum.sum[c]) * accum.sum[c];
     }
 
+    double nd = static_cast<double>(n);
+
     return {
         .avg = {
-            static_cast<uint8_t>(avg.r),
-            static_cast<uint8_t>(avg.g),
-            static_cast<uint8_t>(avg.b),
-            static_cast<uint8_t>(avg.a)
+            static_cast<uint8_t>(accum.sum[0] / n),
+            static_cast<uint8_t>(accum.sum[1] / n),
+            static_cast<uint8_t>(accum.sum[2] / n),
+            static_cast<uint8_t>(accum.sum[3] / n)
         },
-        .stddev = std::sqrt(stddev / nd)
+        .stddev = std::sqrt(static_cast<double>(deviation) / nd / nd)
     };
-}
\ No newline at end of file
+}
+
+void Grid::build_summed_volume_table(size_t threads) {
+    if (this->voxel_layout == Layout::Linear) {
+        this->summed_table = std::make_unique<SummedVolumeTable>(this->pixel_data(), this->dim, threads);
+    } else {
+        // The table is built from rows of voxels. A linear copy is small compared to the table itself.
+        const auto linear = this->with_layout(Layout::Linear);
+        this->summed_table = std::make_unique<SummedVolumeTable>(linear.pixel_data(), this->dim, threads);
+    }
+}
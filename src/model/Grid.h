@@ -4,11 +4,21 @@
 #include <utility>
 #include <memory>
 #include <filesystem>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <functional>
 #include <cstddef>
+#include <cstdint>
+#include <cassert>
 #include <vulkan/vulkan.hpp>
 #include "math/Vec.h"
 #include "utility/Span.h"
+#include "utility/parallel.h"
+#include "utility/MappedFile.h"
 #include "model/Pixel.h"
+#include "model/VoxelFormat.h"
+#include "model/SummedVolumeTable.h"
 
 class Grid {
 public:
@@ -22,45 +32,210 @@ public:
         double stddev;
     };
 
+    enum class Layout {
+        // Voxels are stored x-fastest, then y, then z.
+        Linear,
+
+        // Voxels are stored in bricks of BRICK_SIDE^3 voxels. The voxels of a brick, and the bricks
+        // themselves, are stored in Morton order (x most significant, like the children of an octree
+        // node), so that every aligned power-of-two cube that lies in the grid is stored contiguously.
+        // Bricks at the edges of the grid are padded with zeroed voxels.
+        Bricked
+    };
+
+    constexpr const static size_t BRICK_SIDE = 8;
+    constexpr const static size_t BRICK_VOXELS = BRICK_SIDE * BRICK_SIDE * BRICK_SIDE;
+
 private:
     Vec3Sz dim;
-    std::unique_ptr<Pixel[]> data;
+    VoxelFormat voxel_format;
+    Layout voxel_layout;
+
+    // The voxels of the grid are either owned by the grid, or stored in a memory mapped volume file.
+    // `view` always refers to the bytes of the voxels in use, in the order given by the layout.
+    std::unique_ptr<uint8_t[]> data;
+    MappedFile mapping;
+    Span<uint8_t> view;
+
+    // For the bricked layout, the number of bricks along each axis, and the index of each brick in
+    // the voxel data, indexed x-fastest by brick coordinate.
+    Vec3Sz bricks;
+    std::vector<uint32_t> brick_slots;
+
+    std::unique_ptr<SummedVolumeTable> summed_table;
+
+    // Allocate a grid of which the voxels are not initialized, except for the padding of bricks.
+    // Only Rgba8 grids can have the bricked layout.
+    Grid(Vec3Sz dim, Layout layout, VoxelFormat format);
+
+    Grid(Vec3Sz dim, VoxelFormat format, MappedFile&& mapping, Span<uint8_t> view):
+        dim(dim), voxel_format(format), voxel_layout(Layout::Linear), mapping(std::move(mapping)), view(view), bricks(0) {
+    }
+
+    // Decode the layers [first_layer, first_layer + dim.z) of a stacked TIFF image into this grid.
+    void decode_tiff_layers(const std::filesystem::path& path, size_t first_layer, size_t threads);
+
+    // Store a layer of dim.x * dim.y voxels, in linear order, at depth z.
+    void store_layer(size_t z, const Pixel* layer);
+
+    const Pixel* pixel_data() const {
+        return reinterpret_cast<const Pixel*>(this->view.data());
+    }
+
+    // Memory mapped grids are read-only, so they have no owned voxels.
+    Pixel* owned_pixel_data() {
+        assert(this->data);
+        return reinterpret_cast<Pixel*>(this->data.get());
+    }
+
+    template <typename F>
+    void scan_runs(Vec3Sz bmin, Vec3Sz bmax, F f) const;
+
+    // Spread the 3 low bits of v so that they can be interleaved into a Morton index within a brick.
+    constexpr static size_t spread_brick_bits(size_t v) {
+        static_assert(BRICK_SIDE == 8, "spread_brick_bits assumes bricks of 8^3 voxels");
+        return (v & 1) | ((v & 2) << 2) | ((v & 4) << 4);
+    }
 
-    Grid(Vec3Sz dim, std::unique_ptr<Pixel[]>&& data):
-        dim(dim), data(std::move(data)) {
+    constexpr static size_t brick_morton(size_t x, size_t y, size_t z) {
+        return (spread_brick_bits(x) << 2) | (spread_brick_bits(y) << 1) | spread_brick_bits(z);
+    }
+
+    size_t index(Vec3Sz index) const {
+        if (this->voxel_layout == Layout::Linear) {
+            return index.x + index.y * this->dim.x + index.z * this->dim.x * this->dim.y;
+        }
+
+        const size_t brick = index.x / BRICK_SIDE +
+            (index.y / BRICK_SIDE + index.z / BRICK_SIDE * this->bricks.y) * this->bricks.x;
+
+        return size_t{this->brick_slots[brick]} * BRICK_VOXELS +
+            brick_morton(index.x % BRICK_SIDE, index.y % BRICK_SIDE, index.z % BRICK_SIDE);
     }
 
 public:
     Grid(Vec3Sz dim);
 
-    static Grid load_tiff(const std::filesystem::path& path);
+    // Load a stacked TIFF image, decoding disjoint ranges of layers on up to `threads` threads. For scalar
+    // formats, grayscale images of 8 or 16-bit integer or 32-bit float samples are converted directly, and
+    // the red channel is used of any other image.
+    static Grid load_tiff(
+        const std::filesystem::path& path,
+        size_t threads = hardware_threads(),
+        Layout layout = Layout::Linear,
+        VoxelFormat format = VoxelFormat::Rgba8
+    );
+
+    // Read only the dimensions of a stacked TIFF image, without loading any of its layers.
+    static Vec3Sz tiff_dimensions(const std::filesystem::path& path);
+
+    // The number of bytes taken by the voxels of a grid with dimensions `dim` in the given layout. For the
+    // bricked layout, this includes the padding of the bricks and the table of brick slots.
+    static size_t memory_required(Vec3Sz dim, Layout layout, VoxelFormat format = VoxelFormat::Rgba8);
+
+    // Load the layers [first_layer, first_layer + layers) of a stacked TIFF image into a grid of
+    // which the z-dimension is `layers`.
+    static Grid load_tiff_layers(
+        const std::filesystem::path& path,
+        size_t first_layer,
+        size_t layers,
+        size_t threads = 1,
+        Layout layout = Layout::Linear
+    );
+
+    // Check whether the file at `path` is a raw volume, as written by save_volume.
+    static bool is_volume(const std::filesystem::path& path);
+
+    // Map the voxels of a raw volume file directly into memory: the voxel data is stored uncompressed
+    // and page aligned, so nothing needs to be decoded, and voxels are only read from disk when
+    // they are first accessed. The layout of the resulting grid is linear, and its format is that of the file.
+    static Grid load_volume(const std::filesystem::path& path);
+
+    // Only grids with the linear layout can be saved.
+    void save_volume(const std::filesystem::path& path) const;
+
+    // Copy the voxels of this grid, which must be of the Rgba8 format, into a new grid with the given layout.
+    Grid with_layout(Layout layout) const;
+
+    // The scans, build_summed_volume_table, at, set and pixels access the voxels as Pixels, and
+    // require the Rgba8 format.
 
     VolScanResult vol_scan(Vec3Sz bmin, Vec3Sz bmax) const;
 
+    // When a summed-volume table is built, this function uses it instead of scanning large regions.
     StdDevResult stddev_scan(Vec3Sz bmin, Vec3Sz bmax) const;
 
+    // Precompute a summed-volume table of the grid, which takes SummedVolumeTable::memory_required(dimensions())
+    // bytes, to accelerate stddev_scan. The grid must not be modified afterwards.
+    void build_summed_volume_table(size_t threads);
+
     Vec3Sz dimensions() const {
         return this->dim;
     }
 
+    Layout layout() const {
+        return this->voxel_layout;
+    }
+
+    VoxelFormat format() const {
+        return this->voxel_format;
+    }
+
     size_t size() const {
         return this->dim.x * this->dim.y * this->dim.z;
     }
 
     Pixel at(Vec3Sz index) const {
-        return this->data[index.x + index.y * this->dim.x + index.z * this->dim.x * this->dim.y];
+        return this->pixel_data()[this->index(index)];
     }
 
+    // The 2x2x2 voxels starting at `offset`, which must be even and lie inside the grid, in the order of the
+    // children of an octree node. In the bricked layout these are stored contiguously in that order.
+    std::array<Pixel, 8> cube_voxels(Vec3Sz offset) const {
+        auto voxels = std::array<Pixel, 8>();
+        const Pixel* base = &this->pixel_data()[this->index(offset)];
+
+        if (this->voxel_layout == Layout::Bricked) {
+            std::copy(base, base + 8, voxels.begin());
+            return voxels;
+        }
+
+        const size_t y_stride = this->dim.x;
+        const size_t z_stride = this->dim.x * this->dim.y;
+        for (size_t child = 0; child < 8; ++child) {
+            voxels[child] = base[(child >> 2) + ((child >> 1) & 1) * y_stride + (child & 1) * z_stride];
+        }
+
+        return voxels;
+    }
+
+    // Call f(run, n) for runs of contiguous voxels that together cover the region [bmin, bmax), which must lie
+    // inside the grid, in an unspecified order. Aligned power-of-two cubes of the bricked layout are a single run.
+    void scan_voxels(Vec3Sz bmin, Vec3Sz bmax, const std::function<void(const Pixel*, size_t)>& f) const;
+
+    // Only grids which own their voxels, that is, grids which are not loaded with load_volume,
+    // can be modified.
     void set(Vec3Sz index, Pixel value) {
-        this->data[index.x + index.y * this->dim.x + index.z * this->dim.x * this->dim.y] = value;
+        this->owned_pixel_data()[this->index(index)] = value;
     }
 
+    // The voxels of the grid in the order given by its layout, including the padding of bricks.
     Span<Pixel> pixels() const {
-        return Span(this->size(), this->data.get());
+        return Span(this->view.size() / sizeof(Pixel), this->pixel_data());
+    }
+
+    // The bytes of the voxels of the grid in any format, in the order given by its layout.
+    Span<uint8_t> voxel_data() const {
+        return this->view;
     }
 
     size_t memory_footprint() const {
-        return sizeof(Grid) + this->size() * sizeof(Pixel);
+        size_t footprint = sizeof(Grid) + this->view.size() + this->brick_slots.size() * sizeof(uint32_t);
+        if (this->summed_table) {
+            footprint += this->summed_table->memory_footprint();
+        }
+
+        return footprint;
     }
 };
 
@@ -0,0 +1,339 @@
+#include "model/GridScan.h"
+#include <algorithm>
+#include <vector>
+#include <x86intrin.h>
+
+namespace {
+    // The vector kernels accumulate into 32-bit lanes, which are flushed to the 64-bit totals
+    // after at most this many pixels, so that no lane can overflow. Each lane receives the squares
+    // of at most 1/4th of these pixels: 65536 / 4 * 255^2 < 2^32.
+    constexpr const size_t MAX_CHUNK = 65536;
+
+    // The scalar kernels accumulate into locals, as the compiler would otherwise have to assume that the
+    // accumulator aliases the (byte-sized) pixel channels.
+    void vol_scan_row_scalar(const Pixel* row, size_t n, scan_kernels::VolAccumulator& accum) {
+        uint64_t r = 0, g = 0, b = 0, a = 0;
+        Pixel min = accum.min;
+        Pixel max = accum.max;
+
+        for (size_t i = 0; i < n; ++i) {
+            const Pixel pix = row[i];
+
+            r += pix.r;
+            g += pix.g;
+            b += pix.b;
+            a += pix.a;
+
+            min.r = std::min(min.r, pix.r);
+            min.g = std::min(min.g, pix.g);
+            min.b = std::min(min.b, pix.b);
+            min.a = std::min(min.a, pix.a);
+
+            max.r = std::max(max.r, pix.r);
+            max.g = std::max(max.g, pix.g);
+            max.b = std::max(max.b, pix.b);
+            max.a = std::max(max.a, pix.a);
+        }
+
+        accum.sum[0] += r;
+        accum.sum[1] += g;
+        accum.sum[2] += b;
+        accum.sum[3] += a;
+        accum.min = min;
+        accum.max = max;
+    }
+
+    void stddev_scan_row_scalar(const Pixel* row, size_t n, scan_kernels::StdDevAccumulator& accum) {
+        uint64_t r = 0, g = 0, b = 0, a = 0;
+        uint64_t r_sq = 0, g_sq = 0, b_sq = 0, a_sq = 0;
+
+        for (size_t i = 0; i < n; ++i) {
+            const Pixel pix = row[i];
+
+            r += pix.r;
+            g += pix.g;
+            b += pix.b;
+            a += pix.a;
+
+            r_sq += uint32_t{pix.r} * pix.r;
+            g_sq += uint32_t{pix.g} * pix.g;
+            b_sq += uint32_t{pix.b} * pix.b;
+            a_sq += uint32_t{pix.a} * pix.a;
+        }
+
+        accum.sum[0] += r;
+        accum.sum[1] += g;
+        accum.sum[2] += b;
+        accum.sum[3] += a;
+        accum.sum_sq[0] += r_sq;
+        accum.sum_sq[1] += g_sq;
+        accum.sum_sq[2] += b_sq;
+        accum.sum_sq[3] += a_sq;
+    }
+
+    // The vector kernels first shuffle the pixels in every 128-bit lane such that each group
+    // of 4 bytes holds a single channel (rrrr gggg bbbb aaaa), after which per-channel sums of
+    // 4 pixels are computed with maddubs (u8 pairs to i16) and madd (i16 pairs to i32), and squares
+    // with madd on the zero-extended bytes. Lane i of the 32-bit sum accumulator then belongs to
+    // channel i % 4. The squares of the low half (rrgg) and high half (bbaa) are accumulated
+    // separately, and lane i of those belongs to channel (i % 4) / 2 of the half.
+
+    template <size_t N>
+    void flush_sums(std::array<uint64_t, 4>& total, const std::array<uint32_t, N>& sum) {
+        for (size_t i = 0; i < N; ++i) {
+            total[i % 4] += sum[i];
+        }
+    }
+
+    template <size_t N>
+    void flush_squares(std::array<uint64_t, 4>& total, const std::array<uint32_t, N>& sq_lo, const std::array<uint32_t, N>& sq_hi) {
+        for (size_t i = 0; i < N; ++i) {
+            total[(i % 4) / 2] += sq_lo[i];
+            total[(i % 4) / 2 + 2] += sq_hi[i];
+        }
+    }
+
+    // Fold packed minimum and maximum pixels into the accumulator. This is deliberately not written with
+    // (legacy encoded) SSE intrinsics, as switching between those and AVX is expensive.
+    void fold_min_max(scan_kernels::VolAccumulator& accum, uint32_t packed_min, uint32_t packed_max) {
+        const auto min = Pixel::unpack(packed_min);
+        const auto max = Pixel::unpack(packed_max);
+
+        accum.min = Pixel{
+            std::min(accum.min.r, min.r),
+            std::min(accum.min.g, min.g),
+            std::min(accum.min.b, min.b),
+            std::min(accum.min.a, min.a)
+        };
+
+        accum.max = Pixel{
+            std::max(accum.max.r, max.r),
+            std::max(accum.max.g, max.g),
+            std::max(accum.max.b, max.b),
+            std::max(accum.max.a, max.a)
+        };
+    }
+
+    __attribute__((target("avx2")))
+    uint32_t reduce_min_avx2(__m256i v) {
+        __m128i x = _mm_min_epu8(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        x = _mm_min_epu8(x, _mm_srli_si128(x, 8));
+        x = _mm_min_epu8(x, _mm_srli_si128(x, 4));
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(x));
+    }
+
+    __attribute__((target("avx2")))
+    uint32_t reduce_max_avx2(__m256i v) {
+        __m128i x = _mm_max_epu8(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        x = _mm_max_epu8(x, _mm_srli_si128(x, 8));
+        x = _mm_max_epu8(x, _mm_srli_si128(x, 4));
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(x));
+    }
+
+    // The 512-bit reductions only use the maskz variants of lane shuffles, as the unmasked
+    // ones (and the 512-to-128-bit casts) trip -Wuninitialized in some versions of gcc's headers.
+    __attribute__((target("avx512f,avx512bw")))
+    uint32_t reduce_min_avx512(__m512i v) {
+        v = _mm512_min_epu8(v, _mm512_maskz_shuffle_i64x2(0xFF, v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm512_min_epu8(v, _mm512_maskz_shuffle_i64x2(0xFF, v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        v = _mm512_min_epu8(v, _mm512_bsrli_epi128(v, 8));
+        v = _mm512_min_epu8(v, _mm512_bsrli_epi128(v, 4));
+        return static_cast<uint32_t>(_mm512_cvtsi512_si32(v));
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    uint32_t reduce_max_avx512(__m512i v) {
+        v = _mm512_max_epu8(v, _mm512_maskz_shuffle_i64x2(0xFF, v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm512_max_epu8(v, _mm512_maskz_shuffle_i64x2(0xFF, v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        v = _mm512_max_epu8(v, _mm512_bsrli_epi128(v, 8));
+        v = _mm512_max_epu8(v, _mm512_bsrli_epi128(v, 4));
+        return static_cast<uint32_t>(_mm512_cvtsi512_si32(v));
+    }
+
+    __attribute__((target("avx2")))
+    __m256i group_channels_avx2(__m256i v) {
+        const __m256i shuffle = _mm256_setr_epi8(
+            0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+            0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15
+        );
+
+        return _mm256_shuffle_epi8(v, shuffle);
+    }
+
+    __attribute__((target("avx2")))
+    void vol_scan_row_avx2(const Pixel* row, size_t n, scan_kernels::VolAccumulator& accum) {
+        const __m256i ones_8 = _mm256_set1_epi8(1);
+        const __m256i ones_16 = _mm256_set1_epi16(1);
+
+        __m256i min = _mm256_set1_epi8(static_cast<char>(0xFF));
+        __m256i max = _mm256_setzero_si256();
+
+        size_t i = 0;
+        while (i + 8 <= n) {
+            const size_t chunk_end = std::min(n, i + MAX_CHUNK);
+            __m256i sum = _mm256_setzero_si256();
+
+            for (; i + 8 <= chunk_end; i += 8) {
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&row[i]));
+                min = _mm256_min_epu8(min, v);
+                max = _mm256_max_epu8(max, v);
+
+                const __m256i pairs = _mm256_maddubs_epi16(group_channels_avx2(v), ones_8);
+                sum = _mm256_add_epi32(sum, _mm256_madd_epi16(pairs, ones_16));
+            }
+
+            auto sum_lanes = std::array<uint32_t, 8>();
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum_lanes.data()), sum);
+            flush_sums(accum.sum, sum_lanes);
+        }
+
+        fold_min_max(accum, reduce_min_avx2(min), reduce_max_avx2(max));
+
+        vol_scan_row_scalar(&row[i], n - i, accum);
+    }
+
+    __attribute__((target("avx2")))
+    void stddev_scan_row_avx2(const Pixel* row, size_t n, scan_kernels::StdDevAccumulator& accum) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i ones_8 = _mm256_set1_epi8(1);
+        const __m256i ones_16 = _mm256_set1_epi16(1);
+
+        size_t i = 0;
+        while (i + 8 <= n) {
+            const size_t chunk_end = std::min(n, i + MAX_CHUNK);
+            __m256i sum = zero;
+            __m256i sq_lo = zero;
+            __m256i sq_hi = zero;
+
+            for (; i + 8 <= chunk_end; i += 8) {
+                const __m256i v = group_channels_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&row[i])));
+                const __m256i lo = _mm256_unpacklo_epi8(v, zero);
+                const __m256i hi = _mm256_unpackhi_epi8(v, zero);
+
+                sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(v, ones_8), ones_16));
+                sq_lo = _mm256_add_epi32(sq_lo, _mm256_madd_epi16(lo, lo));
+                sq_hi = _mm256_add_epi32(sq_hi, _mm256_madd_epi16(hi, hi));
+            }
+
+            auto sum_lanes = std::array<uint32_t, 8>();
+            auto sq_lo_lanes = std::array<uint32_t, 8>();
+            auto sq_hi_lanes = std::array<uint32_t, 8>();
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum_lanes.data()), sum);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(sq_lo_lanes.data()), sq_lo);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(sq_hi_lanes.data()), sq_hi);
+
+            flush_sums(accum.sum, sum_lanes);
+            flush_squares(accum.sum_sq, sq_lo_lanes, sq_hi_lanes);
+        }
+
+        stddev_scan_row_scalar(&row[i], n - i, accum);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    __m512i group_channels_avx512(__m512i v) {
+        const __m512i shuffle = _mm512_set4_epi32(0x0F0B0703, 0x0E0A0602, 0x0D090501, 0x0C080400);
+        return _mm512_shuffle_epi8(v, shuffle);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    void vol_scan_row_avx512(const Pixel* row, size_t n, scan_kernels::VolAccumulator& accum) {
+        const __m512i ones_8 = _mm512_set1_epi8(1);
+        const __m512i ones_16 = _mm512_set1_epi16(1);
+
+        __m512i min = _mm512_set1_epi8(static_cast<char>(0xFF));
+        __m512i max = _mm512_setzero_si512();
+
+        size_t i = 0;
+        while (i + 16 <= n) {
+            const size_t chunk_end = std::min(n, i + MAX_CHUNK);
+            __m512i sum = _mm512_setzero_si512();
+
+            for (; i + 16 <= chunk_end; i += 16) {
+                const __m512i v = _mm512_loadu_si512(&row[i]);
+                min = _mm512_min_epu8(min, v);
+                max = _mm512_max_epu8(max, v);
+
+                const __m512i pairs = _mm512_maddubs_epi16(group_channels_avx512(v), ones_8);
+                sum = _mm512_add_epi32(sum, _mm512_madd_epi16(pairs, ones_16));
+            }
+
+            auto sum_lanes = std::array<uint32_t, 16>();
+            _mm512_storeu_si512(sum_lanes.data(), sum);
+            flush_sums(accum.sum, sum_lanes);
+        }
+
+        fold_min_max(accum, reduce_min_avx512(min), reduce_max_avx512(max));
+
+        vol_scan_row_scalar(&row[i], n - i, accum);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    void stddev_scan_row_avx512(const Pixel* row, size_t n, scan_kernels::StdDevAccumulator& accum) {
+        const __m512i zero = _mm512_setzero_si512();
+        const __m512i ones_8 = _mm512_set1_epi8(1);
+        const __m512i ones_16 = _mm512_set1_epi16(1);
+
+        size_t i = 0;
+        while (i + 16 <= n) {
+            const size_t chunk_end = std::min(n, i + MAX_CHUNK);
+            __m512i sum = zero;
+            __m512i sq_lo = zero;
+            __m512i sq_hi = zero;
+
+            for (; i + 16 <= chunk_end; i += 16) {
+                const __m512i v = group_channels_avx512(_mm512_loadu_si512(&row[i]));
+                const __m512i lo = _mm512_unpacklo_epi8(v, zero);
+                const __m512i hi = _mm512_unpackhi_epi8(v, zero);
+
+                sum = _mm512_add_epi32(sum, _mm512_madd_epi16(_mm512_maddubs_epi16(v, ones_8), ones_16));
+                sq_lo = _mm512_add_epi32(sq_lo, _mm512_madd_epi16(lo, lo));
+                sq_hi = _mm512_add_epi32(sq_hi, _mm512_madd_epi16(hi, hi));
+            }
+
+            auto sum_lanes = std::array<uint32_t, 16>();
+            auto sq_lo_lanes = std::array<uint32_t, 16>();
+            auto sq_hi_lanes = std::array<uint32_t, 16>();
+            _mm512_storeu_si512(sum_lanes.data(), sum);
+            _mm512_storeu_si512(sq_lo_lanes.data(), sq_lo);
+            _mm512_storeu_si512(sq_hi_lanes.data(), sq_hi);
+
+            flush_sums(accum.sum, sum_lanes);
+            flush_squares(accum.sum_sq, sq_lo_lanes, sq_hi_lanes);
+        }
+
+        stddev_scan_row_scalar(&row[i], n - i, accum);
+    }
+
+    std::vector<scan_kernels::Kernels> detect_kernels() {
+        auto kernels = std::vector<scan_kernels::Kernels>{
+            {"scalar", vol_scan_row_scalar, stddev_scan_row_scalar}
+        };
+
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2")) {
+            kernels.push_back({"avx2", vol_scan_row_avx2, stddev_scan_row_avx2});
+        }
+
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+            kernels.push_back({"avx512", vol_scan_row_avx512, stddev_scan_row_avx512});
+        }
+
+        return kernels;
+    }
+
+    const std::vector<scan_kernels::Kernels>& all_kernels() {
+        static const auto kernels = detect_kernels();
+        return kernels;
+    }
+}
+
+namespace scan_kernels {
+    Span<Kernels> supported_kernels() {
+        return all_kernels();
+    }
+
+    const Kernels& kernels() {
+        return all_kernels().back();
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef _XENODON_MODEL_GRIDSCAN_H
+#define _XENODON_MODEL_GRIDSCAN_H
+
+#include <array>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include "model/Pixel.h"
+#include "utility/Span.h"
+
+// Row kernels of Grid::vol_scan and Grid::stddev_scan. Each kernel processes a contiguous row of pixels
+// and adds it to an accumulator, and is implemented for every supported instruction set. The best one
+// supported by the host is selected at runtime.
+namespace scan_kernels {
+    struct VolAccumulator {
+        std::array<uint64_t, 4> sum = {0, 0, 0, 0};
+        Pixel min = {0xFF, 0xFF, 0xFF, 0xFF};
+        Pixel max = {0, 0, 0, 0};
+    };
+
+    struct StdDevAccumulator {
+        std::array<uint64_t, 4> sum = {0, 0, 0, 0};
+        std::array<uint64_t, 4> sum_sq = {0, 0, 0, 0};
+    };
+
+    struct Kernels {
+        std::string_view name;
+        void (*vol_scan_row)(const Pixel* row, size_t n, VolAccumulator& accum);
+        void (*stddev_scan_row)(const Pixel* row, size_t n, StdDevAccumulator& accum);
+    };
+
+    // All kernels supported by the host, from the most portable to the fastest.
+    Span<Kernels> supported_kernels();
+
+    // The fastest kernels supported by the host.
+    const Kernels& kernels();
+}
+
+#endif
@@ -0,0 +1,139 @@
+#include "model/OccupancyGrid.h"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <cmath>
+#include "core/Error.h"
+
+namespace {
+    constexpr const size_t LAST_ENTRY = TransferFunction::RESOLUTION - 1;
+
+    // Margin in entries added around the sampled range, so that it also covers the rounding
+    // performed by the GPU when computing texture coordinates and filtering.
+    constexpr const float ENTRY_MARGIN = 0.01f;
+}
+
+OccupancyGrid::OccupancyGrid(const Grid& grid, size_t threads):
+    num_blocks((grid.dimensions() + (BLOCK_SIDE - 1)) / BLOCK_SIDE),
+    voxel_format(grid.format()) {
+
+    if (grid.layout() != Grid::Layout::Linear) {
+        throw Error("Occupancy grid requires a grid of the linear layout");
+    }
+
+    const auto dim = grid.dimensions();
+    const uint8_t* data = grid.voxel_data().data();
+    const size_t total_blocks = this->num_blocks.x * this->num_blocks.y * this->num_blocks.z;
+
+    if (this->voxel_format == VoxelFormat::Rgba8) {
+        this->flags.resize(total_blocks);
+    } else {
+        this->ranges.resize(total_blocks);
+    }
+
+    // Every task processes a row of blocks
+    parallel_for(threads, this->num_blocks.y * this->num_blocks.z, [&](size_t row) {
+        const size_t by = row % this->num_blocks.y;
+        const size_t bz = row / this->num_blocks.y;
+
+        for (size_t bx = 0; bx < this->num_blocks.x; ++bx) {
+            const auto bmin = Vec3Sz(bx, by, bz) * BLOCK_SIDE;
+            const auto bmax = Vec3Sz(
+                std::min(bmin.x + BLOCK_SIDE, dim.x),
+                std::min(bmin.y + BLOCK_SIDE, dim.y),
+                std::min(bmin.z + BLOCK_SIDE, dim.z)
+            );
+
+            const size_t block = bx + this->num_blocks.x * row;
+
+            if (this->voxel_format == VoxelFormat::Rgba8) {
+                uint8_t block_flags = 0;
+
+                for (size_t z = bmin.z; z < bmax.z; ++z) {
+                    for (size_t y = bmin.y; y < bmax.y; ++y) {
+                        for (size_t x = bmin.x; x < bmax.x; ++x) {
+                            const Pixel p = grid.at({x, y, z});
+                            block_flags |= p.r || p.g || p.b ? EMISSIVE : 0;
+                            block_flags |= p.a ? ABSORBENT : 0;
+                        }
+                    }
+                }
+
+                this->flags[block] = block_flags;
+                continue;
+            }
+
+            auto& range = this->ranges[block];
+
+            float lo = std::numeric_limits<float>::infinity();
+            float hi = -std::numeric_limits<float>::infinity();
+            bool nan = false;
+
+            for (size_t z = bmin.z; z < bmax.z; ++z) {
+                for (size_t y = bmin.y; y < bmax.y; ++y) {
+                    const size_t base = (z * dim.y + y) * dim.x;
+                    for (size_t x = bmin.x; x < bmax.x; ++x) {
+                        const float v = scalar_at(this->voxel_format, data, base + x);
+                        nan |= std::isnan(v);
+                        lo = std::min(lo, v);
+                        hi = std::max(hi, v);
+                    }
+                }
+            }
+
+            if (nan) {
+                // Sampling the transfer function at NaN is undefined
+                range = EntryRange{0, static_cast<uint16_t>(LAST_ENTRY)};
+                continue;
+            }
+
+            // Values are sampled between entries floor(v * LAST_ENTRY) and the next one, and are clamped
+            // to the edges of the transfer function.
+            const auto last = static_cast<float>(LAST_ENTRY);
+            const float first_entry = std::floor(std::clamp(lo * last - ENTRY_MARGIN, 0.f, last));
+            const float last_entry = std::floor(std::clamp(hi * last + ENTRY_MARGIN, 0.f, last)) + 1;
+
+            range = EntryRange{
+                static_cast<uint16_t>(first_entry),
+                static_cast<uint16_t>(std::min(last_entry, last))
+            };
+        }
+    });
+}
+
+std::vector<uint8_t> OccupancyGrid::occupancy(const TransferFunction& transfer_function) const {
+    if (this->voxel_format == VoxelFormat::Rgba8) {
+        return this->flags;
+    }
+
+    // emissive[i] and absorbent[i] hold the number of entries before i with a nonzero color
+    // and alpha respectively
+    auto emissive = std::array<uint16_t, TransferFunction::RESOLUTION + 1>();
+    auto absorbent = std::array<uint16_t, TransferFunction::RESOLUTION + 1>();
+    const auto entries = transfer_function.data();
+
+    for (size_t i = 0; i < TransferFunction::RESOLUTION; ++i) {
+        const Pixel p = entries[i];
+        emissive[i + 1] = static_cast<uint16_t>(emissive[i] + (p.r || p.g || p.b ? 1 : 0));
+        absorbent[i + 1] = static_cast<uint16_t>(absorbent[i] + (p.a ? 1 : 0));
+    }
+
+    auto result = std::vector<uint8_t>(this->ranges.size());
+
+    for (size_t i = 0; i < this->ranges.size(); ++i) {
+        const auto range = this->ranges[i];
+        uint8_t block_flags = 0;
+
+        if (emissive[range.last + 1] != emissive[range.first]) {
+            block_flags |= EMISSIVE;
+        }
+
+        if (absorbent[range.last + 1] != absorbent[range.first]) {
+            block_flags |= ABSORBENT;
+        }
+
+        result[i] = block_flags;
+    }
+
+    return result;
+}
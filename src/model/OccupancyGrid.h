@@ -0,0 +1,50 @@
+#ifndef _XENODON_MODEL_OCCUPANCYGRID_H
+#define _XENODON_MODEL_OCCUPANCYGRID_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "math/Vec.h"
+#include "model/Grid.h"
+#include "model/VoxelFormat.h"
+#include "model/TransferFunction.h"
+#include "utility/parallel.h"
+
+// A coarse summary of a Grid in blocks of BLOCK_SIDE^3 voxels, from which it can be determined which
+// blocks contribute nothing to a rendered image, so that rays can leap over them.
+class OccupancyGrid {
+public:
+    constexpr const static size_t BLOCK_SIDE = 8;
+
+    // Flags of the occupancy of a block
+    constexpr const static uint8_t EMISSIVE = 1; // Some voxel of the block has a nonzero color
+    constexpr const static uint8_t ABSORBENT = 2; // Some voxel of the block has a nonzero alpha
+
+private:
+    // The range of transfer function entries which may be sampled by the voxels of a block.
+    struct EntryRange {
+        uint16_t first, last;
+    };
+
+    Vec3Sz num_blocks;
+    VoxelFormat voxel_format;
+
+    // For Rgba8 grids, the occupancy flags of each block, and for scalar grids, the range of
+    // transfer function entries of each block, from which the flags follow.
+    std::vector<uint8_t> flags;
+    std::vector<EntryRange> ranges;
+
+public:
+    // The grid is required to have the linear layout.
+    OccupancyGrid(const Grid& grid, size_t threads = hardware_threads());
+
+    Vec3Sz blocks() const {
+        return this->num_blocks;
+    }
+
+    // The occupancy flags of each block, given the transfer function used to color scalar
+    // voxels (which is ignored for Rgba8 grids). Blocks are indexed x-fastest.
+    std::vector<uint8_t> occupancy(const TransferFunction& transfer_function) const;
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <fstream>
 #include <string_view>
 #include <cmath>
+#include <cstring>
 #include <fmt/format.h>
 #include "core/Logger.h"
 #include "core/Error.h"
@@ -11,25 +12,34 @@
 #include "utility/serialization.h"
 
 namespace {
-    // Taken from boost:
-    // https://stackoverflow.com/questions/2590677/how-do-i-combine-hash-values-in-c0x
-    template <typename T>
-    size_t hash_combine(size_t seed, const T& v) {
-        return seed ^ (std::hash<T>{}(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2));
-    }
-
     constexpr const std::string_view SVO_FMT_ID = "XNDN-SVO";
-}
 
-size_t std::hash<Octree::Node>::operator()(const Octree::Node& node) const {
-    size_t v = std::hash<uint32_t>{}(node.is_leaf_depth);
-    v = hash_combine(v, std::hash<uint32_t>{}(node.color.pack()));
-
-    for (uint32_t child : node.children) {
-        v = hash_combine(v, std::hash<uint32_t>{}(child));
+    // Multiply two 64-bit values to 128 bits, and fold the product back to 64 bits
+    uint64_t mix(uint64_t a, uint64_t b) {
+        const auto product = static_cast<unsigned __int128>(a) * b;
+        return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
     }
+}
 
-    return v;
+size_t std::hash<Octree::Node>::operator()(const Octree::Node& node) const {
+    // A 64-bit hash in the style of wyhash: the node is read as 5 64-bit words, which are mixed
+    // into the state one or two at a time. Every bit of the node affects every bit of the result,
+    // which open addressing (see HashCache) relies on.
+    constexpr const uint64_t secret[] = {
+        0xa0761d6478bd642full,
+        0xe7037ed1a0b428dbull,
+        0x8ebc6af09c88c6e3ull,
+        0x589965cc75374cc3ull
+    };
+
+    static_assert(sizeof(Octree::Node) == 5 * sizeof(uint64_t));
+    uint64_t words[5];
+    std::memcpy(words, &node, sizeof(Octree::Node));
+
+    uint64_t v = mix(words[0] ^ secret[0], words[1] ^ secret[1]);
+    v = mix(v ^ words[2] ^ secret[2], words[3] ^ secret[3]);
+    v = mix(v ^ words[4] ^ secret[0], sizeof(Octree::Node) ^ secret[1]);
+    return static_cast<size_t>(v);
 }
 
 bool operator==(const Octree::Node& lhs, const Octree::Node& rhs) {
@@ -44,53 +54,48 @@ bool operator!=(const Octree::Node& lhs, const Octree::Node& rhs) {
 }
 
 Octree::Octree(size_t dim, std::vector<Node>&& nodes):
-    dim(dim), nodes(std::move(nodes)) {
+    dim(dim), nodes(std::move(nodes)), view(this->nodes) {
 }
 
-Octree Octree::load_svo(const std::filesystem::path& path) {
-    auto in = std::ifstream(path, std::ios::binary);
-    if (!in) {
-        throw Error("Failed to open");
-    }
+Octree::Octree(size_t dim, MappedFile&& mapping, Span<Node> view):
+    dim(dim), mapping(std::move(mapping)), view(view) {
+}
 
-    char id[SVO_FMT_ID.size()];
-    in.read(id, SVO_FMT_ID.size());
-    if (SVO_FMT_ID != std::string_view(id, SVO_FMT_ID.size())) {
-        fmt::print("Fmt id: '{}', got: '{}'\n", SVO_FMT_ID, std::string_view(id, SVO_FMT_ID.size()));
-        throw Error("Invalid format id");
-    }
+Octree Octree::load_svo(const std::filesystem::path& path) {
+    static_assert(sizeof(Node) == 10 * sizeof(uint32_t), "Node does not match the svo format");
 
-    uint64_t dim = read_uint_le<uint64_t>(in);
-    uint64_t num_nodes = read_uint_le<uint64_t>(in);
+    auto mapping = MappedFile(path);
+    constexpr const size_t header_size = SVO_FMT_ID.size() + 2 * sizeof(uint64_t);
 
-    auto pos = in.tellg();
-    if (pos == std::ifstream::pos_type(-1)) {
-        throw Error("Failed to tell");
+    if (mapping.size() < header_size) {
+        throw Error("File too small");
     }
 
-    in.seekg(0, std::ios_base::end);
-    auto end = in.tellg();
-    if (end == std::ifstream::pos_type(-1)) {
-        throw Error("Failed to tell");
+    const auto id = std::string_view(reinterpret_cast<const char*>(mapping.data()), SVO_FMT_ID.size());
+    if (SVO_FMT_ID != id) {
+        fmt::print("Fmt id: '{}', got: '{}'\n", SVO_FMT_ID, id);
+        throw Error("Invalid format id");
     }
 
-    in.seekg(pos);
-    size_t remaining = static_cast<size_t>(end - pos);
-    if (remaining != sizeof(Node) * num_nodes) {
+    uint64_t dim, num_nodes;
+    std::memcpy(&dim, mapping.data() + SVO_FMT_ID.size(), sizeof(uint64_t));
+    std::memcpy(&num_nodes, mapping.data() + SVO_FMT_ID.size() + sizeof(uint64_t), sizeof(uint64_t));
+
+    // Compared by division, as a corrupt node count could overflow the multiplication
+    const size_t data_size = mapping.size() - header_size;
+    if (data_size % sizeof(Node) != 0 || num_nodes != data_size / sizeof(Node)) {
         throw Error("File size does not match number of nodes");
     }
 
-    auto nodes = std::vector<Node>(num_nodes);
-    for (auto& node : nodes) {
-        for (uint32_t& child : node.children) {
-            child = read_uint_le<uint32_t>(in);
-        }
-
-        node.color = Pixel::unpack(read_uint_le<uint32_t>(in));
-        node.is_leaf_depth = read_uint_le<uint32_t>(in);
-    }
+    // The header size is a multiple of the alignment of Node, and mappings are page aligned,
+    // so the nodes can be used in place.
+    static_assert(header_size % alignof(Node) == 0);
+    const auto view = Span<Node>(
+        static_cast<size_t>(num_nodes),
+        reinterpret_cast<const Node*>(mapping.data() + header_size)
+    );
 
-    return Octree(static_cast<size_t>(dim), std::move(nodes));
+    return Octree(static_cast<size_t>(dim), std::move(mapping), view);
 }
 
 void Octree::save_svo(const std::filesystem::path& path) const {
@@ -101,9 +106,9 @@ void Octree::save_svo(const std::filesystem::path& path) const {
 
     out.write(SVO_FMT_ID.data(), SVO_FMT_ID.size());
     write_uint_le(out, this->dim);
-    write_uint_le(out, this->nodes.size());
+    write_uint_le(out, this->view.size());
 
-    for (const auto& node : this->nodes) {
+    for (const auto& node : this->view) {
         for (uint32_t child : node.children) {
             write_uint_le(out, child);
         }
@@ -125,8 +130,8 @@ std::pair<const Octree::Node*, size_t> Octree::find(const Vec3Sz& pos, size_t ma
     while (true) {
         extent /= 2;
 
-        if (this->nodes[index].is_leaf() || extent == 0 || max_depth == 0) {
-            return {&this->nodes[index], index};
+        if (this->view[index].is_leaf() || extent == 0 || max_depth == 0) {
+            return {&this->view[index], index};
         }
 
         size_t child_index = 0;
@@ -146,7 +151,7 @@ std::pair<const Octree::Node*, size_t> Octree::find(const Vec3Sz& pos, size_t ma
             offset.z += extent;
         }
 
-        index = this->nodes[index].children[child_index];
+        index = this->view[index].children[child_index];
 
         --max_depth;
     }
@@ -179,6 +184,13 @@ void Octree::walk_leaves(F f) {
 }
 
 void Octree::generate_ropes() {
+    // Ropes are written into the nodes, which requires the nodes to be owned
+    if (this->mapping) {
+        this->nodes.assign(this->view.begin(), this->view.end());
+        this->mapping = MappedFile();
+        this->view = this->nodes;
+    }
+
     this->walk_leaves([this](const Vec3Sz& pos, size_t extent, size_t depth, Node& node) {
         auto node_xpos = this->find(pos + Vec3Sz{extent, 0, 0}, depth).second;
         auto node_xneg = this->find(pos + Vec3Sz{-extent, 0, 0}, depth).second;
@@ -12,13 +12,16 @@
 #include "math/Vec.h"
 #include "model/Pixel.h"
 #include "utility/Span.h"
+#include "utility/MappedFile.h"
 
 class Octree {
 public:
     enum class Type {
         Sparse,
         Dag,
-        Rope
+        Rope,
+        // A DAG which is stored in the compact node format of CompactOctree
+        Compact
     };
 
     constexpr const static size_t X_NEG = 0;
@@ -46,11 +49,18 @@ public:
 
 private:
     size_t dim;
+
+    // The nodes of the tree are either owned by the octree, or stored in a memory mapped file.
+    // `view` always refers to the nodes in use.
     std::vector<Node> nodes;
+    MappedFile mapping;
+    Span<Node> view;
 
 public:
     Octree(size_t dim, std::vector<Node>&& nodes);
 
+    // Map the nodes of an svo file directly into memory, so that no loading is required up front:
+    // the on-disk layout of the nodes matches Node on little-endian hosts.
     static Octree load_svo(const std::filesystem::path& path);
 
     void save_svo(const std::filesystem::path& path) const;
@@ -60,11 +70,11 @@ public:
     void generate_ropes();
 
     Span<Node> data() const {
-        return this->nodes;
+        return this->view;
     }
 
     size_t memory_footprint() const {
-        return sizeof(Octree) + this->nodes.size() * sizeof(Octree::Node);
+        return sizeof(Octree) + this->view.size() * sizeof(Octree::Node);
     }
 
     size_t side() const {
@@ -76,6 +86,8 @@ private:
 
     template <typename F>
     void walk_leaves(F f);
+
+    Octree(size_t dim, MappedFile&& mapping, Span<Node> view);
 };
 
 template<>
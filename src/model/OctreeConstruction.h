@@ -2,30 +2,270 @@
 #define _XENODON_MODEL_OCTREECONSTRUCTION_H
 
 #include <vector>
-#include <unordered_map>
+#include <algorithm>
+#include <array>
 #include <utility>
+#include <limits>
+#include <unordered_map>
+#include <functional>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <system_error>
 #include <cstdint>
 #include <cstddef>
+#include <cmath>
 #include <fmt/format.h>
+#include "core/Error.h"
 #include "model/Octree.h"
 #include "model/Grid.h"
+#include "utility/parallel.h"
+
+struct ConstructionStats;
 
+// Caches decide whether a node inserted into an OctreeBuilder duplicates a node that was inserted before.
+// They may replace the inserted node by an equivalent node, which is then inserted instead.
 struct NoopCache {
-    uint32_t operator()([[maybe_unused]] const Octree::Node& node, uint32_t index) {
+    uint32_t operator()([[maybe_unused]] Octree::Node& node, uint32_t index, [[maybe_unused]] const std::vector<Octree::Node>& nodes) {
         return index;
     }
+
+    void report([[maybe_unused]] ConstructionStats& stats) const {
+    }
 };
 
+// An open-addressing hash table which maps nodes to their index in the node list of an OctreeBuilder.
+// Slots only hold the upper half of the hash of a node and its index: the node itself is compared
+// through the node list, so the table takes 8 bytes per slot. Collisions are resolved with linear
+// probing, and the table is grown when its load factor would exceed 3/4.
+//
+// Nodes can be merged lossily (see ConstructionOptions), by replacing them with a canonical node before
+// looking them up: the depth is cleared when merging depths, and colors are replaced by the first color
+// that was inserted in the same cell of a grid over color space with cells of `color_tolerance + 1`
+// values per channel. Colors thus change by at most `color_tolerance` per channel, and the result does
+// not depend on how construction is split up, as the first color of every cell is the same.
 struct HashCache {
-    std::unordered_map<Octree::Node, uint32_t> cache;
+    struct Slot {
+        uint32_t tag;
+        uint32_t index;
+    };
 
-    uint32_t operator()(const Octree::Node& node, uint32_t index) {
-        const auto [it, inserted] = this->cache.insert({node, index});
-        if (inserted) {
-            return index;
+    constexpr const static uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+    constexpr const static size_t INITIAL_CAPACITY = 1024;
+
+    std::vector<Slot> slots;
+    size_t entries = 0;
+    size_t lookups = 0;
+    size_t probes = 0;
+
+    uint8_t color_tolerance = 0;
+    bool merge_depths = false;
+    std::unordered_map<uint32_t, Pixel> palette;
+
+    HashCache() = default;
+
+    HashCache(uint8_t color_tolerance, bool merge_depths):
+        color_tolerance(color_tolerance), merge_depths(merge_depths) {
+    }
+
+    // Return the index of a node equal to `node` in `nodes` if there is one, or insert `node`
+    // with `index` otherwise.
+    uint32_t operator()(Octree::Node& node, uint32_t index, const std::vector<Octree::Node>& nodes) {
+        this->canonicalize(node);
+
+        if ((this->entries + 1) * 4 > this->slots.size() * 3) {
+            this->grow(nodes);
         }
 
-        return it->second;
+        const uint64_t hash = std::hash<Octree::Node>{}(node);
+        const auto tag = static_cast<uint32_t>(hash >> 32);
+        const size_t mask = this->slots.size() - 1;
+
+        ++this->lookups;
+
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            ++this->probes;
+            auto& slot = this->slots[i];
+
+            if (slot.index == EMPTY) {
+                slot = {tag, index};
+                ++this->entries;
+                return index;
+            } else if (slot.tag == tag && nodes[slot.index] == node) {
+                return slot.index;
+            }
+        }
+    }
+
+    void report(ConstructionStats& stats) const;
+
+private:
+    void canonicalize(Octree::Node& node) {
+        if (this->merge_depths) {
+            node.is_leaf_depth &= Octree::LEAF;
+        }
+
+        if (this->color_tolerance > 0) {
+            const unsigned cell_size = this->color_tolerance + 1u;
+            const auto cell = Pixel{
+                static_cast<uint8_t>(node.color.r / cell_size),
+                static_cast<uint8_t>(node.color.g / cell_size),
+                static_cast<uint8_t>(node.color.b / cell_size),
+                static_cast<uint8_t>(node.color.a / cell_size)
+            };
+
+            node.color = this->palette.insert({cell.pack(), node.color}).first->second;
+        }
+    }
+
+    // Double the capacity of the table. As only part of the hash of each node is stored, the
+    // hashes are recomputed from the node list.
+    void grow(const std::vector<Octree::Node>& nodes) {
+        auto old_slots = std::vector<Slot>(std::max(INITIAL_CAPACITY, this->slots.size() * 2), Slot{0, EMPTY});
+        std::swap(this->slots, old_slots);
+
+        const size_t mask = this->slots.size() - 1;
+
+        for (const auto& old_slot : old_slots) {
+            if (old_slot.index == EMPTY) {
+                continue;
+            }
+
+            const uint64_t hash = std::hash<Octree::Node>{}(nodes[old_slot.index]);
+            size_t i = hash & mask;
+            while (this->slots[i].index != EMPTY) {
+                i = (i + 1) & mask;
+            }
+
+            this->slots[i] = old_slot;
+        }
+    }
+};
+
+// Statistics of a region of voxels. The aggregate of a region can be obtained by combining the
+// aggregates of the parts it consists of, which is used by the bottom-up construction.
+struct VoxelAggregate {
+    size_t count;
+    std::array<uint64_t, 4> sum;
+    std::array<uint64_t, 4> sum_sq;
+    Pixel min;
+    Pixel max;
+
+    VoxelAggregate():
+        count(0),
+        sum{0, 0, 0, 0},
+        sum_sq{0, 0, 0, 0},
+        min{0xFF, 0xFF, 0xFF, 0xFF},
+        max{0, 0, 0, 0} {
+    }
+
+    explicit VoxelAggregate(Pixel pix):
+        count(1),
+        sum{pix.r, pix.g, pix.b, pix.a},
+        sum_sq{
+            uint64_t{pix.r} * pix.r,
+            uint64_t{pix.g} * pix.g,
+            uint64_t{pix.b} * pix.b,
+            uint64_t{pix.a} * pix.a
+        },
+        min(pix),
+        max(pix) {
+    }
+
+    void add(Pixel pix) {
+        ++this->count;
+
+        this->sum[0] += pix.r;
+        this->sum[1] += pix.g;
+        this->sum[2] += pix.b;
+        this->sum[3] += pix.a;
+
+        this->sum_sq[0] += uint64_t{pix.r} * pix.r;
+        this->sum_sq[1] += uint64_t{pix.g} * pix.g;
+        this->sum_sq[2] += uint64_t{pix.b} * pix.b;
+        this->sum_sq[3] += uint64_t{pix.a} * pix.a;
+
+        this->min = Pixel{
+            std::min(this->min.r, pix.r),
+            std::min(this->min.g, pix.g),
+            std::min(this->min.b, pix.b),
+            std::min(this->min.a, pix.a)
+        };
+
+        this->max = Pixel{
+            std::max(this->max.r, pix.r),
+            std::max(this->max.g, pix.g),
+            std::max(this->max.b, pix.b),
+            std::max(this->max.a, pix.a)
+        };
+    }
+
+    VoxelAggregate& operator+=(const VoxelAggregate& other) {
+        this->count += other.count;
+
+        for (size_t i = 0; i < 4; ++i) {
+            this->sum[i] += other.sum[i];
+            this->sum_sq[i] += other.sum_sq[i];
+        }
+
+        this->min = Pixel{
+            std::min(this->min.r, other.min.r),
+            std::min(this->min.g, other.min.g),
+            std::min(this->min.b, other.min.b),
+            std::min(this->min.a, other.min.a)
+        };
+
+        this->max = Pixel{
+            std::max(this->max.r, other.max.r),
+            std::max(this->max.g, other.max.g),
+            std::max(this->max.b, other.max.b),
+            std::max(this->max.a, other.max.a)
+        };
+
+        return *this;
+    }
+
+    // Rounded the same way as the average returned by Grid::vol_scan and Grid::stddev_scan
+    Pixel average() const {
+        if (this->count == 0) {
+            return {0, 0, 0, 0};
+        }
+
+        return {
+            static_cast<uint8_t>(this->sum[0] / this->count),
+            static_cast<uint8_t>(this->sum[1] / this->count),
+            static_cast<uint8_t>(this->sum[2] / this->count),
+            static_cast<uint8_t>(this->sum[3] / this->count)
+        };
+    }
+
+    uint8_t max_diff() const {
+        if (this->count == 0) {
+            return 0;
+        }
+
+        return std::max({
+            static_cast<uint8_t>(this->max.r - this->min.r),
+            static_cast<uint8_t>(this->max.g - this->min.g),
+            static_cast<uint8_t>(this->max.b - this->min.b),
+            static_cast<uint8_t>(this->max.a - this->min.a)
+        });
+    }
+
+    // The sum over all channels of the squared differences between each voxel and the channel average.
+    double squared_deviation() const {
+        if (this->count == 0) {
+            return 0;
+        }
+
+        // Computed exactly as (n * sum_sq - sum^2) / n, which does not fit in 64 bits for large regions
+        unsigned __int128 total = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            total += static_cast<unsigned __int128>(this->count) * this->sum_sq[i];
+            total -= static_cast<unsigned __int128>(this->sum[i]) * this->sum[i];
+        }
+
+        return static_cast<double>(total) / static_cast<double>(this->count);
     }
 };
 
@@ -36,6 +276,16 @@ struct ChannelDiffHeuristic {
         const auto [avg, max_diff] = grid.vol_scan(offset, offset + extent);
         return {avg, max_diff > this->channel_diff};
     }
+
+    bool split(const VoxelAggregate& aggregate) const {
+        return aggregate.max_diff() > this->channel_diff;
+    }
+
+    // Whether a region of `voxels` voxels certainly needs to be split, given the aggregate of only a part
+    // of it. The channel difference of a region is at least that of any part of it.
+    bool must_split(const VoxelAggregate& partial, [[maybe_unused]] size_t voxels) const {
+        return this->split(partial);
+    }
 };
 
 struct StdDevHeuristic {
@@ -45,6 +295,20 @@ struct StdDevHeuristic {
         const auto [avg, stddev] = grid.stddev_scan(offset, offset + extent);
         return {avg, stddev > this->stddev};
     }
+
+    bool split(const VoxelAggregate& aggregate) const {
+        return this->must_split(aggregate, aggregate.count);
+    }
+
+    // The sum of squared deviations of a region is at least that of any part of it, so dividing the
+    // deviation of the part by the size of the whole region gives a lower bound of the variance.
+    bool must_split(const VoxelAggregate& partial, size_t voxels) const {
+        if (voxels == 0) {
+            return false;
+        }
+
+        return std::sqrt(partial.squared_deviation() / static_cast<double>(voxels)) > this->stddev;
+    }
 };
 
 struct ConstructionStats {
@@ -53,14 +317,54 @@ struct ConstructionStats {
     size_t total_nodes;
     size_t depth;
 
+    // Statistics of the HashCache which eliminates duplicate nodes. Lookups and probes are counted over
+    // all tables used during construction, the entries and slots are those of the table of the final tree.
+    size_t cache_lookups;
+    size_t cache_probes;
+    size_t cache_entries;
+    size_t cache_slots;
+
     ConstructionStats():
         total_leaves(0),
         unique_leaves(0),
         total_nodes(0),
-        depth(0) {
+        depth(0),
+        cache_lookups(0),
+        cache_probes(0),
+        cache_entries(0),
+        cache_slots(0) {
     }
 };
 
+inline void HashCache::report(ConstructionStats& stats) const {
+    stats.cache_lookups += this->lookups;
+    stats.cache_probes += this->probes;
+    stats.cache_entries = this->entries;
+    stats.cache_slots = this->slots.size();
+}
+
+struct ConstructionOptions {
+    Octree::Type type = Octree::Type::Sparse;
+
+    // Compute the statistics of each node from those of its children instead of scanning the grid for
+    // every node, see detail::BottomUpConstruction. The resulting tree is the same.
+    bool bottom_up = false;
+
+    // When larger than 1, independent subtrees are constructed concurrently. The resulting tree is the same.
+    size_t threads = 1;
+
+    // Lossy merging of DAG nodes, see HashCache: colors are quantized to cells of `color_tolerance + 1` values
+    // per channel, and nodes whose colors fall into the same cells are merged. When `merge_depths` is set,
+    // equivalent nodes at different depths are merged.
+    // The depth of the nodes in the resulting tree is then 0.
+    uint8_t color_tolerance = 0;
+    bool merge_depths = false;
+
+    // The layout in which build_octree_streaming loads the slabs of the source. build_octree uses the grid
+    // as given, but construction is faster with the bricked layout, as every node scans a contiguous region.
+    Grid::Layout layout = Grid::Layout::Bricked;
+};
+
 namespace detail {
     template <typename Cache>
     struct OctreeBuilder {
@@ -72,9 +376,9 @@ namespace detail {
             dim(dim), cache(cache) {
         }
 
-        std::pair<uint32_t, bool> insert(const Octree::Node& node) {
+        std::pair<uint32_t, bool> insert(Octree::Node node) {
             const uint32_t end_index = static_cast<uint32_t>(this->nodes.size());
-            const uint32_t actual_index = this->cache(node, end_index);
+            const uint32_t actual_index = this->cache(node, end_index, this->nodes);
             const bool inserted = actual_index == end_index;
 
             if (inserted) {
@@ -120,6 +424,32 @@ namespace detail {
         ConstructionStats& stats;
     };
 
+    struct Classification {
+        Pixel color;
+        bool leaf;
+    };
+
+    // Decide whether the area [offset, offset + extent) becomes a leaf, and which color the node gets
+    template <typename SplitHeuristic>
+    Classification classify(const Grid& grid, const SplitHeuristic& heuristic, const Vec3Sz& offset, size_t extent) {
+        // Check if the current area [offset, offset + extent) is totally outside the source grid
+        const bool totally_in_grid = offset.x < grid.dimensions().x &&
+            offset.y < grid.dimensions().y &&
+            offset.z < grid.dimensions().z;
+
+        if (!totally_in_grid) {
+            return {Pixel{0, 0, 0, 0}, true};
+        }
+
+        // Check if the current area [offset, offset + extent] is partly outside the source grid
+        const bool partly_in_grid = offset.x + extent <= grid.dimensions().x &&
+            offset.y + extent <= grid.dimensions().y &&
+            offset.z + extent <= grid.dimensions().z;
+
+        const auto [avg, split] = heuristic.grid_scan(grid, offset, extent);
+        return {avg, (!split && partly_in_grid) || extent == 1};
+    }
+
     template <typename SplitHeuristic, typename Cache>
     uint32_t construct(Context<SplitHeuristic, Cache>& ctx, const Vec3Sz& offset, size_t extent, size_t depth) {
         ctx.stats.depth = std::max(ctx.stats.depth, depth);
@@ -138,30 +468,9 @@ namespace detail {
             return index;
         };
 
-        // Check if the current area [offset, offset + extent) is totally outside the source grid
-        const bool totally_in_grid = offset.x < ctx.grid.dimensions().x &&
-            offset.y < ctx.grid.dimensions().y &&
-            offset.z < ctx.grid.dimensions().z;
-
-        if (!totally_in_grid) {
-            const auto node = Octree::Node{
-                .children = {0},
-                .color = Pixel{0, 0, 0, 0},
-                .is_leaf_depth = Octree::LEAF | static_cast<uint32_t>(depth),
-            };
-
-            return insert(node, true);
-        }
-
-        // Check if the current area [offset, offset + extent] is partly outside the source grid
-        const bool partly_in_grid = offset.x + extent <= ctx.grid.dimensions().x &&
-            offset.y + extent <= ctx.grid.dimensions().y &&
-            offset.z + extent <= ctx.grid.dimensions().z;
-
-        const auto [avg, split] = ctx.heuristic.grid_scan(ctx.grid, offset, extent);
+        const auto [avg, leaf] = classify(ctx.grid, ctx.heuristic, offset, extent);
 
-        if ((!split && partly_in_grid) || extent == 1) {
-            // This node is a leaf node
+        if (leaf) {
             const auto node = Octree::Node{
                 .children = {0},
                 .color = avg,
@@ -193,8 +502,470 @@ namespace detail {
         }
     }
 
+    // Constructs a (sub)tree in a single pass over the grid, by computing the statistics of every node from
+    // the statistics of its children. Each voxel is read exactly once, instead of once for every level of
+    // the tree as in construct().
+    // Whether a node is a leaf is only known after all of its children are visited, so completed nodes are
+    // kept in a pending list until all of their ancestors are certain to be interior nodes. Nodes are then
+    // inserted into the builder in the same order as construct() would, so the resulting tree is identical.
+    template <typename SplitHeuristic, typename Cache>
+    struct BottomUpConstruction {
+        struct Frame {
+            VoxelAggregate aggregate; // Aggregate of the children visited so far
+            size_t region_voxels; // Number of voxels of the node's area that are inside the grid
+            bool in_grid;
+            std::array<uint32_t, 8> children;
+            size_t completed;
+            size_t pending_begin;
+        };
+
+        Context<SplitHeuristic, Cache>& ctx;
+
+        // The frames of the nodes on the path from the root to the node being visited
+        std::vector<Frame> frames;
+
+        // The number of frames, from the root onwards, that are certain to be interior nodes of the tree.
+        // Children of these frames are inserted into the builder directly.
+        size_t emitting;
+
+        // Completed nodes that are not yet known to be part of the tree, in construction order. Child
+        // indices of these nodes, and of non-emitting frames, are indices into this list.
+        std::vector<Octree::Node> pending;
+
+        BottomUpConstruction(Context<SplitHeuristic, Cache>& ctx):
+            ctx(ctx), emitting(0) {
+        }
+
+        uint32_t construct(const Vec3Sz& offset, size_t extent, size_t depth, VoxelAggregate& aggregate) {
+            const auto dim = this->ctx.grid.dimensions();
+
+            const bool totally_in_grid = offset.x < dim.x && offset.y < dim.y && offset.z < dim.z;
+            if (!totally_in_grid) {
+                aggregate = VoxelAggregate();
+                return this->add({
+                    .children = {0},
+                    .color = Pixel{0, 0, 0, 0},
+                    .is_leaf_depth = Octree::LEAF | static_cast<uint32_t>(depth)
+                });
+            }
+
+            if (extent == 1) {
+                const auto pix = this->ctx.grid.at(offset);
+                aggregate = VoxelAggregate(pix);
+                return this->add({
+                    .children = {0},
+                    .color = pix,
+                    .is_leaf_depth = Octree::LEAF | static_cast<uint32_t>(depth)
+                });
+            }
+
+            const auto bmax = Vec3Sz{
+                std::min(dim.x, offset.x + extent),
+                std::min(dim.y, offset.y + extent),
+                std::min(dim.z, offset.z + extent)
+            };
+
+            const bool in_grid = bmax.x - offset.x == extent && bmax.y - offset.y == extent && bmax.z - offset.z == extent;
+
+            if (extent == 2 && in_grid) {
+                return this->construct_bottom(offset, depth, aggregate);
+            }
+
+            this->frames.push_back({
+                VoxelAggregate(),
+                (bmax.x - offset.x) * (bmax.y - offset.y) * (bmax.z - offset.z),
+                in_grid,
+                {0},
+                0,
+                this->pending.size()
+            });
+
+            this->update_emitting();
+
+            const size_t h_extent = extent / 2;
+
+            for (auto xoff : {size_t{0}, h_extent}) {
+                for (auto yoff : {size_t{0}, h_extent}) {
+                    for (auto zoff : {size_t{0}, h_extent}) {
+                        auto child_aggregate = VoxelAggregate();
+                        uint32_t index = this->construct({offset.x + xoff, offset.y + yoff, offset.z + zoff}, h_extent, depth + 1, child_aggregate);
+
+                        auto& frame = this->frames.back();
+                        frame.children[frame.completed++] = index;
+                        frame.aggregate += child_aggregate;
+
+                        this->update_emitting();
+                    }
+                }
+            }
+
+            aggregate = this->frames.back().aggregate;
+            return this->complete(depth);
+        }
+
+        // Specialization of construct() for nodes of 2x2x2 voxels inside the grid, which reads the voxels
+        // directly instead of creating (and possibly discarding) a leaf node for each of them.
+        uint32_t construct_bottom(const Vec3Sz& offset, size_t depth, VoxelAggregate& aggregate) {
+            const auto voxels = this->ctx.grid.cube_voxels(offset);
+
+            aggregate = VoxelAggregate();
+            for (auto pix : voxels) {
+                aggregate.add(pix);
+            }
+
+            if (!this->ctx.heuristic.split(aggregate)) {
+                return this->add({
+                    .children = {0},
+                    .color = aggregate.average(),
+                    .is_leaf_depth = Octree::LEAF | static_cast<uint32_t>(depth)
+                });
+            }
+
+            this->frames.push_back({aggregate, 8, true, {0}, 0, this->pending.size()});
+            this->update_emitting();
+
+            auto& frame = this->frames.back();
+
+            for (auto pix : voxels) {
+                frame.children[frame.completed++] = this->add({
+                    .children = {0},
+                    .color = pix,
+                    .is_leaf_depth = Octree::LEAF | static_cast<uint32_t>(depth + 1)
+                });
+            }
+
+            return this->complete(depth);
+        }
+
+        // Finish the node of the last frame, of which all children have been constructed.
+        uint32_t complete(size_t depth) {
+            const size_t frame_index = this->frames.size() - 1;
+            auto& frame = this->frames.back();
+            const bool leaf = frame_index >= this->emitting && frame.in_grid && !this->ctx.heuristic.split(frame.aggregate);
+
+            if (!leaf && frame_index == this->emitting) {
+                this->emit(frame_index);
+            }
+
+            auto node = Octree::Node{
+                .children = {0},
+                .color = frame.aggregate.average(),
+                .is_leaf_depth = static_cast<uint32_t>(depth)
+            };
+
+            if (leaf) {
+                // The children of this node are not part of the tree
+                this->pending.resize(frame.pending_begin);
+                node.is_leaf_depth |= Octree::LEAF;
+            } else {
+                node.children = frame.children;
+            }
+
+            this->frames.pop_back();
+            this->emitting = std::min(this->emitting, this->frames.size());
+
+            return this->add(node);
+        }
+
+        uint32_t add(const Octree::Node& node) {
+            if (this->emitting < this->frames.size()) {
+                this->pending.push_back(node);
+                return static_cast<uint32_t>(this->pending.size() - 1);
+            }
+
+            return this->insert(node);
+        }
+
+        uint32_t insert(const Octree::Node& node) {
+            const auto [index, inserted] = this->ctx.builder.insert(node);
+
+            this->ctx.stats.depth = std::max(this->ctx.stats.depth, static_cast<size_t>(node.is_leaf_depth & ~Octree::LEAF));
+            ++this->ctx.stats.total_nodes;
+            if (node.is_leaf()) {
+                ++this->ctx.stats.total_leaves;
+                if (inserted) {
+                    ++this->ctx.stats.unique_leaves;
+                }
+            }
+
+            return index;
+        }
+
+        void update_emitting() {
+            while (this->emitting < this->frames.size()) {
+                const auto& frame = this->frames[this->emitting];
+                if (frame.in_grid && !this->ctx.heuristic.must_split(frame.aggregate, frame.region_voxels)) {
+                    break;
+                }
+
+                this->emit(this->emitting);
+            }
+        }
+
+        // Mark the first non-emitting frame as emitting, and insert its completed children into the builder.
+        void emit(size_t frame_index) {
+            // All frames above this one are emitting, so all pending nodes up to the next frame belong to the
+            // completed children of this frame.
+            const size_t end = frame_index + 1 < this->frames.size() ?
+                this->frames[frame_index + 1].pending_begin :
+                this->pending.size();
+
+            auto remap = std::vector<uint32_t>(end);
+
+            for (size_t i = 0; i < end; ++i) {
+                auto node = this->pending[i];
+                if (!node.is_leaf()) {
+                    for (uint32_t& child : node.children) {
+                        child = remap[child];
+                    }
+                }
+
+                remap[i] = this->insert(node);
+            }
+
+            this->emitting = frame_index + 1;
+
+            auto& frame = this->frames[frame_index];
+            for (size_t i = 0; i < frame.completed; ++i) {
+                frame.children[i] = remap[frame.children[i]];
+            }
+
+            // Remove the inserted nodes, and correct the indices into the remaining part of the pending list
+            const uint32_t shift = static_cast<uint32_t>(end);
+            this->pending.erase(this->pending.begin(), this->pending.begin() + static_cast<ptrdiff_t>(end));
+
+            for (auto& node : this->pending) {
+                if (!node.is_leaf()) {
+                    for (uint32_t& child : node.children) {
+                        child -= shift;
+                    }
+                }
+            }
+
+            for (size_t i = frame_index + 1; i < this->frames.size(); ++i) {
+                auto& deeper = this->frames[i];
+                deeper.pending_begin -= end;
+                for (size_t j = 0; j < deeper.completed; ++j) {
+                    deeper.children[j] -= shift;
+                }
+            }
+        }
+    };
+
+    template <typename SplitHeuristic, typename Cache>
+    uint32_t construct_bottom_up(Context<SplitHeuristic, Cache>& ctx, const Vec3Sz& offset, size_t extent, size_t depth, VoxelAggregate& aggregate) {
+        auto construction = BottomUpConstruction<SplitHeuristic, Cache>(ctx);
+        return construction.construct(offset, extent, depth, aggregate);
+    }
+
+    // Compute the aggregate of the voxels of the area [offset, offset + extent) that lie inside the grid
+    inline VoxelAggregate scan_aggregate(const Grid& grid, const Vec3Sz& offset, size_t extent) {
+        const auto dim = grid.dimensions();
+        const auto bmin = Vec3Sz{std::min(dim.x, offset.x), std::min(dim.y, offset.y), std::min(dim.z, offset.z)};
+        const auto bmax = Vec3Sz{
+            std::min(dim.x, offset.x + extent),
+            std::min(dim.y, offset.y + extent),
+            std::min(dim.z, offset.z + extent)
+        };
+
+        auto aggregate = VoxelAggregate();
+        if (bmin.x == bmax.x || bmin.y == bmax.y || bmin.z == bmax.z) {
+            return aggregate;
+        }
+
+        grid.scan_voxels(bmin, bmax, [&](const Pixel* run, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                aggregate.add(run[i]);
+            }
+        });
+
+        return aggregate;
+    }
+
+    // A node of the top levels of the tree, which are classified separately from the subtrees below
+    // them, so that the subtrees can be constructed independently.
+    struct TopLevelNode {
+        Vec3Sz offset;
+        size_t extent;
+        size_t depth;
+        Classification classification;
+
+        // For interior nodes, the index of the first of 8 consecutive children in the top level node list.
+        // For nodes at the split depth, the index of the subtree which was constructed in its place.
+        size_t index;
+    };
+
+    struct Subtree {
+        std::vector<Octree::Node> nodes;
+        ConstructionStats stats;
+        uint32_t root;
+    };
+
+    template <typename Cache>
+    struct Assembler {
+        const std::vector<TopLevelNode>& top_level;
+        std::function<Subtree(size_t)> load_subtree;
+        size_t split_depth;
+        OctreeBuilder<Cache>& builder;
+        ConstructionStats& stats;
+
+        // Add the nodes of a subtree to the final tree in the order they were constructed, which is
+        // the same order in which the serial construction would have inserted them. Child indices are
+        // remapped, and the nodes are inserted into the cache again so duplicates of nodes from
+        // previously added subtrees are eliminated.
+        uint32_t splice(const Subtree& subtree) {
+            auto remap = std::vector<uint32_t>(subtree.nodes.size());
+
+            for (size_t i = 0; i < subtree.nodes.size(); ++i) {
+                auto node = subtree.nodes[i];
+                if (!node.is_leaf()) {
+                    for (uint32_t& child : node.children) {
+                        child = remap[child];
+                    }
+                }
+
+                const auto [index, inserted] = this->builder.insert(node);
+                if (inserted && node.is_leaf()) {
+                    ++this->stats.unique_leaves;
+                }
+
+                remap[i] = index;
+            }
+
+            this->stats.total_nodes += subtree.stats.total_nodes;
+            this->stats.total_leaves += subtree.stats.total_leaves;
+            this->stats.depth = std::max(this->stats.depth, subtree.stats.depth);
+            this->stats.cache_lookups += subtree.stats.cache_lookups;
+            this->stats.cache_probes += subtree.stats.cache_probes;
+
+            return remap[subtree.root];
+        }
+
+        uint32_t assemble(const TopLevelNode& tl_node) {
+            // Nodes at the split depth are only classified when no subtree is constructed for them
+            if (tl_node.depth == this->split_depth && !tl_node.classification.leaf) {
+                return this->splice(this->load_subtree(tl_node.index));
+            }
+
+            this->stats.depth = std::max(this->stats.depth, tl_node.depth);
+            ++this->stats.total_nodes;
+
+            auto node = Octree::Node{
+                .children = {0},
+                .color = tl_node.classification.color,
+                .is_leaf_depth = static_cast<uint32_t>(tl_node.depth)
+            };
+
+            if (tl_node.classification.leaf) {
+                node.is_leaf_depth |= Octree::LEAF;
+                ++this->stats.total_leaves;
+            } else {
+                for (size_t i = 0; i < 8; ++i) {
+                    node.children[i] = this->assemble(this->top_level[tl_node.index + i]);
+                }
+            }
+
+            const auto [index, inserted] = this->builder.insert(node);
+            if (inserted && node.is_leaf()) {
+                ++this->stats.unique_leaves;
+            }
+
+            return index;
+        }
+    };
+
     template <typename SplitHeuristic, typename Cache>
-    Octree build_octree(const Grid& grid, ConstructionStats& stats, const SplitHeuristic& heuristic, const Cache& cache) {
+    Octree build_octree_parallel(const Grid& grid, ConstructionStats& stats, const SplitHeuristic& heuristic, const Cache& cache, size_t dim, const ConstructionOptions& options) {
+        const size_t threads = options.threads;
+
+        // Split at a depth where there are enough subtrees to keep all threads busy, even when
+        // the subtrees vary wildly in size.
+        size_t split_depth = 0;
+        for (size_t subtrees = 1; subtrees < threads * 8 && (dim >> split_depth) > 1; subtrees *= 8) {
+            ++split_depth;
+        }
+
+        // Classify the top levels breadth-first, so that the nodes of each level can be scanned in parallel.
+        auto top_level = std::vector<TopLevelNode>{{Vec3Sz(0), dim, 0, {}, 0}};
+        size_t level_begin = 0;
+
+        for (size_t depth = 0; depth < split_depth; ++depth) {
+            const size_t level_end = top_level.size();
+
+            parallel_for(threads, level_end - level_begin, [&](size_t i) {
+                auto& tl_node = top_level[level_begin + i];
+                tl_node.classification = classify(grid, heuristic, tl_node.offset, tl_node.extent);
+            });
+
+            for (size_t i = level_begin; i < level_end; ++i) {
+                if (top_level[i].classification.leaf) {
+                    continue;
+                }
+
+                const auto offset = top_level[i].offset;
+                const size_t h_extent = top_level[i].extent / 2;
+                top_level[i].index = top_level.size();
+
+                for (auto xoff : {size_t{0}, h_extent}) {
+                    for (auto yoff : {size_t{0}, h_extent}) {
+                        for (auto zoff : {size_t{0}, h_extent}) {
+                            top_level.push_back({
+                                {offset.x + xoff, offset.y + yoff, offset.z + zoff},
+                                h_extent,
+                                depth + 1,
+                                {},
+                                0
+                            });
+                        }
+                    }
+                }
+            }
+
+            level_begin = level_end;
+        }
+
+        // Construct all subtrees at the split depth independently
+        auto subtrees = std::vector<Subtree>(top_level.size() - level_begin);
+        for (size_t i = level_begin; i < top_level.size(); ++i) {
+            top_level[i].index = i - level_begin;
+        }
+
+        fmt::print("Constructing {} subtrees on {} threads...\n", subtrees.size(), std::min(threads, subtrees.size()));
+
+        parallel_for(threads, subtrees.size(), [&](size_t i) {
+            const auto& tl_node = top_level[level_begin + i];
+            auto& subtree = subtrees[i];
+
+            auto context = detail::Context<SplitHeuristic, Cache> {
+                grid,
+                heuristic,
+                OctreeBuilder(dim, cache),
+                subtree.stats
+            };
+
+            auto aggregate = VoxelAggregate();
+            subtree.root = options.bottom_up ?
+                detail::construct_bottom_up(context, tl_node.offset, tl_node.extent, tl_node.depth, aggregate) :
+                detail::construct(context, tl_node.offset, tl_node.extent, tl_node.depth);
+            context.builder.cache.report(subtree.stats);
+            subtree.nodes = std::move(context.builder.nodes);
+        });
+
+        auto load_subtree = [&subtrees](size_t index) {
+            // Subtrees are spliced only once, so the memory can be released early
+            return std::move(subtrees[index]);
+        };
+
+        auto builder = OctreeBuilder(dim, cache);
+        auto assembler = Assembler<Cache>{top_level, load_subtree, split_depth, builder, stats};
+        assembler.assemble(top_level[0]);
+        builder.cache.report(stats);
+
+        return std::move(builder).build();
+    }
+
+    // The side of the smallest octree of which the side is a power of two, that covers a grid of `src_dim`
+    inline size_t octree_side(const Vec3Sz& src_dim) {
         // https://graphics.stanford.edu/~seander/bithacks.html#RoundUpPowerOf2
         const auto ceil_2pow = [](uint64_t x) {
             --x;
@@ -207,8 +978,16 @@ namespace detail {
             return ++x;
         };
 
-        const auto src_dim = grid.dimensions();
-        const auto dim = std::max({ceil_2pow(src_dim.x), ceil_2pow(src_dim.y), ceil_2pow(src_dim.z)});
+        return std::max({ceil_2pow(src_dim.x), ceil_2pow(src_dim.y), ceil_2pow(src_dim.z)});
+    }
+
+    template <typename SplitHeuristic, typename Cache>
+    Octree build_octree(const Grid& grid, ConstructionStats& stats, const SplitHeuristic& heuristic, const Cache& cache, const ConstructionOptions& options) {
+        const size_t dim = octree_side(grid.dimensions());
+
+        if (options.threads > 1) {
+            return build_octree_parallel(grid, stats, heuristic, cache, dim, options);
+        }
 
         auto context = detail::Context<SplitHeuristic, Cache> {
             grid,
@@ -217,23 +996,245 @@ namespace detail {
             stats
         };
 
-        detail::construct(context, Vec3Sz(0), dim, 0);
+        if (options.bottom_up) {
+            auto aggregate = VoxelAggregate();
+            detail::construct_bottom_up(context, Vec3Sz(0), dim, 0, aggregate);
+        } else {
+            detail::construct(context, Vec3Sz(0), dim, 0);
+        }
 
+        context.builder.cache.report(stats);
         return std::move(context.builder).build();
     }
+
+    // A subtree which was constructed and written to the spill file
+    struct SpilledSubtree {
+        std::streamoff offset;
+        size_t nodes;
+        uint32_t root;
+        ConstructionStats stats;
+        VoxelAggregate aggregate;
+    };
+
+    // Temporary file holding the nodes of constructed subtrees, which is removed when the construction
+    // finishes or fails.
+    struct SpillFile {
+        std::filesystem::path path;
+        std::fstream file;
+
+        SpillFile(const std::filesystem::path& path):
+            path(path),
+            file(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc) {
+            if (!this->file) {
+                throw Error("Failed to open spill file '{}'", path.native());
+            }
+        }
+
+        ~SpillFile() {
+            this->file.close();
+
+            auto ec = std::error_code();
+            std::filesystem::remove(this->path, ec);
+        }
+    };
+
+    template <typename SplitHeuristic, typename Cache>
+    Octree build_octree_streaming(const std::filesystem::path& src, const std::filesystem::path& spill_path, ConstructionStats& stats, const SplitHeuristic& heuristic, const Cache& cache, const ConstructionOptions& options, size_t max_memory) {
+        const auto src_dim = Grid::tiff_dimensions(src);
+        const size_t dim = octree_side(src_dim);
+
+        // The memory taken by a slab of `layers` layers in the layout in which slabs are loaded. Bricked slabs
+        // are padded up to whole bricks, so slabs of fewer than Grid::BRICK_SIDE layers take as much memory as
+        // slabs of Grid::BRICK_SIDE layers.
+        auto slab_size = [&](size_t layers) {
+            return Grid::memory_required({src_dim.x, src_dim.y, std::min(layers, src_dim.z)}, options.layout);
+        };
+
+        if (slab_size(1) > max_memory) {
+            throw Error(
+                "Memory budget of {} bytes cannot hold a single layer of the source, which takes {} bytes in this grid layout",
+                max_memory,
+                slab_size(1)
+            );
+        }
+
+        // The subtrees at the split depth are constructed a slab of `extent` layers at a time. Split deep enough
+        // for a slab to fit in the memory budget, and, like build_octree_parallel, to keep all threads busy.
+        auto needs_split = [&](size_t depth) {
+            const size_t subtrees = size_t{1} << (3 * depth);
+            return slab_size(dim >> depth) > max_memory || (options.threads > 1 && subtrees < options.threads * 8);
+        };
+
+        size_t split_depth = 0;
+        while ((dim >> split_depth) > 1 && needs_split(split_depth)) {
+            ++split_depth;
+        }
+
+        const size_t extent = dim >> split_depth;
+        const auto slabs = (src_dim + (extent - 1)) / extent;
+
+        // Lay out the top levels breadth-first. These cannot be classified until all subtrees below them
+        // are constructed, so only the nodes outside of the grid are known to be leaves.
+        auto top_level = std::vector<TopLevelNode>{{Vec3Sz(0), dim, 0, {}, 0}};
+
+        for (size_t i = 0; i < top_level.size(); ++i) {
+            const auto offset = top_level[i].offset;
+            const size_t depth = top_level[i].depth;
+
+            if (offset.x >= src_dim.x || offset.y >= src_dim.y || offset.z >= src_dim.z) {
+                top_level[i].classification = {Pixel{0, 0, 0, 0}, true};
+                continue;
+            }
+
+            if (depth == split_depth) {
+                const auto slab_pos = offset / extent;
+                top_level[i].index = (slab_pos.z * slabs.y + slab_pos.y) * slabs.x + slab_pos.x;
+                continue;
+            }
+
+            const size_t h_extent = top_level[i].extent / 2;
+            top_level[i].index = top_level.size();
+
+            for (auto xoff : {size_t{0}, h_extent}) {
+                for (auto yoff : {size_t{0}, h_extent}) {
+                    for (auto zoff : {size_t{0}, h_extent}) {
+                        top_level.push_back({
+                            {offset.x + xoff, offset.y + yoff, offset.z + zoff},
+                            h_extent,
+                            depth + 1,
+                            {},
+                            0
+                        });
+                    }
+                }
+            }
+        }
+
+        auto spill = SpillFile(spill_path);
+        auto spilled = std::vector<SpilledSubtree>(slabs.x * slabs.y * slabs.z);
+        auto spill_mutex = std::mutex();
+
+        for (size_t z = 0; z < slabs.z; ++z) {
+            const size_t first_layer = z * extent;
+            const size_t layers = std::min(extent, src_dim.z - first_layer);
+
+            fmt::print("Loading slab {}/{} (layers {}-{})...\n", z + 1, slabs.z, first_layer, first_layer + layers - 1);
+            const auto slab = Grid::load_tiff_layers(src, first_layer, layers, options.threads, options.layout);
+
+            // The slab grid only holds the layers of this slab, but has the same x- and y-dimensions as
+            // the source, so subtrees are constructed relative to the first layer of the slab.
+            parallel_for(options.threads, slabs.x * slabs.y, [&](size_t i) {
+                auto& subtree = spilled[z * slabs.x * slabs.y + i];
+                const auto offset = Vec3Sz{i % slabs.x * extent, i / slabs.x * extent, 0};
+
+                auto context = detail::Context<SplitHeuristic, Cache> {
+                    slab,
+                    heuristic,
+                    OctreeBuilder(dim, cache),
+                    subtree.stats
+                };
+
+                if (options.bottom_up) {
+                    subtree.root = detail::construct_bottom_up(context, offset, extent, split_depth, subtree.aggregate);
+                } else {
+                    subtree.root = detail::construct(context, offset, extent, split_depth);
+                    subtree.aggregate = scan_aggregate(slab, offset, extent);
+                }
+
+                context.builder.cache.report(subtree.stats);
+
+                const auto& nodes = context.builder.nodes;
+                subtree.nodes = nodes.size();
+
+                auto lock = std::lock_guard(spill_mutex);
+                subtree.offset = spill.file.tellp();
+                spill.file.write(reinterpret_cast<const char*>(nodes.data()), static_cast<std::streamsize>(nodes.size() * sizeof(Octree::Node)));
+
+                if (!spill.file) {
+                    throw Error("Failed to write to spill file '{}'", spill.path.native());
+                }
+            });
+        }
+
+        // Classify the top levels bottom-up from the aggregates of the subtrees, the same way classify() would.
+        auto aggregates = std::vector<VoxelAggregate>(top_level.size());
+
+        for (size_t i = top_level.size(); i-- > 0;) {
+            auto& tl_node = top_level[i];
+
+            if (tl_node.classification.leaf) {
+                continue;
+            } else if (tl_node.depth == split_depth) {
+                aggregates[i] = spilled[tl_node.index].aggregate;
+                continue;
+            }
+
+            for (size_t j = 0; j < 8; ++j) {
+                aggregates[i] += aggregates[tl_node.index + j];
+            }
+
+            const auto bmax = tl_node.offset + tl_node.extent;
+            const bool in_grid = bmax.x <= src_dim.x && bmax.y <= src_dim.y && bmax.z <= src_dim.z;
+            tl_node.classification = {aggregates[i].average(), in_grid && !heuristic.split(aggregates[i])};
+        }
+
+        auto load_subtree = [&](size_t index) {
+            const auto& spilled_subtree = spilled[index];
+            auto subtree = Subtree{
+                std::vector<Octree::Node>(spilled_subtree.nodes),
+                spilled_subtree.stats,
+                spilled_subtree.root
+            };
+
+            spill.file.seekg(spilled_subtree.offset);
+            spill.file.read(reinterpret_cast<char*>(subtree.nodes.data()), static_cast<std::streamsize>(subtree.nodes.size() * sizeof(Octree::Node)));
+
+            if (!spill.file) {
+                throw Error("Failed to read from spill file '{}'", spill.path.native());
+            }
+
+            return subtree;
+        };
+
+        fmt::print("Assembling {} subtrees...\n", spilled.size());
+
+        auto builder = OctreeBuilder(dim, cache);
+        auto assembler = Assembler<Cache>{top_level, load_subtree, split_depth, builder, stats};
+        assembler.assemble(top_level[0]);
+        builder.cache.report(stats);
+
+        return std::move(builder).build();
+    }
+}
+
+template <typename SplitHeuristic>
+Octree build_octree(const Grid& grid, ConstructionStats& stats, const SplitHeuristic& heuristic, const ConstructionOptions& options) {
+    auto octree = options.type == Octree::Type::Dag || options.type == Octree::Type::Compact ?
+        detail::build_octree(grid, stats, heuristic, HashCache(options.color_tolerance, options.merge_depths), options) :
+        detail::build_octree(grid, stats, heuristic, NoopCache{}, options);
+
+    if (options.type == Octree::Type::Rope) {
+        octree.generate_ropes();
+    }
+
+    return octree;
 }
 
+// Construct an octree from the stacked TIFF image at `src` without loading the entire image at once: The source
+// is read in slabs of layers of at most `max_memory` bytes, and the subtrees constructed from each slab are written
+// to a temporary file at `spill_path` until the final tree is assembled. The resulting tree is the same as the tree
+// constructed by build_octree from the entire image.
 template <typename SplitHeuristic>
-Octree build_octree(const Grid& grid, ConstructionStats& stats, const SplitHeuristic& heuristic, Octree::Type type) {
-    auto octree = type == Octree::Type::Dag ?
-        detail::build_octree(grid, stats, heuristic, HashCache{}) :
-        detail::build_octree(grid, stats, heuristic, NoopCache{});
+Octree build_octree_streaming(const std::filesystem::path& src, const std::filesystem::path& spill_path, ConstructionStats& stats, const SplitHeuristic& heuristic, const ConstructionOptions& options, size_t max_memory) {
+    auto octree = options.type == Octree::Type::Dag || options.type == Octree::Type::Compact ?
+        detail::build_octree_streaming(src, spill_path, stats, heuristic, HashCache(options.color_tolerance, options.merge_depths), options, max_memory) :
+        detail::build_octree_streaming(src, spill_path, stats, heuristic, NoopCache{}, options, max_memory);
 
-    if (type == Octree::Type::Rope) {
+    if (options.type == Octree::Type::Rope) {
         octree.generate_ropes();
     }
 
-    return std::move(octree);
+    return octree;
 }
 
 #endif
@@ -0,0 +1,74 @@
+#include "model/SummedVolumeTable.h"
+#include "utility/parallel.h"
+
+namespace {
+    using Entry = scan_kernels::StdDevAccumulator;
+
+    // Unsigned arithmetic is modulo 2^64, which is what makes queries on wrapped entries exact
+    void add(Entry& dst, const Entry& src) {
+        for (size_t c = 0; c < 4; ++c) {
+            dst.sum[c] += src.sum[c];
+            dst.sum_sq[c] += src.sum_sq[c];
+        }
+    }
+
+    void sub(Entry& dst, const Entry& src) {
+        for (size_t c = 0; c < 4; ++c) {
+            dst.sum[c] -= src.sum[c];
+            dst.sum_sq[c] -= src.sum_sq[c];
+        }
+    }
+}
+
+SummedVolumeTable::SummedVolumeTable(const Pixel* data, Vec3Sz dim, size_t threads):
+    dim(dim), entries(std::make_unique<Entry[]>((dim.x + 1) * (dim.y + 1) * (dim.z + 1))) {
+
+    // The prefix sum is separable, so it is computed with one pass over each plane of the grid that
+    // computes its 2D prefix sum, and a pass along the z-axis that adds the planes together. Entries
+    // with a zero coordinate stay zero.
+    parallel_for(threads, dim.z, [&](size_t z) {
+        for (size_t y = 0; y < dim.y; ++y) {
+            const Pixel* row = &data[(z * dim.y + y) * dim.x];
+            auto accum = Entry();
+
+            for (size_t x = 0; x < dim.x; ++x) {
+                const Pixel pix = row[x];
+                const uint8_t channels[4] = {pix.r, pix.g, pix.b, pix.a};
+
+                for (size_t c = 0; c < 4; ++c) {
+                    accum.sum[c] += channels[c];
+                    accum.sum_sq[c] += uint64_t{channels[c]} * channels[c];
+                }
+
+                auto& entry = this->entries[this->index(x + 1, y + 1, z + 1)];
+                entry = accum;
+                add(entry, this->entries[this->index(x + 1, y, z + 1)]);
+            }
+        }
+    });
+
+    parallel_for(threads, dim.y, [&](size_t y) {
+        for (size_t z = 2; z <= dim.z; ++z) {
+            for (size_t x = 1; x <= dim.x; ++x) {
+                add(this->entries[this->index(x, y + 1, z)], this->entries[this->index(x, y + 1, z - 1)]);
+            }
+        }
+    });
+}
+
+size_t SummedVolumeTable::memory_required(Vec3Sz dim) {
+    return (dim.x + 1) * (dim.y + 1) * (dim.z + 1) * sizeof(Entry);
+}
+
+scan_kernels::StdDevAccumulator SummedVolumeTable::query(Vec3Sz bmin, Vec3Sz bmax) const {
+    // Inclusion-exclusion over the corners of the box
+    auto result = this->entries[this->index(bmax.x, bmax.y, bmax.z)];
+    sub(result, this->entries[this->index(bmin.x, bmax.y, bmax.z)]);
+    sub(result, this->entries[this->index(bmax.x, bmin.y, bmax.z)]);
+    sub(result, this->entries[this->index(bmax.x, bmax.y, bmin.z)]);
+    add(result, this->entries[this->index(bmin.x, bmin.y, bmax.z)]);
+    add(result, this->entries[this->index(bmin.x, bmax.y, bmin.z)]);
+    add(result, this->entries[this->index(bmax.x, bmin.y, bmin.z)]);
+    sub(result, this->entries[this->index(bmin.x, bmin.y, bmin.z)]);
+    return result;
+}
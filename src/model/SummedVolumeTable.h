@@ -0,0 +1,43 @@
+#ifndef _XENODON_MODEL_SUMMEDVOLUMETABLE_H
+#define _XENODON_MODEL_SUMMEDVOLUMETABLE_H
+
+#include <memory>
+#include <cstddef>
+#include "math/Vec.h"
+#include "model/Pixel.h"
+#include "model/GridScan.h"
+
+// A 3D prefix sum of the channels and squared channels of a grid of pixels, with which the sums over
+// any box of the grid can be computed with 8 lookups. Entry (x, y, z) holds the sums over the box
+// [0, x) * [0, y) * [0, z), so the table has one more entry than the grid along every axis.
+//
+// Entries are computed modulo 2^64. A query only adds and subtracts entries, so it is exact as long
+// as the sums of the queried box itself fit in 64 bits, even if the entries it is computed from wrapped.
+// For the squared channels this holds for boxes of up to 2^64 / 255^2 (about 2.8 * 10^14) voxels,
+// well beyond the size of any grid that fits in memory.
+class SummedVolumeTable {
+    Vec3Sz dim;
+    std::unique_ptr<scan_kernels::StdDevAccumulator[]> entries;
+
+public:
+    // Build the table of a grid of `dim` pixels, using at most `threads` threads.
+    SummedVolumeTable(const Pixel* data, Vec3Sz dim, size_t threads);
+
+    // The number of bytes required by the table of a grid with dimensions `dim`. Note that this is
+    // 16 times the size of the grid itself.
+    static size_t memory_required(Vec3Sz dim);
+
+    // Compute the sums over the box [bmin, bmax), which must lie inside the grid.
+    scan_kernels::StdDevAccumulator query(Vec3Sz bmin, Vec3Sz bmax) const;
+
+    size_t memory_footprint() const {
+        return SummedVolumeTable::memory_required(this->dim);
+    }
+
+private:
+    size_t index(size_t x, size_t y, size_t z) const {
+        return x + (this->dim.x + 1) * (y + (this->dim.y + 1) * z);
+    }
+};
+
+#endif
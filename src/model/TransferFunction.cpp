@@ -0,0 +1,108 @@
+#include "model/TransferFunction.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "core/Error.h"
+
+namespace {
+    struct ControlPoint {
+        float value;
+        float channels[4];
+    };
+}
+
+TransferFunction TransferFunction::grayscale() {
+    auto tf = TransferFunction();
+
+    for (size_t i = 0; i < RESOLUTION; ++i) {
+        const auto v = static_cast<uint8_t>(i * 255 / (RESOLUTION - 1));
+        tf.entries[i] = {v, v, v, 255};
+    }
+
+    return tf;
+}
+
+TransferFunction TransferFunction::load(const std::filesystem::path& path) {
+    auto input = std::ifstream(path);
+    if (!input) {
+        throw Error("Failed to open '{}'", path.native());
+    }
+
+    auto points = std::vector<ControlPoint>();
+    auto line = std::string();
+    size_t line_number = 0;
+
+    while (std::getline(input, line)) {
+        ++line_number;
+
+        auto ss = std::istringstream(line);
+        ss >> std::ws;
+        if (ss.eof() || ss.peek() == '#') {
+            continue;
+        }
+
+        auto point = ControlPoint();
+        ss >> point.value;
+        for (float& channel : point.channels) {
+            ss >> channel;
+        }
+
+        if (ss.fail()) {
+            throw Error("Syntax error in transfer function on line {}", line_number);
+        }
+
+        ss >> std::ws;
+        if (!ss.eof()) {
+            throw Error("Trailing characters in transfer function on line {}", line_number);
+        }
+
+        if (point.value < 0 || point.value > 1) {
+            throw Error("Value out of range in transfer function on line {}", line_number);
+        }
+
+        for (float channel : point.channels) {
+            if (channel < 0 || channel > 255) {
+                throw Error("Channel out of range in transfer function on line {}", line_number);
+            }
+        }
+
+        if (!points.empty() && point.value < points.back().value) {
+            throw Error("Control points out of order in transfer function on line {}", line_number);
+        }
+
+        points.push_back(point);
+    }
+
+    if (points.empty()) {
+        throw Error("Transfer function '{}' contains no control points", path.native());
+    }
+
+    auto tf = TransferFunction();
+    size_t segment = 0;
+
+    for (size_t i = 0; i < RESOLUTION; ++i) {
+        const float x = static_cast<float>(i) / static_cast<float>(RESOLUTION - 1);
+
+        while (segment + 1 < points.size() && points[segment + 1].value < x) {
+            ++segment;
+        }
+
+        // Values outside of the control points take the color of the nearest one
+        const auto& a = points[segment];
+        const auto& b = segment + 1 < points.size() ? points[segment + 1] : a;
+        const float span = b.value - a.value;
+        const float t = span > 0 ? std::clamp((x - a.value) / span, 0.f, 1.f) : (x < a.value ? 0.f : 1.f);
+
+        uint8_t channels[4];
+        for (size_t c = 0; c < 4; ++c) {
+            channels[c] = static_cast<uint8_t>(std::lround(a.channels[c] + (b.channels[c] - a.channels[c]) * t));
+        }
+
+        tf.entries[i] = {channels[0], channels[1], channels[2], channels[3]};
+    }
+
+    return tf;
+}
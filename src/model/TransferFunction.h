@@ -0,0 +1,36 @@
+#ifndef _XENODON_MODEL_TRANSFERFUNCTION_H
+#define _XENODON_MODEL_TRANSFERFUNCTION_H
+
+#include <array>
+#include <filesystem>
+#include <cstddef>
+#include "model/Pixel.h"
+#include "utility/Span.h"
+
+// A transfer function maps the normalized value of a scalar voxel to an emission color (rgb)
+// and absorption (a). It is stored as a table of evenly spaced entries over [0, 1], which
+// is linearly interpolated when sampled. The size of the table is fixed, so that a new transfer
+// function can be uploaded in place of an old one.
+class TransferFunction {
+public:
+    constexpr const static size_t RESOLUTION = 256;
+
+private:
+    std::array<Pixel, RESOLUTION> entries;
+
+    TransferFunction() = default;
+
+public:
+    static TransferFunction grayscale();
+
+    // Load a transfer function from a text file of control points. Each non-empty line which does
+    // not start with '#' holds a control point '<value> <r> <g> <b> <a>', where value ranges from 0-1
+    // and the channels from 0-255. Control points must be given in increasing order of value.
+    static TransferFunction load(const std::filesystem::path& path);
+
+    Span<Pixel> data() const {
+        return this->entries;
+    }
+};
+
+#endif
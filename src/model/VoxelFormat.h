@@ -0,0 +1,110 @@
+#ifndef _XENODON_MODEL_VOXELFORMAT_H
+#define _XENODON_MODEL_VOXELFORMAT_H
+
+#include <string_view>
+#include <optional>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// The formats in which the voxels of a Grid can be stored. These values are stored in raw volume
+// files (see Grid::save_volume), and should not be changed.
+enum class VoxelFormat: uint32_t {
+    // 8-bit RGBA colors, stored as Pixels. Only grids of this format can be converted to octrees.
+    Rgba8 = 0,
+
+    // Scalar formats, which are colored by a transfer function when rendered. R8 and R16 are unsigned
+    // normalized, R16F is a half-precision float.
+    R8 = 1,
+    R16 = 2,
+    R16F = 3
+};
+
+constexpr size_t voxel_size(VoxelFormat format) {
+    switch (format) {
+        case VoxelFormat::Rgba8:
+            return 4;
+        case VoxelFormat::R8:
+            return 1;
+        case VoxelFormat::R16:
+        case VoxelFormat::R16F:
+            return 2;
+    }
+
+    return 0;
+}
+
+constexpr std::string_view voxel_format_to_string(VoxelFormat format) {
+    switch (format) {
+        case VoxelFormat::Rgba8:
+            return "rgba8";
+        case VoxelFormat::R8:
+            return "r8";
+        case VoxelFormat::R16:
+            return "r16";
+        case VoxelFormat::R16F:
+            return "r16f";
+    }
+
+    return "unknown";
+}
+
+constexpr std::optional<VoxelFormat> parse_voxel_format(std::string_view str) {
+    for (auto format : {VoxelFormat::Rgba8, VoxelFormat::R8, VoxelFormat::R16, VoxelFormat::R16F}) {
+        if (str == voxel_format_to_string(format)) {
+            return format;
+        }
+    }
+
+    return std::nullopt;
+}
+
+inline float half_to_float(uint16_t h) {
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1F;
+    uint32_t mantissa = h & 0x3FF;
+
+    uint32_t bits;
+    if (exponent == 0x1F) {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        bits = sign;
+    } else {
+        // Normalize the subnormal
+        exponent = 113;
+        while (!(mantissa & 0x400)) {
+            mantissa <<= 1;
+            --exponent;
+        }
+
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+
+    float f;
+    std::memcpy(&f, &bits, sizeof f);
+    return f;
+}
+
+// The normalized value of the i-th voxel of scalar voxel data in the given format, or 0 for Rgba8.
+inline float scalar_at(VoxelFormat format, const uint8_t* data, size_t i) {
+    switch (format) {
+        case VoxelFormat::R8:
+            return static_cast<float>(data[i]) / 255.f;
+        case VoxelFormat::R16: {
+            uint16_t v;
+            std::memcpy(&v, &data[i * 2], sizeof v);
+            return static_cast<float>(v) / 65535.f;
+        }
+        case VoxelFormat::R16F: {
+            uint16_t v;
+            std::memcpy(&v, &data[i * 2], sizeof v);
+            return half_to_float(v);
+        }
+        default:
+            return 0;
+    }
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include "render/CompactSvoRaytraceAlgorithm.h"
+#include <cstring>
+
+namespace {
+    const auto COMPACT_SVO_BINDINGS = std::array {
+        Binding {
+            2,
+            vk::DescriptorType::eStorageBuffer
+        }
+    };
+}
+
+CompactSvoRaytraceResources::CompactSvoRaytraceResources(const RenderDevice& rendev, const CompactOctree& octree):
+    node_buffer(
+        rendev.device,
+        octree.data().size(),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal
+    ) {
+
+    const Span<CompactOctree::Node> nodes = octree.data();
+
+    const auto copy_info = vk::BufferCopy{
+        0,
+        0,
+        nodes.size() * sizeof(CompactOctree::Node)
+    };
+
+    auto staging_buffer = Buffer<CompactOctree::Node>(
+        rendev.device,
+        nodes.size(),
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+
+    // If the octree is memory mapped, this reads the nodes straight from the file mapping
+    CompactOctree::Node* staging_nodes = staging_buffer.map(0, nodes.size());
+    std::memcpy(staging_nodes, nodes.data(), nodes.size() * sizeof(CompactOctree::Node));
+    staging_buffer.unmap();
+
+    rendev.compute_command_pool.one_time_submit([&](vk::CommandBuffer cmd_buf) {
+        cmd_buf.copyBuffer(staging_buffer.get(), node_buffer.get(), copy_info);
+    });
+
+    this->size = nodes.size();
+}
+
+void CompactSvoRaytraceResources::update_descriptors(vk::DescriptorSet set) const {
+    const auto buffer_info = this->node_buffer.descriptor_info(0, this->size);
+
+    const auto descriptor_write = vk::WriteDescriptorSet(
+        set,
+        COMPACT_SVO_BINDINGS[0].binding,
+        0,
+        1,
+        COMPACT_SVO_BINDINGS[0].type,
+        nullptr,
+        &buffer_info,
+        nullptr
+    );
+
+    this->node_buffer.device().updateDescriptorSets(descriptor_write, nullptr);
+}
+
+CompactSvoRaytraceAlgorithm::CompactSvoRaytraceAlgorithm(std::string_view shader_source, std::shared_ptr<CompactOctree> octree):
+    shader_source(shader_source),
+    octree(octree) {
+}
+
+std::string_view CompactSvoRaytraceAlgorithm::shader() const {
+    return this->shader_source;
+}
+
+Span<Binding> CompactSvoRaytraceAlgorithm::bindings() const {
+    return COMPACT_SVO_BINDINGS;
+}
+
+std::unique_ptr<RenderResources> CompactSvoRaytraceAlgorithm::upload_resources(const RenderDevice& rendev) const {
+    return std::make_unique<CompactSvoRaytraceResources>(rendev, *this->octree.get());
+}
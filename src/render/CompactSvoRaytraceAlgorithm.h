@@ -0,0 +1,32 @@
+#ifndef _XENODON_RENDER_COMPACTSVORAYTRACEALGORITHM_H
+#define _XENODON_RENDER_COMPACTSVORAYTRACEALGORITHM_H
+
+#include <string_view>
+#include <memory>
+#include <cstddef>
+#include "render/RenderAlgorithm.h"
+#include "model/CompactOctree.h"
+#include "backend/RenderDevice.h"
+#include "graphics/memory/Buffer.h"
+
+class CompactSvoRaytraceResources: public RenderResources {
+    Buffer<CompactOctree::Node> node_buffer;
+    size_t size;
+
+public:
+    CompactSvoRaytraceResources(const RenderDevice& rendev, const CompactOctree& octree);
+    void update_descriptors(vk::DescriptorSet set) const override;
+};
+
+class CompactSvoRaytraceAlgorithm: public RenderAlgorithm {
+    std::string_view shader_source;
+    std::shared_ptr<CompactOctree> octree;
+
+public:
+    CompactSvoRaytraceAlgorithm(std::string_view shader_source, std::shared_ptr<CompactOctree> octree);
+    std::string_view shader() const override;
+    Span<Binding> bindings() const override;
+    std::unique_ptr<RenderResources> upload_resources(const RenderDevice& rendev) const override;
+};
+
+#endif
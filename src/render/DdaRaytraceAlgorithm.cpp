@@ -1,6 +1,11 @@
 #include "render/DdaRaytraceAlgorithm.h"
 #include <utility>
+#include <vector>
+#include <chrono>
+#include <cstring>
 #include "resources.h"
+#include "core/Error.h"
+#include "core/Logger.h"
 #include "graphics/utility.h"
 
 namespace {
@@ -8,14 +13,130 @@ namespace {
         Binding {
             2,
             vk::DescriptorType::eCombinedImageSampler
+        },
+        Binding {
+            4,
+            vk::DescriptorType::eCombinedImageSampler
+        }
+    };
+
+    const auto DDA_SCALAR_BINDINGS = std::array {
+        Binding {
+            2,
+            vk::DescriptorType::eCombinedImageSampler
+        },
+        Binding {
+            3,
+            vk::DescriptorType::eCombinedImageSampler
+        },
+        Binding {
+            4,
+            vk::DescriptorType::eCombinedImageSampler
         }
     };
+
+    vk::Extent3D occupancy_extent(const OccupancyGrid* occupancy_grid) {
+        if (!occupancy_grid) {
+            return {1, 1, 1};
+        }
+
+        return {
+            static_cast<uint32_t>(occupancy_grid->blocks().x),
+            static_cast<uint32_t>(occupancy_grid->blocks().y),
+            static_cast<uint32_t>(occupancy_grid->blocks().z)
+        };
+    }
+
+    vk::Format texture_format(const RenderDevice& rendev, VoxelFormat format) {
+        auto vk_format = vk::Format::eR8G8B8A8Unorm;
+
+        switch (format) {
+            case VoxelFormat::Rgba8:
+                vk_format = vk::Format::eR8G8B8A8Unorm;
+                break;
+            case VoxelFormat::R8:
+                vk_format = vk::Format::eR8Unorm;
+                break;
+            case VoxelFormat::R16:
+                vk_format = vk::Format::eR16Unorm;
+                break;
+            case VoxelFormat::R16F:
+                vk_format = vk::Format::eR16Sfloat;
+                break;
+        }
+
+        const auto props = rendev.device.physical_device().getFormatProperties(vk_format);
+        if (!(props.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage)) {
+            throw Error("Device does not support sampling {} voxels", voxel_format_to_string(format));
+        }
+
+        return vk_format;
+    }
+
+    void upload_texture(const RenderDevice& rendev, vk::Image image, Span<uint8_t> data, vk::Extent3D extent) {
+        const auto copy_info = vk::BufferImageCopy(
+            0,
+            0,
+            0,
+            vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+            {0, 0, 0},
+            extent
+        );
+
+        auto staging_buffer = Buffer<uint8_t>(
+            rendev.device,
+            data.size(),
+            vk::BufferUsageFlagBits::eTransferSrc,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+        );
+
+        {
+            auto* mapping = staging_buffer.map(0, data.size());
+            std::memcpy(mapping, data.data(), data.size());
+            staging_buffer.unmap();
+        }
+
+        rendev.compute_command_pool.one_time_submit([&](vk::CommandBuffer cmd_buf) {
+            const auto initial_state = ImageState{
+                vk::ImageLayout::eUndefined,
+                vk::PipelineStageFlagBits::eTopOfPipe
+            };
+
+            const auto upload_state = ImageState{
+                vk::ImageLayout::eTransferDstOptimal,
+                vk::PipelineStageFlagBits::eTransfer,
+                vk::AccessFlagBits::eTransferWrite
+            };
+
+            const auto render_state = ImageState{
+                vk::ImageLayout::eShaderReadOnlyOptimal,
+                vk::PipelineStageFlagBits::eComputeShader,
+                vk::AccessFlagBits::eShaderRead
+            };
+
+            image_transition(cmd_buf, image, initial_state, upload_state);
+
+            cmd_buf.copyBufferToImage(
+                staging_buffer.get(),
+                image,
+                upload_state.layout,
+                copy_info
+            );
+
+            image_transition(cmd_buf, image, upload_state, render_state);
+        });
+    }
 }
 
-DdaRaytraceResources::DdaRaytraceResources(const RenderDevice& rendev, const Grid& grid):
+DdaRaytraceResources::DdaRaytraceResources(
+    const RenderDevice& rendev,
+    const Grid& grid,
+    const TransferFunction& transfer_function,
+    std::shared_ptr<const OccupancyGrid> occupancy_grid
+):
     grid_texture(
         rendev.device,
-        vk::Format::eR8G8B8A8Unorm,
+        texture_format(rendev, grid.format()),
         vk::Extent3D{
             static_cast<uint32_t>(grid.dimensions().x),
             static_cast<uint32_t>(grid.dimensions().y),
@@ -31,14 +152,28 @@ DdaRaytraceResources::DdaRaytraceResources(const RenderDevice& rendev, const Gri
         vk::SamplerAddressMode::eClampToBorder,
         vk::SamplerAddressMode::eClampToBorder,
         vk::SamplerAddressMode::eClampToBorder
+    })),
+    occupancy_grid(std::move(occupancy_grid)),
+    occupancy_texture(
+        rendev.device,
+        vk::Format::eR8Uint,
+        occupancy_extent(this->occupancy_grid.get()),
+        vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled
+    ),
+    occupancy_sampler(rendev.device->createSamplerUnique({
+        {},
+        vk::Filter::eNearest,
+        vk::Filter::eNearest,
+        vk::SamplerMipmapMode::eNearest,
+        vk::SamplerAddressMode::eClampToEdge,
+        vk::SamplerAddressMode::eClampToEdge,
+        vk::SamplerAddressMode::eClampToEdge
     })) {
 
-    const auto copy_info = vk::BufferImageCopy(
-        0,
-        0,
-        0,
-        vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
-        {0, 0, 0},
+    upload_texture(
+        rendev,
+        this->grid_texture.get(),
+        grid.voxel_data(),
         vk::Extent3D{
             static_cast<uint32_t>(grid.dimensions().x),
             static_cast<uint32_t>(grid.dimensions().y),
@@ -46,54 +181,29 @@ DdaRaytraceResources::DdaRaytraceResources(const RenderDevice& rendev, const Gri
         }
     );
 
-    const auto pixels = grid.pixels();
+    if (grid.format() == VoxelFormat::Rgba8) {
+        this->upload_occupancy(rendev, transfer_function);
+        return;
+    }
 
-    auto staging_buffer = Buffer<Pixel>(
+    this->transfer_texture.emplace(
         rendev.device,
-        pixels.size(),
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+        vk::Format::eR8G8B8A8Unorm,
+        static_cast<uint32_t>(TransferFunction::RESOLUTION),
+        vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled
     );
 
-    {
-        auto* mapping = staging_buffer.map(0, pixels.size());
-
-        for (size_t i = 0; i < pixels.size(); ++i) {
-            mapping[i] = pixels[i];
-        }
-
-        staging_buffer.unmap();
-    }
-
-    rendev.compute_command_pool.one_time_submit([&, this](vk::CommandBuffer cmd_buf) {
-        const auto initial_state = ImageState{
-            vk::ImageLayout::eUndefined,
-            vk::PipelineStageFlagBits::eTopOfPipe
-        };
-
-        const auto upload_state = ImageState{
-            vk::ImageLayout::eTransferDstOptimal,
-            vk::PipelineStageFlagBits::eTransfer,
-            vk::AccessFlagBits::eTransferWrite
-        };
-
-        const auto render_state = ImageState{
-            vk::ImageLayout::eShaderReadOnlyOptimal,
-            vk::PipelineStageFlagBits::eComputeShader,
-            vk::AccessFlagBits::eShaderRead
-        };
-
-        image_transition(cmd_buf, this->grid_texture.get(), initial_state, upload_state);
-
-        cmd_buf.copyBufferToImage(
-            staging_buffer.get(),
-            this->grid_texture.get(),
-            upload_state.layout,
-            copy_info
-        );
-
-        image_transition(cmd_buf, this->grid_texture.get(), upload_state, render_state);
+    this->transfer_sampler = rendev.device->createSamplerUnique({
+        {},
+        vk::Filter::eLinear,
+        vk::Filter::eLinear,
+        vk::SamplerMipmapMode::eNearest,
+        vk::SamplerAddressMode::eClampToEdge,
+        vk::SamplerAddressMode::eClampToEdge,
+        vk::SamplerAddressMode::eClampToEdge
     });
+
+    this->upload_transfer_function(rendev, transfer_function);
 }
 
 void DdaRaytraceResources::update_descriptors(vk::DescriptorSet set) const {
@@ -115,20 +225,119 @@ void DdaRaytraceResources::update_descriptors(vk::DescriptorSet set) const {
     );
 
     this->grid_texture.device().updateDescriptorSets(descriptor_write, nullptr);
+
+    const auto occupancy_info = vk::DescriptorImageInfo(
+        this->occupancy_sampler.get(),
+        this->occupancy_texture.view(),
+        vk::ImageLayout::eShaderReadOnlyOptimal
+    );
+
+    const auto occupancy_write = vk::WriteDescriptorSet(
+        set,
+        DDA_BINDINGS[1].binding,
+        0,
+        1,
+        DDA_BINDINGS[1].type,
+        &occupancy_info,
+        nullptr,
+        nullptr
+    );
+
+    this->grid_texture.device().updateDescriptorSets(occupancy_write, nullptr);
+
+    if (!this->transfer_texture) {
+        return;
+    }
+
+    const auto transfer_info = vk::DescriptorImageInfo(
+        this->transfer_sampler.get(),
+        this->transfer_texture->view(),
+        vk::ImageLayout::eShaderReadOnlyOptimal
+    );
+
+    const auto transfer_write = vk::WriteDescriptorSet(
+        set,
+        DDA_SCALAR_BINDINGS[1].binding,
+        0,
+        1,
+        DDA_SCALAR_BINDINGS[1].type,
+        &transfer_info,
+        nullptr,
+        nullptr
+    );
+
+    this->grid_texture.device().updateDescriptorSets(transfer_write, nullptr);
+}
+
+void DdaRaytraceResources::upload_transfer_function(const RenderDevice& rendev, const TransferFunction& transfer_function) {
+    if (!this->transfer_texture) {
+        return;
+    }
+
+    const auto entries = transfer_function.data();
+
+    upload_texture(
+        rendev,
+        this->transfer_texture->get(),
+        Span<uint8_t>(entries.size() * sizeof(Pixel), reinterpret_cast<const uint8_t*>(entries.data())),
+        vk::Extent3D{static_cast<uint32_t>(entries.size()), 1, 1}
+    );
+
+    // Which blocks are empty depends on the colors of the transfer function
+    this->upload_occupancy(rendev, transfer_function);
 }
 
-DdaRaytraceAlgorithm::DdaRaytraceAlgorithm(std::shared_ptr<Grid> grid):
-    grid(grid) {
+void DdaRaytraceResources::upload_occupancy(const RenderDevice& rendev, const TransferFunction& transfer_function) {
+    const auto occupancy = this->occupancy_grid ?
+        this->occupancy_grid->occupancy(transfer_function) :
+        std::vector<uint8_t>{OccupancyGrid::EMISSIVE | OccupancyGrid::ABSORBENT};
+
+    upload_texture(
+        rendev,
+        this->occupancy_texture.get(),
+        Span<uint8_t>(occupancy.size(), occupancy.data()),
+        occupancy_extent(this->occupancy_grid.get())
+    );
+}
+
+DdaRaytraceAlgorithm::DdaRaytraceAlgorithm(std::shared_ptr<Grid> grid, TransferFunction transfer_function, bool empty_space_skipping):
+    grid(grid),
+    transfer_function(std::move(transfer_function)) {
+
+    if (!empty_space_skipping) {
+        return;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    this->occupancy_grid = std::make_shared<OccupancyGrid>(*this->grid);
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    const auto blocks = this->occupancy_grid->blocks();
+    LOGGER.log(
+        "Built occupancy grid of {}x{}x{} blocks in {:.3f}s",
+        blocks.x,
+        blocks.y,
+        blocks.z,
+        std::chrono::duration<double>(stop - start).count()
+    );
 }
 
 std::string_view DdaRaytraceAlgorithm::shader() const {
-    return resources::open("resources/dda.comp");
+    if (this->grid->format() == VoxelFormat::Rgba8) {
+        return resources::open("resources/dda.comp");
+    }
+
+    return resources::open("resources/dda_scalar.comp");
 }
 
 Span<Binding> DdaRaytraceAlgorithm::bindings() const {
-    return DDA_BINDINGS;
+    if (this->grid->format() == VoxelFormat::Rgba8) {
+        return DDA_BINDINGS;
+    }
+
+    return DDA_SCALAR_BINDINGS;
 }
 
 std::unique_ptr<RenderResources> DdaRaytraceAlgorithm::upload_resources(const RenderDevice& rendev) const {
-    return std::make_unique<DdaRaytraceResources>(rendev, *this->grid.get());
+    return std::make_unique<DdaRaytraceResources>(rendev, *this->grid.get(), this->transfer_function, this->occupancy_grid);
 }
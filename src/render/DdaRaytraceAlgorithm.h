@@ -2,25 +2,56 @@
 #define _XENODON_RENDER_DDARAYTRACEALGORITHM_H
 
 #include <memory>
+#include <optional>
 #include "render/RenderAlgorithm.h"
 #include "model/Grid.h"
+#include "model/TransferFunction.h"
+#include "model/OccupancyGrid.h"
 #include "backend/RenderDevice.h"
 #include "graphics/memory/Texture3D.h"
+#include "graphics/memory/Texture1D.h"
 
 class DdaRaytraceResources: public RenderResources {
     Texture3D grid_texture;
     vk::UniqueSampler sampler;
 
+    // Only present when the grid holds scalar voxels
+    std::optional<Texture1D> transfer_texture;
+    vk::UniqueSampler transfer_sampler;
+
+    // When empty space skipping is disabled, there is no occupancy grid, and the
+    // occupancy texture consists of a single emissive and absorbent block.
+    std::shared_ptr<const OccupancyGrid> occupancy_grid;
+    Texture3D occupancy_texture;
+    vk::UniqueSampler occupancy_sampler;
+
 public:
-    DdaRaytraceResources(const RenderDevice& rendev, const Grid& grid);
+    DdaRaytraceResources(
+        const RenderDevice& rendev,
+        const Grid& grid,
+        const TransferFunction& transfer_function,
+        std::shared_ptr<const OccupancyGrid> occupancy_grid
+    );
+
     void update_descriptors(vk::DescriptorSet set) const override;
+    void upload_transfer_function(const RenderDevice& rendev, const TransferFunction& transfer_function) override;
+
+private:
+    void upload_occupancy(const RenderDevice& rendev, const TransferFunction& transfer_function);
 };
 
 class DdaRaytraceAlgorithm: public RenderAlgorithm {
     std::shared_ptr<Grid> grid;
+    TransferFunction transfer_function;
+    std::shared_ptr<const OccupancyGrid> occupancy_grid;
 
 public:
-    DdaRaytraceAlgorithm(std::shared_ptr<Grid> grid);
+    DdaRaytraceAlgorithm(
+        std::shared_ptr<Grid> grid,
+        TransferFunction transfer_function = TransferFunction::grayscale(),
+        bool empty_space_skipping = true
+    );
+
     std::string_view shader() const override;
     Span<Binding> bindings() const override;
     std::unique_ptr<RenderResources> upload_resources(const RenderDevice& rendev) const override;
@@ -1,7 +1,14 @@
 #include "render/MultiplexRenderer.h"
 
-MultiplexRenderer::MultiplexRenderer(Display* display, std::unique_ptr<RenderAlgorithm>&& algorithm, const ShaderParameters& shader_params):
-    ctx(std::make_shared<RenderContext>(display, std::move(algorithm), shader_params)) {
+MultiplexRenderer::MultiplexRenderer(
+    Display* display,
+    std::unique_ptr<RenderAlgorithm>&& algorithm,
+    const ShaderParameters& shader_params,
+    Vec2<uint32_t> workgroup_size,
+    const std::filesystem::path& pipeline_cache_dir
+):
+    ctx(std::make_shared<RenderContext>(display, std::move(algorithm), shader_params, workgroup_size, pipeline_cache_dir)),
+    frame(0) {
 
     const size_t n = display->num_render_devices();
     for (size_t i = 0; i < n; ++i) {
@@ -9,6 +16,14 @@ MultiplexRenderer::MultiplexRenderer(Display* display, std::unique_ptr<RenderAlg
     }
 }
 
+MultiplexRenderer::~MultiplexRenderer() {
+    // Resources of the renderers may still be used by frames in flight
+    const size_t n = this->ctx->display->num_render_devices();
+    for (size_t i = 0; i < n; ++i) {
+        this->ctx->display->render_device(i).device->waitIdle();
+    }
+}
+
 void MultiplexRenderer::recreate(size_t device, size_t output) {
     this->ctx->calculate_display_rect();
     this->renderers[device].recreate(output);
@@ -19,23 +34,55 @@ void MultiplexRenderer::recreate(size_t device, size_t output) {
 }
 
 void MultiplexRenderer::render(const Camera& cam) {
+    const size_t slot = this->frame % Renderer::MAX_FRAMES_IN_FLIGHT;
+
+    // Only wait for the frame which was rendered MAX_FRAMES_IN_FLIGHT frames ago, the
+    // frames after it may still be rendering while this one is recorded.
+    this->finish_frame(slot);
+
     for (auto& renderer : this->renderers) {
-        renderer.render(cam);
+        renderer.render(cam, slot);
     }
 
     this->ctx->display->swap_buffers();
+    ++this->frame;
+}
 
+void MultiplexRenderer::upload_transfer_function(const TransferFunction& transfer_function) {
     for (auto& renderer : this->renderers) {
-        renderer.collect_stats();
+        renderer.upload_transfer_function(transfer_function);
+    }
+}
+
+void MultiplexRenderer::finish() {
+    // Oldest frame first, so that stats are completed in the order in which frames were rendered
+    for (size_t i = 0; i < Renderer::MAX_FRAMES_IN_FLIGHT; ++i) {
+        this->finish_frame((this->frame + i) % Renderer::MAX_FRAMES_IN_FLIGHT);
     }
+
+    this->ctx->display->finish();
 }
 
-RenderStats MultiplexRenderer::stats() const {
+void MultiplexRenderer::collect_stats(RenderStatsAccumulator& accum) {
+    for (const auto& stats : this->completed) {
+        accum(stats);
+    }
+
+    this->completed.clear();
+}
+
+void MultiplexRenderer::finish_frame(size_t frame) {
     auto stats = RenderStats();
+    bool in_flight = false;
 
-    for (const auto& renderer : this->renderers) {
-        stats.combine(renderer.stats());
+    for (auto& renderer : this->renderers) {
+        if (auto renderer_stats = renderer.finish_frame(frame)) {
+            stats.combine(*renderer_stats);
+            in_flight = true;
+        }
     }
 
-    return stats;
-}
\ No newline at end of file
+    if (in_flight) {
+        this->completed.push_back(stats);
+    }
+}
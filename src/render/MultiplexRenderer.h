@@ -3,24 +3,53 @@
 
 #include <memory>
 #include <vector>
+#include <filesystem>
 #include <cstddef>
 #include "render/Renderer.h"
 #include "render/RenderContext.h"
 #include "render/RenderStats.h"
 #include "camera/Camera.h"
+#include "model/TransferFunction.h"
 #include "backend/Display.h"
+#include "math/Vec.h"
 
+// Renders frames on all render devices of a display. Up to Renderer::MAX_FRAMES_IN_FLIGHT frames are rendered
+// at the same time, so the stats of a frame become available some frames after it was rendered.
 class MultiplexRenderer {
     std::shared_ptr<RenderContext> ctx;
     std::vector<Renderer> renderers;
+    size_t frame;
+
+    // Stats of the frames that finished since the last call to collect_stats
+    std::vector<RenderStats> completed;
 
 public:
     using ShaderParameters = RenderContext::ShaderParameters;
 
-    MultiplexRenderer(Display* display, std::unique_ptr<RenderAlgorithm>&& algorithm, const ShaderParameters& shader_params);
+    MultiplexRenderer(
+        Display* display,
+        std::unique_ptr<RenderAlgorithm>&& algorithm,
+        const ShaderParameters& shader_params,
+        Vec2<uint32_t> workgroup_size,
+        const std::filesystem::path& pipeline_cache_dir
+    );
+    ~MultiplexRenderer();
+
+    MultiplexRenderer(const MultiplexRenderer&) = delete;
+    MultiplexRenderer& operator=(const MultiplexRenderer&) = delete;
+
     void recreate(size_t device, size_t output);
     void render(const Camera& cam);
-    RenderStats stats() const;
+    void upload_transfer_function(const TransferFunction& transfer_function);
+
+    // Wait until all frames finished rendering and have been presented.
+    void finish();
+
+    // Pass the stats of the frames that finished since the last call to `accum`.
+    void collect_stats(RenderStatsAccumulator& accum);
+
+private:
+    void finish_frame(size_t frame);
 };
 
 #endif
@@ -5,6 +5,7 @@
 #include <memory>
 #include <vulkan/vulkan.hpp>
 #include "backend/RenderDevice.h"
+#include "model/TransferFunction.h"
 #include "utility/Span.h"
 
 struct Binding {
@@ -15,6 +16,11 @@ struct Binding {
 struct RenderResources {
     virtual ~RenderResources() = default;
     virtual void update_descriptors(vk::DescriptorSet set) const = 0;
+
+    // Replace the transfer function used by the algorithm, if any. This happens in place,
+    // so that the pipeline and descriptor sets don't need to be recreated.
+    virtual void upload_transfer_function(const RenderDevice& rendev, const TransferFunction& transfer_function) {
+    }
 };
 
 struct RenderAlgorithm {
@@ -22,10 +22,18 @@ namespace {
     };
 }
 
-RenderContext::RenderContext(Display* display, std::unique_ptr<RenderAlgorithm>&& algorithm, const ShaderParameters& shader_params):
+RenderContext::RenderContext(
+    Display* display,
+    std::unique_ptr<RenderAlgorithm>&& algorithm,
+    const ShaderParameters& shader_params,
+    Vec2<uint32_t> workgroup_size,
+    const std::filesystem::path& pipeline_cache_dir
+):
     display(display),
     algorithm(std::move(algorithm)),
-    shader_params(shader_params) {
+    shader_params(shader_params),
+    workgroup_size(workgroup_size),
+    pipeline_cache(pipeline_cache_dir) {
     this->calculate_display_rect();
 
     std::copy(COMMON_BINDINGS.begin(), COMMON_BINDINGS.end(), std::back_inserter(this->bindings));
@@ -3,10 +3,13 @@
 
 #include <memory>
 #include <vector>
+#include <filesystem>
 #include <cstddef>
+#include <cstdint>
 #include <vulkan/vulkan.hpp>
 #include "backend/Display.h"
 #include "backend/Output.h"
+#include "graphics/core/PipelineCache.h"
 #include "render/RenderAlgorithm.h"
 #include "render/RenderStats.h"
 #include "camera/Camera.h"
@@ -17,15 +20,32 @@ struct RenderContext {
         Vec4F voxel_ratio;
         Vec4<unsigned> model_dim;
         float emission_coeff;
+        float absorption_coeff;
+        float termination_threshold;
+        uint32_t composite;
+        float lod_bias;
     };
 
     Display* display;
     std::unique_ptr<RenderAlgorithm> algorithm;
     ShaderParameters shader_params;
+
+    // The workgroup size of the shaders, which is specialized when the pipeline is created
+    Vec2<uint32_t> workgroup_size;
+
     vk::Rect2D display_region;
     std::vector<vk::DescriptorSetLayoutBinding> bindings;
 
-    RenderContext(Display* display, std::unique_ptr<RenderAlgorithm>&& algorithm, const ShaderParameters& shader_params);
+    // Shared by the renderers of all devices
+    PipelineCache pipeline_cache;
+
+    RenderContext(
+        Display* display,
+        std::unique_ptr<RenderAlgorithm>&& algorithm,
+        const ShaderParameters& shader_params,
+        Vec2<uint32_t> workgroup_size,
+        const std::filesystem::path& pipeline_cache_dir
+    );
     void calculate_display_rect();
 };
 
@@ -26,21 +26,24 @@ struct RenderStats {
     double mrays_per_s() const;
 };
 
+// Measures the render time of each output with timestamp queries. Each of the frames that may be in flight
+// at the same time has its own queries, so that the stats of a frame can be collected once it finished,
+// while the next frames are rendered.
 class RenderStatsCollector {
     const RenderDevice* rendev;
     vk::UniqueQueryPool query_pool;
     std::vector<uint64_t> timestamp_buffer;
-    RenderStats current_stats;
+
+    // The stats of a frame without the render times, which are the same for every frame
+    RenderStats frame_stats;
 
 public:
-    RenderStatsCollector(Display* display, size_t device_index);
-    void pre_dispatch(size_t output_index, vk::CommandBuffer cmd_buf);
-    void post_dispatch(size_t output_index, vk::CommandBuffer cmd_buf);
-    void collect();
+    RenderStatsCollector(Display* display, size_t device_index, size_t frames);
+    void pre_dispatch(size_t frame, size_t output_index, vk::CommandBuffer cmd_buf);
+    void post_dispatch(size_t frame, size_t output_index, vk::CommandBuffer cmd_buf);
 
-    const RenderStats& stats() const {
-        return this->current_stats;
-    }
+    // Read the queries of a frame, which must have finished rendering.
+    RenderStats collect(size_t frame);
 };
 
 class RenderStatsAccumulator {
@@ -52,6 +55,7 @@ public:
     void start();
     void stop();
 
+    // Add the stats of a frame, in the order in which frames were rendered
     void operator()(const RenderStats& stats) {
         this->all_stats.push_back(stats);
     }
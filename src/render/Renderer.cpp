@@ -3,38 +3,60 @@
 #include <algorithm>
 #include <iterator>
 #include <utility>
+#include <limits>
+#include <cassert>
 #include "utility/rect_union.h"
 #include "core/Logger.h"
+#include "core/Error.h"
 #include "graphics/shader/Shader.h"
 #include "graphics/utility.h"
 #include "math/Vec.h"
 
 namespace {
-    // The local group size all RenderAlgorithm shaders should have
-    constexpr const Vec2<uint32_t> LOCAL_SIZE{8, 8};
+    // The values of the specialization constants of the shaders, see common.glsl. Each
+    // member is a constant of 4 bytes, of which the id is its index.
+    struct SpecializationData {
+        uint32_t workgroup_size_x;
+        uint32_t workgroup_size_y;
+        float voxel_ratio_x;
+        float voxel_ratio_y;
+        float voxel_ratio_z;
+        uint32_t model_dim_x;
+        uint32_t model_dim_y;
+        uint32_t model_dim_z;
+        float emission_coeff;
+    };
+
+    constexpr const uint32_t SPECIALIZATION_CONSTANTS = sizeof(SpecializationData) / 4;
+    static_assert(sizeof(SpecializationData) == SPECIALIZATION_CONSTANTS * 4);
 }
 
 Renderer::Renderer(std::shared_ptr<RenderContext> ctx, size_t device_index):
     ctx(ctx),
     device_index(device_index),
     rendev(&this->ctx->display->render_device(this->device_index)),
-    stats_collector(this->ctx->display, this->device_index) {
+    stats_collector(this->ctx->display, this->device_index, MAX_FRAMES_IN_FLIGHT) {
 
     this->create_resources();
     this->create_pipeline();
     this->create_descriptor_sets();
     this->create_command_buffers();
+    this->create_frame_resources();
 
     this->update_descriptor_sets();
     this->upload_uniform_buffers();
+    this->record_command_buffers();
 }
 
 void Renderer::recreate(size_t output) {
+    // Descriptor sets cannot be updated while frames in flight use them
+    this->rendev->device->waitIdle();
+
     auto& orsc = this->output_resources[output];
     orsc.region = orsc.output->region();
 
     const uint32_t images = this->ctx->display->output(this->device_index, output)->num_swap_images();
-    if (static_cast<size_t>(images) != this->output_resources[output].command_buffers.size()) {
+    if (images * MAX_FRAMES_IN_FLIGHT != this->output_resources[output].descriptor_sets.size()) {
         this->create_descriptor_sets();
         this->create_command_buffers();
     }
@@ -45,69 +67,60 @@ void Renderer::recreate(size_t output) {
     }
 
     this->update_descriptor_sets();
+    this->record_command_buffers();
     this->resize();
 }
 
 void Renderer::resize() {
+    // The uniform buffers are overwritten in place, so wait until no frame uses them anymore
+    this->rendev->device->waitIdle();
     this->upload_uniform_buffers();
 }
 
-void Renderer::render(const Camera& cam) {
-    const auto begin_info = vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eSimultaneousUse);
+std::optional<RenderStats> Renderer::finish_frame(size_t frame) {
+    auto& frsc = this->frame_resources[frame];
+    if (!frsc.in_flight) {
+        return std::nullopt;
+    }
+
+    this->rendev->device->waitForFences(frsc.fence.get(), true, std::numeric_limits<uint64_t>::max());
+    this->rendev->device->resetFences(frsc.fence.get());
+    frsc.in_flight = false;
+
+    return this->stats_collector.collect(frame);
+}
 
-    const auto push_constants = PushConstantBuffer {
-        .camera = {
-            Vec4F(cam.forward, 0),
-            Vec4F(cam.up, 0),
-            Vec4F(cam.translation / this->ctx->shader_params.voxel_ratio.xyz, 0) // pre-divide
-        },
+void Renderer::render(const Camera& cam, size_t frame) {
+    const auto camera = decltype(UniformBuffer::camera) {
+        Vec4F(cam.forward, 0),
+        Vec4F(cam.up, 0),
+        Vec4F(cam.translation / this->ctx->shader_params.voxel_ratio.xyz, 0) // pre-divide
     };
 
     for (size_t outputidx = 0; outputidx < this->output_resources.size(); ++outputidx) {
         auto& orsc = this->output_resources[outputidx];
 
+        // The uniform buffers of this frame are not in use anymore, see finish_frame
+        this->uniforms[this->uniform_index(frame, outputidx)].camera = camera;
+
         uint32_t index = orsc.output->current_swap_index();
         const auto swap_image = orsc.output->swap_image(index);
-        const auto attachment = orsc.output->color_attachment_descr();
-        auto& cmd_buf = orsc.command_buffers[index].get();
-
-        auto group_size = (Vec2<uint32_t>{orsc.region.extent.width, orsc.region.extent.height} - 1u) / LOCAL_SIZE + 1u;
-
-        cmd_buf.begin(&begin_info);
-
-        image_transition(
-            cmd_buf,
-            swap_image.image,
-            {attachment.initialLayout, vk::PipelineStageFlagBits::eTopOfPipe},
-            {vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits::eComputeShader}
-        );
-
-        cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute, this->pipeline.get());
-        cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->pipeline_layout.get(), 0, orsc.descriptor_sets[index], nullptr);
-        cmd_buf.pushConstants(this->pipeline_layout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstantBuffer), static_cast<const void*>(&push_constants));
-        this->stats_collector.pre_dispatch(outputidx, cmd_buf);
-        cmd_buf.dispatch(group_size.x, group_size.y, 1);
-        this->stats_collector.post_dispatch(outputidx, cmd_buf);
-
-        image_transition(
-            cmd_buf,
-            swap_image.image,
-            {vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits::eComputeShader},
-            {attachment.finalLayout, vk::PipelineStageFlagBits::eBottomOfPipe}
-        );
-
-        cmd_buf.end();
+        auto& cmd_buf = orsc.command_buffers[this->image_index(frame, outputidx, index)].get();
 
-        swap_image.submit(this->rendev->compute_queue, cmd_buf, vk::PipelineStageFlagBits::eBottomOfPipe);
+        // The fence is signaled after all earlier submissions to the queue completed as well,
+        // so only the last output signals it.
+        const bool last = outputidx == this->output_resources.size() - 1;
+        const auto fence = last ? this->frame_resources[frame].fence.get() : vk::Fence();
+        swap_image.submit(this->rendev->compute_queue, cmd_buf, fence, vk::PipelineStageFlagBits::eBottomOfPipe);
     }
-}
 
-void Renderer::collect_stats() {
-    this->stats_collector.collect();
+    this->frame_resources[frame].in_flight = true;
 }
 
-RenderStats Renderer::stats() const {
-    return this->stats_collector.stats();
+void Renderer::upload_transfer_function(const TransferFunction& transfer_function) {
+    // The transfer function is overwritten in place, so wait until no frame uses it anymore
+    this->rendev->device->waitIdle();
+    this->resources->upload_transfer_function(*this->rendev, transfer_function);
 }
 
 void Renderer::create_resources() {
@@ -118,11 +131,13 @@ void Renderer::create_resources() {
 
     this->uniform_buffer = std::make_unique<Buffer<UniformBuffer>>(
         device,
-        outputs,
-        vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eDeviceLocal
+        MAX_FRAMES_IN_FLIGHT * outputs,
+        vk::BufferUsageFlagBits::eUniformBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
     );
 
+    this->uniforms = this->uniform_buffer->map(0, MAX_FRAMES_IN_FLIGHT * outputs);
+
     this->output_resources.reserve(outputs);
     for (size_t j = 0; j < outputs; ++j) {
         Output* output = this->ctx->display->output(this->device_index, j);
@@ -144,25 +159,60 @@ void Renderer::create_pipeline() {
         this->ctx->bindings.data()
     });
 
-    const auto shader = Shader(device, vk::ShaderStageFlagBits::eCompute, this->ctx->algorithm->shader());
+    const auto workgroup_size = this->ctx->workgroup_size;
+    const auto& limits = this->rendev->device.physical_device().getProperties().limits;
+
+    if (workgroup_size.x > limits.maxComputeWorkGroupSize[0] ||
+        workgroup_size.y > limits.maxComputeWorkGroupSize[1] ||
+        workgroup_size.x * workgroup_size.y > limits.maxComputeWorkGroupInvocations) {
+        throw Error(
+            "Workgroup size {}x{} exceeds the limits of render device {}",
+            workgroup_size.x,
+            workgroup_size.y,
+            this->device_index
+        );
+    }
 
-    const auto push_constant_range = vk::PushConstantRange(
-        vk::ShaderStageFlagBits::eCompute,
-        0,
-        sizeof(PushConstantBuffer)
+    const auto& params = this->ctx->shader_params;
+    const auto specialization_data = SpecializationData {
+        .workgroup_size_x = workgroup_size.x,
+        .workgroup_size_y = workgroup_size.y,
+        .voxel_ratio_x = params.voxel_ratio.x,
+        .voxel_ratio_y = params.voxel_ratio.y,
+        .voxel_ratio_z = params.voxel_ratio.z,
+        .model_dim_x = params.model_dim.x,
+        .model_dim_y = params.model_dim.y,
+        .model_dim_z = params.model_dim.z,
+        .emission_coeff = params.emission_coeff
+    };
+
+    auto map_entries = std::array<vk::SpecializationMapEntry, SPECIALIZATION_CONSTANTS>();
+    for (uint32_t i = 0; i < SPECIALIZATION_CONSTANTS; ++i) {
+        map_entries[i] = vk::SpecializationMapEntry(i, i * 4, 4);
+    }
+
+    const auto specialization_info = vk::SpecializationInfo(
+        SPECIALIZATION_CONSTANTS,
+        map_entries.data(),
+        sizeof(SpecializationData),
+        &specialization_data
     );
 
+    const auto shader = Shader(device, vk::ShaderStageFlagBits::eCompute, this->ctx->algorithm->shader());
+    auto stage_info = shader.info();
+    stage_info.pSpecializationInfo = &specialization_info;
+
     this->pipeline_layout = device->createPipelineLayoutUnique({
         {},
         1,
         &this->descriptor_set_layout.get(),
-        1,
-        &push_constant_range
+        0,
+        nullptr
     });
 
-    this->pipeline = device->createComputePipelineUnique(vk::PipelineCache(), {
+    this->pipeline = this->ctx->pipeline_cache.create_compute_pipeline(device, this->ctx->algorithm->shader(), {
         {},
-        shader.info(),
+        stage_info,
         this->pipeline_layout.get()
     });
 }
@@ -172,7 +222,9 @@ void Renderer::create_descriptor_sets() {
 
     uint32_t total_images = 0;
     for (const auto& orsc : this->output_resources) {
-        total_images += orsc.output->num_swap_images();
+        // Swapchains reuse the semaphores of an image without waiting, see Swapchain::swap_buffers
+        assert(orsc.output->num_swap_images() >= MAX_FRAMES_IN_FLIGHT);
+        total_images += orsc.output->num_swap_images() * static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
     }
 
     this->descriptor_pool = create_descriptor_pool(device, total_images);
@@ -189,7 +241,7 @@ void Renderer::create_descriptor_sets() {
     size_t descriptor_set_base = 0;
     for (size_t outputidx = 0; outputidx < this->output_resources.size(); ++outputidx) {
         auto& orsc = this->output_resources[outputidx];
-        const uint32_t images = orsc.output->num_swap_images();
+        const size_t images = orsc.output->num_swap_images() * MAX_FRAMES_IN_FLIGHT;
 
         orsc.descriptor_sets = Span(images, &this->descriptor_sets[descriptor_set_base]);
         descriptor_set_base += images;
@@ -197,74 +249,116 @@ void Renderer::create_descriptor_sets() {
 }
 
 void Renderer::create_command_buffers() {
-    for (size_t outputidx = 0; outputidx < this->output_resources.size(); ++outputidx) {
-        auto& orsc = this->output_resources[outputidx];
-        const uint32_t images = orsc.output->num_swap_images();
-
+    for (auto& orsc : this->output_resources) {
+        const size_t images = orsc.output->num_swap_images() * MAX_FRAMES_IN_FLIGHT;
         orsc.command_buffers = this->rendev->compute_command_pool.allocate_command_buffers(images);
     }
 }
 
+void Renderer::create_frame_resources() {
+    this->frame_resources.reserve(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        this->frame_resources.push_back({
+            this->rendev->device->createFenceUnique({}),
+            false
+        });
+    }
+}
+
 void Renderer::update_descriptor_sets() {
     for (size_t outputidx = 0; outputidx < this->output_resources.size(); ++outputidx) {
         auto& orsc = this->output_resources[outputidx];
-        const auto uniform_buffer_info = this->uniform_buffer->descriptor_info(outputidx, 1);
         const uint32_t images = orsc.output->num_swap_images();
 
-        for (uint32_t image = 0; image < images; ++image) {
-            auto swap_image = orsc.output->swap_image(image);
-            auto& set = orsc.descriptor_sets[image];
+        for (size_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame) {
+            const auto uniform_buffer_info = this->uniform_buffer->descriptor_info(this->uniform_index(frame, outputidx), 1);
 
-            const auto render_target_info = vk::DescriptorImageInfo(
-                vk::Sampler(),
-                swap_image.view,
-                vk::ImageLayout::eGeneral
-            );
+            for (uint32_t image = 0; image < images; ++image) {
+                auto swap_image = orsc.output->swap_image(image);
+                auto& set = orsc.descriptor_sets[this->image_index(frame, outputidx, image)];
 
-            const auto descriptor_writes = std::array{
-                write_set(set, this->ctx->bindings[0], uniform_buffer_info),
-                write_set(set, this->ctx->bindings[1], render_target_info)
-            };
+                const auto render_target_info = vk::DescriptorImageInfo(
+                    vk::Sampler(),
+                    swap_image.view,
+                    vk::ImageLayout::eGeneral
+                );
 
-            this->rendev->device->updateDescriptorSets(descriptor_writes, nullptr);
+                const auto descriptor_writes = std::array{
+                    write_set(set, this->ctx->bindings[0], uniform_buffer_info),
+                    write_set(set, this->ctx->bindings[1], render_target_info)
+                };
 
-            this->resources->update_descriptors(set);
+                this->rendev->device->updateDescriptorSets(descriptor_writes, nullptr);
+
+                this->resources->update_descriptors(set);
+            }
         }
     }
 }
 
-void Renderer::upload_uniform_buffers() {
-    const auto& device = this->rendev->device;
-    const uint32_t outputs = static_cast<uint32_t>(this->rendev->outputs);
-
-    auto staging_buffer = Buffer<UniformBuffer>(
-        device,
-        outputs,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-    );
-
-    UniformBuffer* uniforms = staging_buffer.map(0, outputs);
+void Renderer::record_command_buffers() {
+    const auto begin_info = vk::CommandBufferBeginInfo();
 
     for (size_t outputidx = 0; outputidx < this->output_resources.size(); ++outputidx) {
         auto& orsc = this->output_resources[outputidx];
+        const uint32_t images = orsc.output->num_swap_images();
+        const auto attachment = orsc.output->color_attachment_descr();
 
-        uniforms[outputidx].output_region = orsc.region;
-        uniforms[outputidx].display_region = this->ctx->display_region;
-        uniforms[outputidx].params = this->ctx->shader_params;
+        auto group_size = (Vec2<uint32_t>{orsc.region.extent.width, orsc.region.extent.height} - 1u) / this->ctx->workgroup_size + 1u;
+
+        for (size_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame) {
+            for (uint32_t image = 0; image < images; ++image) {
+                const auto swap_image = orsc.output->swap_image(image);
+                const size_t index = this->image_index(frame, outputidx, image);
+                auto& cmd_buf = orsc.command_buffers[index].get();
+
+                cmd_buf.begin(&begin_info);
+
+                image_transition(
+                    cmd_buf,
+                    swap_image.image,
+                    {attachment.initialLayout, vk::PipelineStageFlagBits::eTopOfPipe},
+                    {vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits::eComputeShader}
+                );
+
+                cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute, this->pipeline.get());
+                cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->pipeline_layout.get(), 0, orsc.descriptor_sets[index], nullptr);
+                this->stats_collector.pre_dispatch(frame, outputidx, cmd_buf);
+                cmd_buf.dispatch(group_size.x, group_size.y, 1);
+                this->stats_collector.post_dispatch(frame, outputidx, cmd_buf);
+
+                image_transition(
+                    cmd_buf,
+                    swap_image.image,
+                    {vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits::eComputeShader},
+                    {attachment.finalLayout, vk::PipelineStageFlagBits::eBottomOfPipe}
+                );
+
+                cmd_buf.end();
+            }
+        }
     }
+}
 
-    staging_buffer.unmap();
+void Renderer::upload_uniform_buffers() {
+    for (size_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame) {
+        for (size_t outputidx = 0; outputidx < this->output_resources.size(); ++outputidx) {
+            auto& orsc = this->output_resources[outputidx];
+            auto& uniforms = this->uniforms[this->uniform_index(frame, outputidx)];
+
+            uniforms.output_region = orsc.region;
+            uniforms.display_region = this->ctx->display_region;
+            uniforms.params = this->ctx->shader_params;
+        }
+    }
+}
 
-    const auto copy_info = vk::BufferCopy{
-        0,
-        0,
-        sizeof(UniformBuffer) * outputs
-    };
+size_t Renderer::uniform_index(size_t frame, size_t output) const {
+    return frame * this->output_resources.size() + output;
+}
 
-    this->rendev->compute_command_pool.one_time_submit([&](vk::CommandBuffer cmd_buf) {
-        cmd_buf.copyBuffer(staging_buffer.get(), this->uniform_buffer->get(), copy_info);
-    });
+size_t Renderer::image_index(size_t frame, size_t output, uint32_t image) const {
+    return frame * this->output_resources[output].output->num_swap_images() + image;
 }
 
 vk::UniqueDescriptorPool Renderer::create_descriptor_pool(const Device& device, uint32_t sets) {
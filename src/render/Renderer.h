@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <memory>
+#include <optional>
 #include <cstddef>
 #include <vulkan/vulkan.hpp>
 #include "backend/Display.h"
@@ -13,18 +14,16 @@
 #include "render/RenderStats.h"
 #include "render/RenderContext.h"
 #include "camera/Camera.h"
+#include "model/TransferFunction.h"
 #include "math/Vec.h"
 
 class Renderer {
     using ShaderParameters = RenderContext::ShaderParameters;
 
-    struct UniformBuffer {
-        vk::Rect2D output_region;
-        vk::Rect2D display_region;
-        ShaderParameters params;
-    };
-
-    struct PushConstantBuffer {
+    // Each combination of frame in flight and output has its own uniform buffer, which are laid out after
+    // each other in one Vulkan buffer. Their offsets must be a multiple of minUniformBufferOffsetAlignment,
+    // which is at most 256 bytes.
+    struct alignas(256) UniformBuffer {
         // the Camera struct cant be used here directly because of
         // different alignment requirements of CPU and GPU.
         struct {
@@ -32,19 +31,29 @@ class Renderer {
             Vec4F up;
             Vec4F translation_scaled;
         } camera;
-    };
 
-    static_assert(sizeof(PushConstantBuffer) <= 128, "Vulkan minimum supported push constant range is maximum 128 bytes");
+        vk::Rect2D output_region;
+        vk::Rect2D display_region;
+        ShaderParameters params;
+    };
 
     struct OutputResources {
         Output* output;
 
         vk::Rect2D region;
 
+        // One for each combination of frame in flight and swap image, see Renderer::image_index.
+        // The command buffers are recorded once, and only recorded again when the output is recreated.
         Span<vk::DescriptorSet> descriptor_sets;
         std::vector<vk::UniqueCommandBuffer> command_buffers;
     };
 
+    struct FrameResources {
+        // Signaled once all outputs finished rendering the frame
+        vk::UniqueFence fence;
+        bool in_flight;
+    };
+
     std::shared_ptr<RenderContext> ctx;
     size_t device_index;
 
@@ -59,25 +68,42 @@ class Renderer {
     vk::UniquePipelineLayout pipeline_layout;
     vk::UniquePipeline pipeline;
 
+    // Persistently mapped, the camera is written to it every frame, see uniform_index
     std::unique_ptr<Buffer<UniformBuffer>> uniform_buffer;
+    UniformBuffer* uniforms;
 
     std::vector<OutputResources> output_resources;
+    std::vector<FrameResources> frame_resources;
 
 public:
+    // The number of frames which may be rendered at the same time. While the GPU renders a frame,
+    // the CPU records the commands of the next.
+    constexpr static const size_t MAX_FRAMES_IN_FLIGHT = 2;
+
     Renderer(std::shared_ptr<RenderContext> ctx, size_t device_index);
     void recreate(size_t output);
     void resize();
-    void render(const Camera& cam);
-    void collect_stats();
-    RenderStats stats() const;
+
+    // Wait until the previous frame rendered in `frame` (one of MAX_FRAMES_IN_FLIGHT) finished, so that
+    // its resources can be reused, and return its stats. Returns nothing if no frame was rendered in it yet.
+    std::optional<RenderStats> finish_frame(size_t frame);
+
+    // Render a frame in `frame`, which must be finished first.
+    void render(const Camera& cam, size_t frame);
+
+    void upload_transfer_function(const TransferFunction& transfer_function);
 
 private:
     void create_resources();
     void create_pipeline();
     void create_descriptor_sets();
     void create_command_buffers();
+    void create_frame_resources();
     void update_descriptor_sets();
+    void record_command_buffers();
     void upload_uniform_buffers();
+    size_t uniform_index(size_t frame, size_t output) const;
+    size_t image_index(size_t frame, size_t output, uint32_t image) const;
     vk::UniqueDescriptorPool create_descriptor_pool(const Device& device, uint32_t sets);
 };
 
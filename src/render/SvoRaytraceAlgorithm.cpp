@@ -1,4 +1,5 @@
 #include "render/SvoRaytraceAlgorithm.h"
+#include <cstring>
 
 namespace {
     const auto SVO_BINDINGS = std::array {
@@ -32,12 +33,9 @@ SvoRaytraceResources::SvoRaytraceResources(const RenderDevice& rendev, const Oct
         vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
     );
 
+    // If the octree is memory mapped, this reads the nodes straight from the file mapping
     Octree::Node* staging_nodes = staging_buffer.map(0, nodes.size());
-
-    for (size_t i = 0; i < nodes.size(); ++i) {
-        staging_nodes[i] = nodes[i];
-    }
-
+    std::memcpy(staging_nodes, nodes.data(), nodes.size() * sizeof(Octree::Node));
     staging_buffer.unmap();
 
     rendev.compute_command_pool.one_time_submit([&](vk::CommandBuffer cmd_buf) {
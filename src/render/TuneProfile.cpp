@@ -0,0 +1,106 @@
+#include "render/TuneProfile.h"
+#include <fstream>
+#include <algorithm>
+#include <fmt/format.h>
+#include "core/Error.h"
+
+namespace {
+    // Quote a string in the format which Parse<std::string> reads
+    std::string quote(std::string_view str) {
+        auto quoted = std::string("\"");
+        for (char c : str) {
+            if (c == '"' || c == '\\') {
+                quoted += '\\';
+            }
+
+            quoted += c;
+        }
+
+        quoted += '"';
+        return quoted;
+    }
+}
+
+TuneProfile TuneProfile::load(const std::filesystem::path& path) {
+    auto in = std::ifstream(path);
+    if (!in) {
+        throw Error("Failed to open profile '{}'", path.native());
+    }
+
+    try {
+        return cfg::Config(in).as<TuneProfile>();
+    } catch (const Error& err) {
+        throw Error("Failed to read profile '{}': {}", path.native(), err.what());
+    }
+}
+
+void TuneProfile::save(const std::filesystem::path& path) const {
+    auto out = std::ofstream(path);
+    if (!out) {
+        throw Error("Failed to open profile '{}'", path.native());
+    }
+
+    out << "# Written by 'xenodon tune', see 'xenodon help tune'\n";
+
+    for (const auto& device : this->devices) {
+        out << fmt::format(
+            "\ndevice {{\n    name = {}\n    shader = {}\n    workgroup = ({}, {})\n}}\n",
+            quote(device.name),
+            quote(device.shader),
+            device.workgroup_size.width,
+            device.workgroup_size.height
+        );
+    }
+
+    if (!out) {
+        throw Error("Failed to write profile '{}'", path.native());
+    }
+}
+
+const TuneProfile::Device* TuneProfile::find(std::string_view device_name) const {
+    auto it = std::find_if(this->devices.begin(), this->devices.end(), [device_name](const Device& device) {
+        return device.name == device_name;
+    });
+
+    return it == this->devices.end() ? nullptr : &*it;
+}
+
+void TuneProfile::update(const Device& device) {
+    auto it = std::find_if(this->devices.begin(), this->devices.end(), [&device](const Device& existing) {
+        return existing.name == device.name;
+    });
+
+    if (it == this->devices.end()) {
+        this->devices.push_back(device);
+    } else {
+        *it = device;
+    }
+}
+
+std::filesystem::path default_tune_profile_path(const std::filesystem::path& volume_path) {
+    auto path = volume_path;
+    path += ".profile";
+    return path;
+}
+
+TuneProfile::Device cfg::FromConfig<TuneProfile::Device>::operator()(cfg::Config& cfg) const {
+    auto [name, shader, workgroup_size] = cfg.get(
+        Value<std::string>("name"),
+        Value<std::string>("shader"),
+        Value<vk::Extent2D>("workgroup")
+    );
+
+    if (workgroup_size.width == 0 || workgroup_size.height == 0) {
+        throw cfg::ConfigError("Workgroup size must not be zero");
+    }
+
+    return {name, shader, workgroup_size};
+}
+
+TuneProfile cfg::FromConfig<TuneProfile>::operator()(cfg::Config& cfg) const {
+    auto [devices] = cfg.get(
+        Vector<TuneProfile::Device>("device")
+    );
+
+    return {devices};
+}
@@ -0,0 +1,45 @@
+#ifndef _XENODON_RENDER_TUNEPROFILE_H
+#define _XENODON_RENDER_TUNEPROFILE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <filesystem>
+#include <vulkan/vulkan.hpp>
+#include "core/Config.h"
+
+// The shader and workgroup size with which a volume renders fastest, per kind of GPU, as
+// measured by 'xenodon tune'. See 'xenodon help tune' for the format.
+struct TuneProfile {
+    struct Device {
+        // As reported by Vulkan, see PhysicalDevice::name
+        std::string name;
+        std::string shader;
+        vk::Extent2D workgroup_size;
+    };
+
+    std::vector<Device> devices;
+
+    static TuneProfile load(const std::filesystem::path& path);
+    void save(const std::filesystem::path& path) const;
+
+    const Device* find(std::string_view device_name) const;
+
+    // Add or replace the entry of a device.
+    void update(const Device& device);
+};
+
+// The path of the profile of a volume that is used by default.
+std::filesystem::path default_tune_profile_path(const std::filesystem::path& volume_path);
+
+template<>
+struct cfg::FromConfig<TuneProfile::Device> {
+    TuneProfile::Device operator()(cfg::Config& cfg) const;
+};
+
+template<>
+struct cfg::FromConfig<TuneProfile> {
+    TuneProfile operator()(cfg::Config& cfg) const;
+};
+
+#endif
@@ -0,0 +1,495 @@
+#include "render/cpu/CpuDdaAlgorithm.h"
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include <cmath>
+#include "core/Logger.h"
+#include "core/Error.h"
+#include "render/cpu/simd.h"
+
+namespace {
+    constexpr const int OCCUPANCY_BLOCK_SIDE = static_cast<int>(OccupancyGrid::BLOCK_SIDE);
+
+    // A packet is traced together until fewer than 1 / PACKET_MIN_ACTIVE_FRACTION of its rays are left.
+    constexpr const size_t PACKET_MIN_ACTIVE_FRACTION = 4;
+
+    // See side_distance in dda.glsl
+    Vec3F side_distance(const Vec3I& p, const Vec3F& ro, const Vec3F& far_side, const Vec3F& t_delta) {
+        Vec3F dist;
+        for (size_t i = 0; i < 3; ++i) {
+            dist[i] = std::abs(static_cast<float>(p[i]) + far_side[i] - ro[i]) * t_delta[i];
+        }
+
+        return dist;
+    }
+
+    // See leap in dda.glsl
+    Vec3I leap(const Vec3I& pos, const Vec3I& step, const Vec3F& ro, const Vec3F& rd, const Vec3F& far_side, const Vec3F& t_delta, float t_exit) {
+        Vec3I q;
+        for (size_t i = 0; i < 3; ++i) {
+            q[i] = static_cast<int>(std::floor(ro[i] + rd[i] * t_exit));
+            q[i] = pos[i] + step[i] * std::max((q[i] - pos[i]) * step[i], 0);
+        }
+
+        for (int pass = 0; pass < 2; ++pass) {
+            const Vec3F dist = side_distance(q, ro, far_side, t_delta);
+            for (size_t i = 0; i < 3; ++i) {
+                if (dist[i] <= t_exit) {
+                    q[i] += step[i];
+                }
+            }
+        }
+
+        for (int pass = 0; pass < 2; ++pass) {
+            const Vec3F dist = side_distance(q - step, ro, far_side, t_delta);
+            for (size_t i = 0; i < 3; ++i) {
+                if (dist[i] > t_exit && (q[i] - pos[i]) * step[i] > 0) {
+                    q[i] -= step[i];
+                }
+            }
+        }
+
+        return q;
+    }
+}
+
+CpuDdaAlgorithm::CpuDdaAlgorithm(std::shared_ptr<Grid> grid, TransferFunction transfer_function, bool empty_space_skipping):
+    grid(grid),
+    transfer_function(std::move(transfer_function)) {
+
+    if (this->grid->layout() != Grid::Layout::Linear) {
+        throw Error("The dda algorithm requires a grid of the linear layout");
+    }
+
+    if (!empty_space_skipping) {
+        return;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    this->occupancy_grid = std::make_shared<OccupancyGrid>(*this->grid);
+    this->occupancy = this->occupancy_grid->occupancy(this->transfer_function);
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    const auto blocks = this->occupancy_grid->blocks();
+    LOGGER.log(
+        "Built occupancy grid of {}x{}x{} blocks in {:.3f}s",
+        blocks.x,
+        blocks.y,
+        blocks.z,
+        std::chrono::duration<double>(stop - start).count()
+    );
+}
+
+Vec3F CpuDdaAlgorithm::render_pixel(const TraceContext& ctx, Vec3F ro, Vec3F rd) const {
+    const auto dim = this->grid->dimensions();
+    const auto side = static_cast<float>(std::max(dim.x, std::max(dim.y, dim.z)));
+
+    const float ec = ctx.voxel_emission_coeff(rd) / side;
+    const float ac = ctx.voxel_absorption_coeff(rd) / side;
+    return this->trace(ctx, ro * side, rd, ac) * ec;
+}
+
+void CpuDdaAlgorithm::render_packet(const TraceContext& ctx, const RayPacket& packet, RayPacket::Colors& colors) const {
+    switch (packet.size) {
+        case 8:
+            this->trace_packet_avx2(ctx, packet, colors);
+            break;
+        case 16:
+            this->trace_packet_avx512(ctx, packet, colors);
+            break;
+        default:
+            CpuRenderAlgorithm::render_packet(ctx, packet, colors);
+    }
+}
+
+void CpuDdaAlgorithm::upload_transfer_function(const TransferFunction& transfer_function) {
+    if (this->grid->format() == VoxelFormat::Rgba8) {
+        return;
+    }
+
+    this->transfer_function = transfer_function;
+
+    // Which blocks are empty depends on the colors of the transfer function
+    if (this->occupancy_grid) {
+        this->occupancy = this->occupancy_grid->occupancy(this->transfer_function);
+    }
+}
+
+Vec3F CpuDdaAlgorithm::trace(const TraceContext& ctx, Vec3F ro, const Vec3F& rd, float absorption) const {
+    const auto dim = static_cast<Vec3I>(this->grid->dimensions());
+
+    const Vec3F rrd = 1.f / rd;
+    const Vec3F bias = rrd * ro;
+
+    const Vec3F box_min = -bias;
+    const Vec3F box_max = static_cast<Vec3F>(dim) * rrd - bias;
+
+    float t_min = max_elem(min(box_min, box_max));
+    const float t_max = min_elem(max(box_min, box_max));
+
+    if (t_min > t_max) {
+        // Ray misses bounding cube
+        return Vec3F(0);
+    }
+
+    t_min = std::max(t_min, 0.f);
+
+    ro += rd * t_min;
+
+    auto ray = DdaRay{ro, rd, static_cast<Vec3I>(ro), 0, t_max - t_min, Vec3F(0), 1};
+    this->march(ctx, ray, absorption);
+    return ray.total;
+}
+
+void CpuDdaAlgorithm::march(const TraceContext& ctx, DdaRay& ray, float absorption) const {
+    const auto dim = static_cast<Vec3I>(this->grid->dimensions());
+    const Vec3F& ro = ray.ro;
+    const Vec3F& rd = ray.rd;
+
+    Vec3F t_delta;
+    Vec3I step;
+    Vec3F far_side;
+    Vec3I far_voxel;
+
+    for (size_t i = 0; i < 3; ++i) {
+        t_delta[i] = std::abs(1.f / rd[i]);
+        step[i] = rd[i] > 0 ? 1 : rd[i] < 0 ? -1 : 0;
+        far_side[i] = rd[i] >= 0 ? 1.f : 0.f;
+        far_voxel[i] = rd[i] >= 0 ? OCCUPANCY_BLOCK_SIDE - 1 : 0;
+    }
+
+    const uint8_t occupied_mask = ctx.params.composite != 0 ?
+        OccupancyGrid::EMISSIVE | OccupancyGrid::ABSORBENT :
+        OccupancyGrid::EMISSIVE;
+
+    const auto blocks = this->occupancy_grid ? static_cast<Vec3I>(this->occupancy_grid->blocks()) : Vec3I(0);
+
+    auto& pos = ray.pos;
+    auto& t = ray.t;
+
+    while (t < ray.t_end) {
+        const bool inside = pos.x >= 0 && pos.y >= 0 && pos.z >= 0 && pos.x < dim.x && pos.y < dim.y && pos.z < dim.z;
+
+        if (inside && !this->occupancy.empty()) {
+            const Vec3I block = pos / OCCUPANCY_BLOCK_SIDE;
+            const auto block_index = static_cast<size_t>(block.x + (block.y + block.z * blocks.y) * blocks.x);
+
+            if ((this->occupancy[block_index] & occupied_mask) == 0) {
+                // The voxels of the block on its far side, which is limited to the model
+                Vec3I last;
+                for (size_t i = 0; i < 3; ++i) {
+                    last[i] = std::min(block[i] * OCCUPANCY_BLOCK_SIDE + far_voxel[i], dim[i] - 1);
+                }
+
+                const float t_exit = min_elem(side_distance(last, ro, far_side, t_delta));
+
+                pos = leap(pos, step, ro, rd, far_side, t_delta, t_exit);
+                t = t_exit;
+                continue;
+            }
+        }
+
+        const Vec3F side_dist = side_distance(pos, ro, far_side, t_delta);
+        const float t0 = min_elem(side_dist);
+        const bool saturated = ctx.accumulate(ray.total, ray.transmittance, this->voxel(pos), t0 - t, absorption);
+        t = t0;
+
+        if (saturated) {
+            break;
+        }
+
+        pos += Vec3I(
+            side_dist.x <= std::min(side_dist.y, side_dist.z) ? step.x : 0,
+            side_dist.y <= std::min(side_dist.z, side_dist.x) ? step.y : 0,
+            side_dist.z <= std::min(side_dist.x, side_dist.y) ? step.z : 0
+        );
+    }
+}
+
+template <size_t N>
+void CpuDdaAlgorithm::trace_packet(const TraceContext& ctx, const RayPacket& packet, RayPacket::Colors& colors) const {
+    using F = simd::Float<N>;
+    using I = simd::Int<N>;
+
+    const auto udim = this->grid->dimensions();
+    const auto dim = static_cast<Vec3I>(udim);
+    const auto side = static_cast<float>(std::max(udim.x, std::max(udim.y, udim.z)));
+
+    // See render_pixel
+    const Vec3F packet_ro = packet.ro * side;
+    F emission;
+    F absorption;
+
+    for (size_t i = 0; i < N; ++i) {
+        emission[i] = ctx.voxel_emission_coeff(packet.rd[i]) / side;
+        absorption[i] = ctx.voxel_absorption_coeff(packet.rd[i]) / side;
+    }
+
+    const auto zero = F{};
+    const auto one = simd::broadcast<F>(1.f);
+
+    // See trace
+    std::array<F, 3> rd;
+    std::array<F, 3> box_min;
+    std::array<F, 3> box_max;
+
+    for (size_t i = 0; i < 3; ++i) {
+        rd[i] = simd::load_component<F>(packet.rd, i);
+
+        const F rrd = 1.f / rd[i];
+        const F bias = rrd * packet_ro[i];
+
+        box_min[i] = -bias;
+        box_max[i] = static_cast<float>(dim[i]) * rrd - bias;
+    }
+
+    F t_min = simd::max_elem<F>({
+        simd::min(box_min[0], box_max[0]),
+        simd::min(box_min[1], box_max[1]),
+        simd::min(box_min[2], box_max[2])
+    });
+
+    const F t_max = simd::min_elem<F>({
+        simd::max(box_min[0], box_max[0]),
+        simd::max(box_min[1], box_max[1]),
+        simd::max(box_min[2], box_max[2])
+    });
+
+    // Rays that miss the bounding cube are inactive from the start
+    I active = ~(t_min > t_max);
+    t_min = simd::max(t_min, zero);
+
+    std::array<F, 3> ro;
+    std::array<I, 3> pos;
+    std::array<F, 3> t_delta;
+    std::array<I, 3> step;
+    std::array<F, 3> far_side;
+    std::array<I, 3> far_voxel;
+
+    for (size_t i = 0; i < 3; ++i) {
+        ro[i] = packet_ro[i] + rd[i] * t_min;
+        pos[i] = simd::truncate(ro[i]);
+
+        t_delta[i] = simd::abs(1.f / rd[i]);
+        step[i] = (rd[i] < zero) - (rd[i] > zero);
+        far_side[i] = simd::select<F>(rd[i] >= zero, one, zero);
+        far_voxel[i] = (rd[i] >= zero) & (OCCUPANCY_BLOCK_SIDE - 1);
+    }
+
+    const auto side_distance = [&](const std::array<I, 3>& p) {
+        std::array<F, 3> dist;
+        for (size_t i = 0; i < 3; ++i) {
+            dist[i] = simd::abs(simd::to_float<F>(p[i]) + far_side[i] - ro[i]) * t_delta[i];
+        }
+
+        return dist;
+    };
+
+    const uint8_t occupied_mask = ctx.params.composite != 0 ?
+        OccupancyGrid::EMISSIVE | OccupancyGrid::ABSORBENT :
+        OccupancyGrid::EMISSIVE;
+
+    const auto blocks = this->occupancy_grid ? static_cast<Vec3I>(this->occupancy_grid->blocks()) : Vec3I(0);
+    const Pixel* pixels = this->grid->format() == VoxelFormat::Rgba8 ? this->grid->pixels().begin() : nullptr;
+
+    F t = zero;
+    const F t_end = t_max - t_min;
+
+    auto total = std::array<F, 3>{};
+    F transmittance = one;
+
+    while (true) {
+        active &= t < t_end;
+
+        // Stepping rays one at a time is faster once most of the lanes are idle
+        const auto lanes = static_cast<size_t>(__builtin_popcount(simd::bitmask(active)));
+        if (lanes * PACKET_MIN_ACTIVE_FRACTION < N) {
+            break;
+        }
+
+        I inside = active;
+        for (size_t i = 0; i < 3; ++i) {
+            inside &= (pos[i] >= 0) & (pos[i] < dim[i]);
+        }
+
+        // See march
+        auto empty = I{};
+        if (!this->occupancy.empty()) {
+            std::array<I, 3> block;
+            for (size_t i = 0; i < 3; ++i) {
+                block[i] = pos[i] / OCCUPANCY_BLOCK_SIDE;
+            }
+
+            std::array<int32_t, N> block_index;
+            simd::store(block_index, block[0] + (block[1] + block[2] * blocks.y) * blocks.x);
+
+            std::array<int32_t, N> is_empty = {};
+            for (uint32_t bits = simd::bitmask(inside); bits != 0; bits &= bits - 1) {
+                const int lane = __builtin_ctz(bits);
+                if ((this->occupancy[static_cast<size_t>(block_index[lane])] & occupied_mask) == 0) {
+                    is_empty[static_cast<size_t>(lane)] = -1;
+                }
+            }
+
+            empty = simd::load<I>(is_empty);
+        }
+
+        if (simd::any(empty)) {
+            std::array<I, 3> last;
+            for (size_t i = 0; i < 3; ++i) {
+                last[i] = simd::min<I>(pos[i] / OCCUPANCY_BLOCK_SIDE * OCCUPANCY_BLOCK_SIDE + far_voxel[i], simd::broadcast<I>(dim[i] - 1));
+            }
+
+            const F t_exit = simd::min_elem(side_distance(last));
+
+            // See leap
+            std::array<I, 3> q;
+            for (size_t i = 0; i < 3; ++i) {
+                q[i] = simd::floor(ro[i] + rd[i] * t_exit);
+                q[i] = pos[i] + step[i] * simd::max<I>((q[i] - pos[i]) * step[i], I{});
+            }
+
+            for (int pass = 0; pass < 2; ++pass) {
+                const auto dist = side_distance(q);
+                for (size_t i = 0; i < 3; ++i) {
+                    q[i] += (dist[i] <= t_exit) & step[i];
+                }
+            }
+
+            for (int pass = 0; pass < 2; ++pass) {
+                const auto dist = side_distance({q[0] - step[0], q[1] - step[1], q[2] - step[2]});
+                for (size_t i = 0; i < 3; ++i) {
+                    q[i] -= (dist[i] > t_exit) & ((q[i] - pos[i]) * step[i] > 0) & step[i];
+                }
+            }
+
+            for (size_t i = 0; i < 3; ++i) {
+                pos[i] = simd::select<I>(empty, q[i], pos[i]);
+            }
+
+            t = simd::select<F>(empty, t_exit, t);
+        }
+
+        const I stepping = active & ~empty;
+        if (!simd::any(stepping)) {
+            continue;
+        }
+
+        const auto side_dist = side_distance(pos);
+        const F t0 = simd::min_elem(side_dist);
+
+        auto voxel = std::array<F, 4>{};
+        if (pixels) {
+            // The voxel index is split, as it may not fit in 32 bits
+            std::array<int32_t, N> x;
+            std::array<int32_t, N> row;
+            simd::store(x, pos[0]);
+            simd::store(row, pos[1] + pos[2] * dim.y);
+
+            std::array<uint32_t, N> packed = {};
+            for (uint32_t bits = simd::bitmask(stepping & inside); bits != 0; bits &= bits - 1) {
+                const int lane = __builtin_ctz(bits);
+                const size_t index = static_cast<size_t>(x[lane]) + static_cast<size_t>(row[lane]) * udim.x;
+                packed[lane] = pixels[index].pack();
+            }
+
+            // See unpack_unorm
+            const I channels = simd::load<I>(packed);
+            for (size_t i = 0; i < 4; ++i) {
+                voxel[i] = simd::to_float<F>((channels >> static_cast<int>(i * 8)) & 0xFF) / 255.f;
+            }
+        } else {
+            std::array<std::array<int32_t, N>, 3> p;
+            for (size_t i = 0; i < 3; ++i) {
+                simd::store(p[i], pos[i]);
+            }
+
+            std::array<std::array<float, N>, 4> values = {};
+            for (uint32_t bits = simd::bitmask(stepping); bits != 0; bits &= bits - 1) {
+                const auto lane = static_cast<size_t>(__builtin_ctz(bits));
+                const Vec4F v = this->voxel(Vec3I(p[0][lane], p[1][lane], p[2][lane]));
+
+                for (size_t i = 0; i < 4; ++i) {
+                    values[i][lane] = v[i];
+                }
+            }
+
+            for (size_t i = 0; i < 4; ++i) {
+                voxel[i] = simd::load<F>(values[i]);
+            }
+        }
+
+        const I saturated = simd::accumulate(ctx, total, transmittance, voxel, t0 - t, absorption, stepping);
+        t = simd::select<F>(stepping, t0, t);
+
+        const I advancing = stepping & ~saturated;
+        pos[0] += advancing & (side_dist[0] <= simd::min(side_dist[1], side_dist[2])) & step[0];
+        pos[1] += advancing & (side_dist[1] <= simd::min(side_dist[2], side_dist[0])) & step[1];
+        pos[2] += advancing & (side_dist[2] <= simd::min(side_dist[0], side_dist[1])) & step[2];
+
+        active &= ~saturated;
+    }
+
+    for (uint32_t bits = simd::bitmask(active); bits != 0; bits &= bits - 1) {
+        const int lane = __builtin_ctz(bits);
+
+        auto ray = DdaRay{
+            Vec3F(ro[0][lane], ro[1][lane], ro[2][lane]),
+            packet.rd[static_cast<size_t>(lane)],
+            Vec3I(pos[0][lane], pos[1][lane], pos[2][lane]),
+            t[lane],
+            t_end[lane],
+            Vec3F(total[0][lane], total[1][lane], total[2][lane]),
+            transmittance[lane]
+        };
+
+        this->march(ctx, ray, absorption[lane]);
+
+        for (size_t i = 0; i < 3; ++i) {
+            total[i][lane] = ray.total[i];
+        }
+    }
+
+    for (size_t i = 0; i < packet.size; ++i) {
+        colors[i] = Vec3F(total[0][i], total[1][i], total[2][i]) * emission[i];
+    }
+}
+
+__attribute__((target("avx2"), flatten))
+void CpuDdaAlgorithm::trace_packet_avx2(const TraceContext& ctx, const RayPacket& packet, RayPacket::Colors& colors) const {
+    this->trace_packet<8>(ctx, packet, colors);
+}
+
+__attribute__((target("avx512f"), flatten))
+void CpuDdaAlgorithm::trace_packet_avx512(const TraceContext& ctx, const RayPacket& packet, RayPacket::Colors& colors) const {
+    this->trace_packet<16>(ctx, packet, colors);
+}
+
+Vec4F CpuDdaAlgorithm::voxel(const Vec3I& pos) const {
+    const auto dim = static_cast<Vec3I>(this->grid->dimensions());
+    if (pos.x < 0 || pos.y < 0 || pos.z < 0 || pos.x >= dim.x || pos.y >= dim.y || pos.z >= dim.z) {
+        return Vec4F(0);
+    }
+
+    const auto index = static_cast<Vec3Sz>(pos);
+
+    if (this->grid->format() == VoxelFormat::Rgba8) {
+        return unpack_unorm(this->grid->at(index));
+    }
+
+    const auto udim = this->grid->dimensions();
+    const size_t i = index.x + (index.y + index.z * udim.y) * udim.x;
+    const float v = scalar_at(this->grid->format(), this->grid->voxel_data().data(), i);
+
+    // Linearly interpolate the transfer function as the sampler in dda_scalar.comp does, where NaN
+    // (which is undefined there) maps to the first entry.
+    constexpr const auto last_entry = static_cast<float>(TransferFunction::RESOLUTION - 1);
+    const float x = std::isnan(v) ? 0 : std::clamp(v * last_entry, 0.f, last_entry);
+    const float first = std::floor(x);
+
+    const auto entries = this->transfer_function.data();
+    const auto i0 = static_cast<size_t>(first);
+    const size_t i1 = std::min(i0 + 1, TransferFunction::RESOLUTION - 1);
+
+    return mix(unpack_unorm(entries[i0]), unpack_unorm(entries[i1]), x - first);
+}
@@ -0,0 +1,62 @@
+#ifndef _XENODON_RENDER_CPU_CPUDDAALGORITHM_H
+#define _XENODON_RENDER_CPU_CPUDDAALGORITHM_H
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "render/cpu/CpuRenderAlgorithm.h"
+#include "render/cpu/RayPacket.h"
+#include "model/Grid.h"
+#include "model/TransferFunction.h"
+#include "model/OccupancyGrid.h"
+#include "math/Vec.h"
+
+// A port of dda.comp and dda_scalar.comp, including empty space skipping.
+class CpuDdaAlgorithm final: public CpuRenderAlgorithm {
+    std::shared_ptr<Grid> grid;
+    TransferFunction transfer_function;
+
+    // When empty space skipping is disabled, there is no occupancy grid, and `occupancy` is empty.
+    std::shared_ptr<const OccupancyGrid> occupancy_grid;
+    std::vector<uint8_t> occupancy;
+
+public:
+    // The grid is required to have the linear layout.
+    CpuDdaAlgorithm(
+        std::shared_ptr<Grid> grid,
+        TransferFunction transfer_function = TransferFunction::grayscale(),
+        bool empty_space_skipping = true
+    );
+
+    Vec3F render_pixel(const TraceContext& ctx, Vec3F ro, Vec3F rd) const override;
+    void render_packet(const TraceContext& ctx, const RayPacket& packet, RayPacket::Colors& colors) const override;
+    void upload_transfer_function(const TransferFunction& transfer_function) override;
+
+private:
+    // The state of a ray in the loop of dda.glsl, where `ro` is the point at which it entered the model.
+    struct DdaRay {
+        Vec3F ro;
+        Vec3F rd;
+        Vec3I pos;
+        float t;
+        float t_end;
+        Vec3F total;
+        float transmittance;
+    };
+
+    Vec3F trace(const TraceContext& ctx, Vec3F ro, const Vec3F& rd, float absorption) const;
+    void march(const TraceContext& ctx, DdaRay& ray, float absorption) const;
+
+    // Traces all rays of a packet together, one per lane, until most of them finished. The remaining
+    // rays are then traced one by one with march.
+    template <size_t N>
+    void trace_packet(const TraceContext& ctx, const RayPacket& packet, RayPacket::Colors& colors) const;
+
+    void trace_packet_avx2(const TraceContext& ctx, const RayPacket& packet, RayPacket::Colors& colors) const;
+    void trace_packet_avx512(const TraceContext& ctx, const RayPacket& packet, RayPacket::Colors& colors) const;
+
+    Vec4F voxel(const Vec3I& pos) const;
+};
+
+#endif
@@ -0,0 +1,31 @@
+#include "render/cpu/CpuRenderAlgorithm.h"
+#include <cmath>
+
+float TraceContext::ray_stretch(const Vec3F& rd) const {
+    const Vec3F rd2 = rd * rd;
+    const Vec3F dim2 = this->params.voxel_ratio.xyz * this->params.voxel_ratio.xyz;
+    return std::sqrt(dot(rd2, dim2) / dot(rd2, Vec3F(1)));
+}
+
+bool TraceContext::accumulate(Vec3F& total, float& transmittance, const Vec4F& voxel, float dt, float absorption) const {
+    if (this->params.composite == 0) {
+        total += voxel.rgb * dt;
+        return false;
+    }
+
+    const float sigma = voxel.a * absorption;
+    const float segment_transmittance = std::exp(-sigma * dt);
+
+    // Emission integrated over the segment, which reduces to dt for transparent voxels
+    const float weight = sigma > 0 ? (1 - segment_transmittance) / sigma : dt;
+
+    total += voxel.rgb * (transmittance * weight);
+    transmittance *= segment_transmittance;
+    return transmittance < this->params.termination_threshold;
+}
+
+void CpuRenderAlgorithm::render_packet(const TraceContext& ctx, const RayPacket& packet, RayPacket::Colors& colors) const {
+    for (size_t i = 0; i < packet.size; ++i) {
+        colors[i] = this->render_pixel(ctx, packet.ro, packet.rd[i]);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef _XENODON_RENDER_CPU_CPURENDERALGORITHM_H
+#define _XENODON_RENDER_CPU_CPURENDERALGORITHM_H
+
+#include <algorithm>
+#include <cstdint>
+#include "render/RenderContext.h"
+#include "render/cpu/RayPacket.h"
+#include "model/Pixel.h"
+#include "model/TransferFunction.h"
+#include "math/Vec.h"
+
+// The counterpart of the uniforms and functions of resources/common.glsl, with which CPU render
+// algorithms trace rays in the same way as the shaders do.
+struct TraceContext {
+    RenderContext::ShaderParameters params;
+    Vec2<uint32_t> display_extent;
+
+    // See ray_stretch in common.glsl
+    float ray_stretch(const Vec3F& rd) const;
+
+    float voxel_emission_coeff(const Vec3F& rd) const {
+        return this->params.emission_coeff * this->ray_stretch(rd);
+    }
+
+    float voxel_absorption_coeff(const Vec3F& rd) const {
+        return this->params.absorption_coeff * this->ray_stretch(rd);
+    }
+
+    float lod_side(float t) const {
+        return std::max(t, 0.f) * this->params.lod_bias / static_cast<float>(this->display_extent.x);
+    }
+
+    // See accumulate in common.glsl
+    bool accumulate(Vec3F& total, float& transmittance, const Vec4F& voxel, float dt, float absorption) const;
+};
+
+struct CpuRenderAlgorithm {
+    virtual ~CpuRenderAlgorithm() = default;
+
+    // Compute the color of a pixel, given the camera position divided by the voxel ratio, and the direction
+    // of the ray through the pixel. This corresponds to the main function of the shader.
+    virtual Vec3F render_pixel(const TraceContext& ctx, Vec3F ro, Vec3F rd) const = 0;
+
+    // Compute the colors of all pixels of a packet. Algorithms which can trace packets with the instruction
+    // set of the packet size override this, and the default traces the rays one by one with render_pixel.
+    virtual void render_packet(const TraceContext& ctx, const RayPacket& packet, RayPacket::Colors& colors) const;
+
+    // Replace the transfer function used by the algorithm, if any. This is never called while rendering.
+    virtual void upload_transfer_function(const TransferFunction& transfer_function) {
+    }
+};
+
+inline float min_elem(const Vec3F& v) {
+    return std::min(v.x, std::min(v.y, v.z));
+}
+
+inline float max_elem(const Vec3F& v) {
+    return std::max(v.x, std::max(v.y, v.z));
+}
+
+inline Vec3F min(const Vec3F& a, const Vec3F& b) {
+    return Vec3F(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z));
+}
+
+inline Vec3F max(const Vec3F& a, const Vec3F& b) {
+    return Vec3F(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z));
+}
+
+// See unpackUnorm4x8
+inline Vec4F unpack_unorm(Pixel p) {
+    return Vec4F(p.r, p.g, p.b, p.a) / 255.f;
+}
+
+#endif
@@ -0,0 +1,142 @@
+#include "render/cpu/CpuRenderer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "core/Logger.h"
+#include "backend/headless/png.h"
+#include "utility/parallel.h"
+
+namespace {
+    constexpr const uint32_t PACKET_WIDTH = 4;
+
+    const float RAY_EPSILON = std::exp2(-23.f);
+
+    // See adjust_ray in common.glsl
+    Vec3F adjust_ray(Vec3F rd) {
+        return map(rd, [](float x) {
+            return std::abs(x) < RAY_EPSILON ? RAY_EPSILON : x;
+        });
+    }
+
+    // Convert a color as storing it in an rgba8 image would
+    uint32_t pack_color(const Vec3F& color) {
+        const auto channel = [](float x) {
+            return static_cast<uint8_t>(std::round(std::clamp(x, 0.f, 1.f) * 255.f));
+        };
+
+        return Pixel{channel(color.r), channel(color.g), channel(color.b), 255}.pack();
+    }
+}
+
+CpuRenderer::CpuRenderer(
+    std::unique_ptr<CpuRenderAlgorithm>&& algorithm,
+    const ShaderParameters& shader_params,
+    Vec2<uint32_t> extent,
+    size_t threads,
+    const PacketIsa& isa,
+    std::string_view out_path):
+    algorithm(std::move(algorithm)),
+    ctx{shader_params, extent},
+    threads(threads),
+    isa(isa),
+    out_path(out_path),
+    frame(0),
+    image(size_t{extent.x} * extent.y) {
+
+    LOGGER.log("Total resolution: {}x{} pixels", extent.x, extent.y);
+    LOGGER.log("Rendering on the CPU with {} threads", threads);
+
+    if (isa.packet_size == 1) {
+        LOGGER.log("Tracing rays one by one");
+    } else {
+        LOGGER.log("Tracing rays in packets of {} with {}", isa.packet_size, isa.name);
+    }
+}
+
+void CpuRenderer::render(const Camera& cam) {
+    const auto extent = this->ctx.display_extent;
+    const Vec3F voxel_ratio = this->ctx.params.voxel_ratio.xyz;
+
+    // See ray in common.glsl
+    const Vec3F dir = cam.forward;
+    const Vec3F right = normalize(cross(cam.up, dir));
+    const Vec3F up = normalize(cross(right, dir));
+    const float aspect = static_cast<float>(extent.y) / static_cast<float>(extent.x);
+
+    const Vec3F ro = cam.translation / voxel_ratio;
+
+    const uint32_t tiles_x = (extent.x - 1) / TILE_SIDE + 1;
+    const uint32_t tiles_y = (extent.y - 1) / TILE_SIDE + 1;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const uint32_t packet_width = std::min(PACKET_WIDTH, static_cast<uint32_t>(this->isa.packet_size));
+    const auto packet_height = static_cast<uint32_t>(this->isa.packet_size) / packet_width;
+
+    parallel_for(this->threads, size_t{tiles_x} * tiles_y, [&](size_t tile) {
+        const auto tile_x = static_cast<uint32_t>(tile % tiles_x) * TILE_SIDE;
+        const auto tile_y = static_cast<uint32_t>(tile / tiles_x) * TILE_SIDE;
+
+        RayPacket packet;
+        packet.ro = ro;
+        packet.size = this->isa.packet_size;
+
+        RayPacket::Colors colors;
+
+        for (uint32_t py = tile_y; py < std::min(tile_y + TILE_SIDE, extent.y); py += packet_height) {
+            for (uint32_t px = tile_x; px < std::min(tile_x + TILE_SIDE, extent.x); px += packet_width) {
+                // Packets which stick out of the image trace the pixels at its edge instead
+                for (uint32_t i = 0; i < packet.size; ++i) {
+                    const uint32_t x = std::min(px + i % packet_width, extent.x - 1);
+                    const uint32_t y = std::min(py + i / packet_width, extent.y - 1);
+
+                    const float u = static_cast<float>(x) / static_cast<float>(extent.x) - 0.5f;
+                    const float v = (static_cast<float>(y) / static_cast<float>(extent.y) - 0.5f) * aspect;
+
+                    packet.rd[i] = adjust_ray(normalize(normalize(u * right + v * up + dir) / voxel_ratio));
+                }
+
+                this->algorithm->render_packet(this->ctx, packet, colors);
+
+                for (uint32_t i = 0; i < packet.size; ++i) {
+                    const uint32_t x = px + i % packet_width;
+                    const uint32_t y = py + i / packet_width;
+
+                    if (x < extent.x && y < extent.y) {
+                        this->image[size_t{y} * extent.x + x] = pack_color(colors[i]);
+                    }
+                }
+            }
+        }
+    });
+
+    auto stop = std::chrono::high_resolution_clock::now();
+    const double time = std::chrono::duration<double, std::milli>(stop - start).count();
+
+    auto stats = RenderStats();
+    stats.total_rays = this->image.size();
+    stats.outputs = 1;
+    stats.total_render_time = time;
+    stats.max_render_time = time;
+    stats.min_render_time = time;
+    this->completed.push_back(stats);
+
+    if (!this->out_path.empty()) {
+        LOGGER.log("Saving frame {}...", this->frame);
+        save_png(format_frame_path(this->out_path, this->frame), this->image.data(), extent.x, extent.y);
+    }
+
+    ++this->frame;
+}
+
+void CpuRenderer::upload_transfer_function(const TransferFunction& transfer_function) {
+    this->algorithm->upload_transfer_function(transfer_function);
+}
+
+void CpuRenderer::collect_stats(RenderStatsAccumulator& accum) {
+    for (const auto& stats : this->completed) {
+        accum(stats);
+    }
+
+    this->completed.clear();
+}
@@ -0,0 +1,63 @@
+#ifndef _XENODON_RENDER_CPU_CPURENDERER_H
+#define _XENODON_RENDER_CPU_CPURENDERER_H
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include "render/cpu/CpuRenderAlgorithm.h"
+#include "render/cpu/RayPacket.h"
+#include "render/RenderContext.h"
+#include "render/RenderStats.h"
+#include "camera/Camera.h"
+#include "model/TransferFunction.h"
+#include "math/Vec.h"
+
+// Renders frames on the CPU with a CpuRenderAlgorithm, so that no Vulkan device is required. Each frame
+// is divided into tiles of TILE_SIDE^2 pixels, which are rendered in parallel, and is saved to a PNG
+// image in the same way as frames of the headless backend. Tiles are traced in packets of 4 pixels wide,
+// and as high as needed to fill the packet size of the instruction set.
+class CpuRenderer {
+public:
+    using ShaderParameters = RenderContext::ShaderParameters;
+
+    constexpr const static uint32_t TILE_SIDE = 16;
+
+private:
+    std::unique_ptr<CpuRenderAlgorithm> algorithm;
+    TraceContext ctx;
+    size_t threads;
+    PacketIsa isa;
+
+    // Frames are not saved when the output path is empty
+    std::string out_path;
+    size_t frame;
+
+    // The pixels of the last rendered frame, see save_png
+    std::vector<uint32_t> image;
+
+    // Stats of the frames rendered since the last call to collect_stats
+    std::vector<RenderStats> completed;
+
+public:
+    CpuRenderer(
+        std::unique_ptr<CpuRenderAlgorithm>&& algorithm,
+        const ShaderParameters& shader_params,
+        Vec2<uint32_t> extent,
+        size_t threads,
+        const PacketIsa& isa,
+        std::string_view out_path
+    );
+
+    void render(const Camera& cam);
+    void upload_transfer_function(const TransferFunction& transfer_function);
+
+    // Frames are finished when render returns, see MultiplexRenderer::finish.
+    void finish() {}
+
+    void collect_stats(RenderStatsAccumulator& accum);
+};
+
+#endif
@@ -0,0 +1,753 @@
+#include "render/cpu/CpuSvoAlgorithm.h"
+#include <array>
+#include <algorithm>
+#include <utility>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include "core/Error.h"
+#include "render/cpu/simd.h"
+
+// The traversal functions below follow the shaders line by line, including their floating point
+// operations where possible, so that the output can be compared to that of the GPU.
+
+namespace {
+    constexpr const float MIN_STEP_SIZE = 0.00001f;
+
+    // FLOAT_MANTISSA_BITS, the maximum depth of the traversal stacks
+    constexpr const uint32_t CAST_STACK_DEPTH = 23;
+
+    // The bit of a child index that denotes the positive half along an axis, see Octree::X_POS etc.
+    constexpr const std::array<uint32_t, 3> AXIS_BITS = {4, 2, 1};
+
+    uint32_t child_node(const Octree::Node& node, uint32_t child) {
+        return node.children[child];
+    }
+
+    uint32_t child_node(const CompactOctree::Node& node, uint32_t child) {
+        return node.first_child + child;
+    }
+
+    // See mod in GLSL, which differs from std::fmod for negative values
+    float glsl_mod(float x, float y) {
+        return x - y * std::floor(x / y);
+    }
+
+    uint32_t float_bits(float f) {
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof bits);
+        return bits;
+    }
+
+    float bits_float(uint32_t bits) {
+        float f;
+        std::memcpy(&f, &bits, sizeof f);
+        return f;
+    }
+
+    // A vector with 1 along the axes of which the bit is set in the child index, and 0 otherwise.
+    Vec3F child_offset(uint32_t child) {
+        return Vec3F(
+            (child & AXIS_BITS[0]) != 0 ? 1.f : 0.f,
+            (child & AXIS_BITS[1]) != 0 ? 1.f : 0.f,
+            (child & AXIS_BITS[2]) != 0 ? 1.f : 0.f
+        );
+    }
+
+    // Returns the range [t_min, t_max] in which the ray intersects the unit cube, where t_min > t_max if it misses.
+    std::pair<float, float> unit_cube_intersect(const Vec3F& rrd, const Vec3F& bias) {
+        const Vec3F box_min = -bias;
+        const Vec3F box_max = rrd - bias;
+
+        return {
+            max_elem(min(box_min, box_max)),
+            min_elem(max(box_min, box_max))
+        };
+    }
+
+    // Find the leaf containing pos, or the first node on the way that is smaller than min_side,
+    // starting at a node of side extent at offset. See find in svo_naive.comp.
+    uint32_t find(const Octree::Node* nodes, uint32_t index, Vec3F offset, float extent, const Vec3F& pos, float min_side, Vec3F& base, float& side) {
+        while (true) {
+            const auto& node = nodes[index];
+            if (node.is_leaf() || extent < min_side) {
+                base = offset;
+                side = extent;
+                return index;
+            }
+
+            extent *= 0.5f;
+            uint32_t child = 0;
+
+            for (size_t i = 0; i < 3; ++i) {
+                if (pos[i] >= offset[i] + extent) {
+                    child |= AXIS_BITS[i];
+                    offset[i] += extent;
+                }
+            }
+
+            index = node.children[child];
+        }
+    }
+
+    Vec3F trace_naive(const TraceContext& ctx, const Octree::Node* nodes, const Vec3F& ro, const Vec3F& rd, float absorption) {
+        const Vec3F rrd = 1.f / rd;
+        const Vec3F bias = rrd * ro;
+
+        auto [t_min, t_max] = unit_cube_intersect(rrd, bias);
+        if (t_min > t_max) {
+            return Vec3F(0);
+        }
+
+        t_min = std::max(t_min, 0.f);
+
+        auto total = Vec3F(0);
+        float transmittance = 1;
+
+        float t = t_min + MIN_STEP_SIZE;
+
+        while (t < t_max) {
+            const Vec3F p = t * rd + ro;
+            Vec3F offset;
+            float side;
+            const uint32_t node = find(nodes, 0, Vec3F(0), 1, p, ctx.lod_side(t), offset, side);
+
+            const Vec3F node_min = offset * rrd - bias;
+            const Vec3F node_max = (offset + side) * rrd - bias;
+
+            const float u_min = std::max(max_elem(min(node_min, node_max)), 0.f);
+            const float u_max = min_elem(max(node_min, node_max));
+
+            const float step = std::max(u_max - u_min, MIN_STEP_SIZE);
+            t += step;
+
+            if (ctx.accumulate(total, transmittance, unpack_unorm(nodes[node].color), step, absorption)) {
+                break;
+            }
+        }
+
+        return total;
+    }
+
+    // Traverse the subtree of root depth-first, where pos and side are those of its first child to visit.
+    // Returns whether the ray became saturated.
+    template <typename Node>
+    bool trace_df_subtree(
+        const TraceContext& ctx,
+        const Node* nodes,
+        uint32_t root,
+        Vec3F pos,
+        float side,
+        const Vec3F& rrd,
+        const Vec3F& bias,
+        uint32_t octant_mask,
+        float absorption,
+        Vec3F& total,
+        float& transmittance
+    ) {
+        int sp = 0;
+        uint32_t node_stack[CAST_STACK_DEPTH];
+        uint32_t child_index_stack[CAST_STACK_DEPTH];
+        float side_stack[CAST_STACK_DEPTH];
+
+        const Vec3F octant_offset = child_offset(octant_mask);
+
+        uint32_t node = root;
+        uint32_t child_idx = 0;
+
+        while (true) {
+            const uint32_t child = child_node(nodes[node], child_idx ^ octant_mask);
+            const Vec3F box_min = pos * rrd - bias;
+            const Vec3F box_max = (pos + side) * rrd - bias;
+
+            const float t_min = max_elem(min(box_min, box_max));
+            const float t_max = min_elem(max(box_min, box_max));
+
+            if (t_min < t_max && t_max > 0) {
+                if (nodes[child].is_leaf() || side < ctx.lod_side(t_min)) {
+                    const Vec4F color = unpack_unorm(nodes[child].color);
+                    if (ctx.accumulate(total, transmittance, color, t_max - std::max(t_min, 0.f), absorption)) {
+                        return true;
+                    }
+                } else {
+                    if (child_idx != 7) {
+                        node_stack[sp] = node;
+                        child_index_stack[sp] = child_idx;
+                        side_stack[sp] = side;
+                        ++sp;
+                    }
+
+                    side *= 0.5f;
+                    node = child;
+                    child_idx = 0;
+                    pos += octant_offset * side;
+                    continue;
+                }
+            }
+
+            if (child_idx == 7) {
+                --sp;
+                if (sp < 0) {
+                    return false;
+                }
+
+                node = node_stack[sp];
+                child_idx = child_index_stack[sp];
+                side = side_stack[sp];
+            }
+
+            pos = map(pos, [side](float x) {
+                return x - glsl_mod(x, side * 2.f);
+            });
+
+            ++child_idx;
+            pos += child_offset(child_idx ^ octant_mask) * side;
+        }
+    }
+
+    // In composite mode, the children are visited front to back
+    uint32_t df_octant_mask(const TraceContext& ctx, const Vec3F& rd) {
+        uint32_t octant_mask = 0;
+        if (ctx.params.composite != 0) {
+            for (size_t i = 0; i < 3; ++i) {
+                octant_mask |= rd[i] < 0 ? AXIS_BITS[i] : 0;
+            }
+        }
+
+        return octant_mask;
+    }
+
+    template <typename Node>
+    Vec3F trace_df(const TraceContext& ctx, const Node* nodes, const Vec3F& ro, const Vec3F& rd, float absorption) {
+        const Vec3F rrd = 1.f / rd;
+        const Vec3F bias = rrd * ro;
+
+        const uint32_t octant_mask = df_octant_mask(ctx, rd);
+        const float side = 0.5f;
+        const Vec3F pos = child_offset(octant_mask) * side;
+
+        auto total = Vec3F(0);
+        float transmittance = 1;
+
+        trace_df_subtree(ctx, nodes, 0, pos, side, rrd, bias, octant_mask, absorption, total, transmittance);
+        return total;
+    }
+
+    // Traverse the octree depth-first with a packet of rays, which share the stack. Children that none of the
+    // rays hit are skipped, and each ray only accumulates the nodes that it would visit when traced by itself,
+    // so that the colors are the same. Subtrees that only one ray descends into are traversed by that ray alone.
+    // Returns false if the rays visit the children in different orders, in which case the packet is not traced.
+    template <typename Node, size_t N>
+    bool trace_df_packet(const TraceContext& ctx, const Node* nodes, const RayPacket& packet, RayPacket::Colors& colors) {
+        using F = simd::Float<N>;
+        using I = simd::Int<N>;
+
+        const uint32_t octant_mask = df_octant_mask(ctx, packet.rd[0]);
+        for (size_t i = 1; i < N; ++i) {
+            if (df_octant_mask(ctx, packet.rd[i]) != octant_mask) {
+                return false;
+            }
+        }
+
+        const Vec3F octant_offset = child_offset(octant_mask);
+
+        std::array<F, 3> rrd;
+        std::array<F, 3> bias;
+
+        for (size_t i = 0; i < 3; ++i) {
+            rrd[i] = 1.f / simd::load_component<F>(packet.rd, i);
+            bias[i] = rrd[i] * packet.ro[i];
+        }
+
+        std::array<float, N> absorption;
+        for (size_t i = 0; i < N; ++i) {
+            absorption[i] = ctx.voxel_absorption_coeff(packet.rd[i]);
+        }
+
+        const auto zero = F{};
+        const auto lod_scale = ctx.params.lod_bias;
+        const auto lod_extent = static_cast<float>(ctx.display_extent.x);
+
+        int sp = 0;
+        uint32_t node_stack[CAST_STACK_DEPTH];
+        uint32_t child_index_stack[CAST_STACK_DEPTH];
+        float side_stack[CAST_STACK_DEPTH];
+        I mask_stack[CAST_STACK_DEPTH];
+
+        uint32_t node = 0;
+        uint32_t child_idx = 0;
+
+        float side = 0.5f;
+        Vec3F pos = octant_offset * side;
+
+        // The rays which are not saturated, and those which descended into the current node
+        I active = simd::broadcast<I>(-1);
+        I mask = active;
+
+        auto total = std::array<F, 3>{};
+        F transmittance = simd::broadcast<F>(1.f);
+
+        while (true) {
+            const uint32_t child = child_node(nodes[node], child_idx ^ octant_mask);
+
+            std::array<F, 3> box_min;
+            std::array<F, 3> box_max;
+
+            for (size_t i = 0; i < 3; ++i) {
+                box_min[i] = pos[i] * rrd[i] - bias[i];
+                box_max[i] = (pos[i] + side) * rrd[i] - bias[i];
+            }
+
+            const F t_min = simd::max_elem<F>({
+                simd::min(box_min[0], box_max[0]),
+                simd::min(box_min[1], box_max[1]),
+                simd::min(box_min[2], box_max[2])
+            });
+
+            const F t_max = simd::min_elem<F>({
+                simd::max(box_min[0], box_max[0]),
+                simd::max(box_min[1], box_max[1]),
+                simd::max(box_min[2], box_max[2])
+            });
+
+            const I hit = mask & (t_min < t_max) & (t_max > zero);
+
+            if (simd::any(hit)) {
+                I stop = hit;
+                if (!nodes[child].is_leaf()) {
+                    // See TraceContext::lod_side
+                    stop &= side < simd::max(t_min, zero) * lod_scale / lod_extent;
+                }
+
+                if (simd::any(stop)) {
+                    const Vec4F color = unpack_unorm(nodes[child].color);
+                    const auto voxel = std::array<F, 4>{
+                        simd::broadcast<F>(color.x),
+                        simd::broadcast<F>(color.y),
+                        simd::broadcast<F>(color.z),
+                        simd::broadcast<F>(color.w)
+                    };
+
+                    const F dt = t_max - simd::max(t_min, zero);
+                    const I saturated = simd::accumulate(ctx, total, transmittance, voxel, dt, simd::load<F>(absorption), stop);
+
+                    active &= ~saturated;
+                    if (!simd::any(active)) {
+                        break;
+                    }
+
+                    mask &= active;
+                }
+
+                const I descend = hit & ~stop;
+                const uint32_t bits = simd::bitmask(descend);
+
+                if (bits != 0 && (bits & (bits - 1)) == 0) {
+                    const auto lane = static_cast<size_t>(__builtin_ctz(bits));
+                    const float child_side = side * 0.5f;
+
+                    auto lane_total = Vec3F(total[0][lane], total[1][lane], total[2][lane]);
+                    float lane_transmittance = transmittance[lane];
+
+                    const bool saturated = trace_df_subtree(
+                        ctx,
+                        nodes,
+                        child,
+                        pos + octant_offset * child_side,
+                        child_side,
+                        Vec3F(rrd[0][lane], rrd[1][lane], rrd[2][lane]),
+                        Vec3F(bias[0][lane], bias[1][lane], bias[2][lane]),
+                        octant_mask,
+                        absorption[lane],
+                        lane_total,
+                        lane_transmittance
+                    );
+
+                    for (size_t i = 0; i < 3; ++i) {
+                        total[i][lane] = lane_total[i];
+                    }
+
+                    transmittance[lane] = lane_transmittance;
+
+                    if (saturated) {
+                        active[lane] = 0;
+                        if (!simd::any(active)) {
+                            break;
+                        }
+
+                        mask &= active;
+                    }
+                } else if (bits != 0) {
+                    if (child_idx != 7) {
+                        node_stack[sp] = node;
+                        child_index_stack[sp] = child_idx;
+                        side_stack[sp] = side;
+                        mask_stack[sp] = mask;
+                        ++sp;
+                    }
+
+                    side *= 0.5f;
+                    node = child;
+                    child_idx = 0;
+                    pos += octant_offset * side;
+                    mask = descend;
+                    continue;
+                }
+            }
+
+            if (child_idx == 7) {
+                --sp;
+                if (sp < 0) {
+                    break;
+                }
+
+                node = node_stack[sp];
+                child_idx = child_index_stack[sp];
+                side = side_stack[sp];
+                mask = mask_stack[sp] & active;
+            }
+
+            pos = map(pos, [side](float x) {
+                return x - glsl_mod(x, side * 2.f);
+            });
+
+            ++child_idx;
+            pos += child_offset(child_idx ^ octant_mask) * side;
+        }
+
+        for (size_t i = 0; i < N; ++i) {
+            colors[i] = Vec3F(total[0][i], total[1][i], total[2][i]) * ctx.voxel_emission_coeff(packet.rd[i]);
+        }
+
+        return true;
+    }
+
+    template <typename Node>
+    __attribute__((target("avx2"), flatten))
+    bool trace_df_packet_avx2(const TraceContext& ctx, const Node* nodes, const RayPacket& packet, RayPacket::Colors& colors) {
+        return trace_df_packet<Node, 8>(ctx, nodes, packet, colors);
+    }
+
+    template <typename Node>
+    __attribute__((target("avx512f"), flatten))
+    bool trace_df_packet_avx512(const TraceContext& ctx, const Node* nodes, const RayPacket& packet, RayPacket::Colors& colors) {
+        return trace_df_packet<Node, 16>(ctx, nodes, packet, colors);
+    }
+
+    // Returns false if the packet is to be traced one ray at a time.
+    template <typename Node>
+    bool render_df_packet(const TraceContext& ctx, const Node* nodes, const RayPacket& packet, RayPacket::Colors& colors) {
+        switch (packet.size) {
+            case 8:
+                return trace_df_packet_avx2(ctx, nodes, packet, colors);
+            case 16:
+                return trace_df_packet_avx512(ctx, nodes, packet, colors);
+            default:
+                return false;
+        }
+    }
+
+    // Implementation of 'Efficient Sparse Voxel Octrees' by Laine & Karras, see esvo.comp. The model
+    // spans [1, 2] in each dimension, and t_offset is the distance from the camera to ro.
+    template <typename Node>
+    Vec3F trace_esvo(const TraceContext& ctx, const Node* nodes, const Vec3F& ro, const Vec3F& rd, float absorption, float t_offset) {
+        // Add an extra slot to mirror the shader
+        uint32_t node_stack[CAST_STACK_DEPTH + 1];
+        float t_max_stack[CAST_STACK_DEPTH + 1];
+
+        const Vec3F t_coeff = map(rd, [](float x) {
+            return 1.f / -std::abs(x);
+        });
+
+        Vec3F t_bias = t_coeff * ro;
+
+        uint32_t octant_mask = 0;
+        for (size_t i = 0; i < 3; ++i) {
+            if (rd[i] > 0) {
+                t_bias[i] = 3.f * t_coeff[i] - t_bias[i];
+                octant_mask ^= AXIS_BITS[i];
+            }
+        }
+
+        float t_min = max_elem(2.f * t_coeff - t_bias);
+        float t_max = min_elem(t_coeff - t_bias);
+        float h = t_max;
+
+        t_min = std::max(t_min, 0.f);
+        t_max = std::min(t_max, std::sqrt(3.f));
+
+        uint32_t parent = 0;
+        uint32_t idx = 0;
+        auto pos = Vec3F(1);
+        uint32_t scale = CAST_STACK_DEPTH - 1;
+        float scale_exp2 = 0.5f;
+
+        for (size_t i = 0; i < 3; ++i) {
+            if (1.5f * t_coeff[i] - t_bias[i] > t_min) {
+                pos[i] = 1.5f;
+                idx ^= AXIS_BITS[i];
+            }
+        }
+
+        auto total = Vec3F(0);
+        float transmittance = 1;
+
+        while (scale < CAST_STACK_DEPTH) {
+            const Vec3F t_corner = pos * t_coeff - t_bias;
+            const float tc_max = min_elem(t_corner);
+
+            if (t_min <= t_max) {
+                const float tv_max = std::min(t_max, tc_max);
+
+                if (t_min <= tv_max) {
+                    const uint32_t child = child_node(nodes[parent], idx ^ octant_mask);
+
+                    if (nodes[child].is_leaf() || scale_exp2 < ctx.lod_side(t_offset + t_min)) {
+                        const Vec4F color = unpack_unorm(nodes[child].color);
+                        if (ctx.accumulate(total, transmittance, color, tv_max - t_min, absorption)) {
+                            break;
+                        }
+                    } else {
+                        // PUSH
+                        if (tc_max < h) {
+                            node_stack[scale] = parent;
+                            t_max_stack[scale] = t_max;
+                        }
+
+                        h = tc_max;
+
+                        parent = child;
+
+                        --scale;
+                        scale_exp2 *= 0.5f;
+
+                        const Vec3F t_center = scale_exp2 * t_coeff + t_corner;
+
+                        idx = 0;
+                        for (size_t i = 0; i < 3; ++i) {
+                            if (t_center[i] > t_min) {
+                                idx ^= AXIS_BITS[i];
+                                pos[i] += scale_exp2;
+                            }
+                        }
+
+                        t_max = tv_max;
+                        continue;
+                    }
+                }
+            }
+
+            // ADVANCE
+
+            uint32_t step_mask = 0;
+            for (size_t i = 0; i < 3; ++i) {
+                if (t_corner[i] <= tc_max) {
+                    step_mask ^= AXIS_BITS[i];
+                    pos[i] -= scale_exp2;
+                }
+            }
+
+            t_min = tc_max;
+            idx ^= step_mask;
+
+            if ((idx & step_mask) != 0) {
+                // POP
+
+                uint32_t dbits = 0;
+                for (size_t i = 0; i < 3; ++i) {
+                    if (t_corner[i] <= tc_max) {
+                        dbits |= float_bits(pos[i]) ^ float_bits(pos[i] + scale_exp2);
+                    }
+                }
+
+                scale = (float_bits(static_cast<float>(dbits)) >> 23) - 127;
+
+                // The shader reads past the stack here before leaving the loop
+                if (scale >= CAST_STACK_DEPTH) {
+                    break;
+                }
+
+                scale_exp2 = bits_float((scale - CAST_STACK_DEPTH + 127) << 23);
+
+                parent = node_stack[scale];
+                t_max = t_max_stack[scale];
+
+                idx = 0;
+                for (size_t i = 0; i < 3; ++i) {
+                    const uint32_t sh = float_bits(pos[i]) >> scale;
+                    pos[i] = bits_float(sh << scale);
+                    idx |= (sh % 2) * AXIS_BITS[i];
+                }
+
+                h = 0;
+            }
+        }
+
+        return total;
+    }
+
+    template <typename Node>
+    Vec3F render_esvo(const TraceContext& ctx, const Node* nodes, Vec3F ro, const Vec3F& rd) {
+        ro += Vec3F(1);
+
+        // See aabb_intersect in esvo.comp
+        const Vec3F rrd = 1.f / (rd + 0.00000001f);
+        const Vec3F tbot = (Vec3F(1) - ro) * rrd;
+        const Vec3F ttop = (Vec3F(2) - ro) * rrd;
+        const float t_offset = std::max(max_elem(min(ttop, tbot)), 0.f);
+
+        ro += t_offset * rd;
+
+        return trace_esvo(ctx, nodes, ro, rd, ctx.voxel_absorption_coeff(rd), t_offset) * ctx.voxel_emission_coeff(rd);
+    }
+
+    // See find_relative in svo_rope.comp
+    uint32_t find_relative(const Octree::Node* nodes, uint32_t parent, Vec3F offset, const Vec3F& pos, float min_side, Vec3F& base, float& side) {
+        const float extent = std::exp2(-static_cast<float>(nodes[parent].is_leaf_depth & ~Octree::LEAF));
+
+        offset = map(offset, [extent](float x) {
+            return x - glsl_mod(x, extent);
+        });
+
+        return find(nodes, parent, offset, extent, pos, min_side, base, side);
+    }
+
+    Vec3F trace_rope(const TraceContext& ctx, const Octree::Node* nodes, const Vec3F& ro, const Vec3F& rd, float absorption) {
+        // The index of the rope to follow for each axis, see Octree::generate_ropes
+        std::array<uint32_t, 3> neighbor_base;
+        Vec3F sgn;
+
+        for (size_t i = 0; i < 3; ++i) {
+            neighbor_base[i] = static_cast<uint32_t>(i * 2 + 1) - (rd[i] > 0 ? 1u : 0u);
+            sgn[i] = (rd[i] > 0 ? 1.f : -1.f) + 0.1f;
+        }
+
+        const Vec3F rrd = 1.f / rd;
+        const Vec3F bias = rrd * ro;
+
+        auto [t_min, t_max] = unit_cube_intersect(rrd, bias);
+        if (t_min > t_max) {
+            return Vec3F(0);
+        }
+
+        t_min = std::max(t_min, 0.f);
+
+        auto total = Vec3F(0);
+        float transmittance = 1;
+        // Level of detail nodes may start before the previous node ends, see svo_rope.comp
+        float t_prev = t_min;
+
+        Vec3F offset;
+        float side;
+        uint32_t node = find(nodes, 0, Vec3F(0), 1, ro + t_min * rd, ctx.lod_side(t_min), offset, side);
+
+        while (true) {
+            const Vec3F node_min = offset * rrd - bias;
+            const Vec3F node_max = (offset + side) * rrd - bias;
+
+            const Vec3F far = max(node_min, node_max);
+
+            const float u_min = max_elem(min(node_min, node_max));
+            const float u_max = min_elem(far);
+            const float step = u_max - std::max(u_min, t_prev);
+            t_prev = u_max;
+
+            if (ctx.accumulate(total, transmittance, unpack_unorm(nodes[node].color), step, absorption)) {
+                break;
+            }
+
+            if (!nodes[node].is_leaf()) {
+                // Ropes only link leaves
+                const float t = u_max + MIN_STEP_SIZE;
+                if (t >= t_max) {
+                    break;
+                }
+
+                node = find(nodes, 0, Vec3F(0), 1, ro + t * rd, ctx.lod_side(t), offset, side);
+                continue;
+            }
+
+            // See neighbor_index in svo_rope.comp
+            size_t axis = 2;
+            if (far.x < std::min(far.y, far.z)) {
+                axis = 0;
+            } else if (far.y < far.z) {
+                axis = 1;
+            }
+
+            node = nodes[node].children[neighbor_base[axis]];
+            if (node == 0) {
+                break;
+            }
+
+            offset[axis] += sgn[axis] * side;
+            node = find_relative(nodes, node, offset, ro + u_max * rd, ctx.lod_side(u_max), offset, side);
+        }
+
+        return total;
+    }
+}
+
+CpuSvoAlgorithm::CpuSvoAlgorithm(std::shared_ptr<Octree> octree, SvoTraversal traversal):
+    octree(octree), traversal(traversal) {
+}
+
+Vec3F CpuSvoAlgorithm::render_pixel(const TraceContext& ctx, Vec3F ro, Vec3F rd) const {
+    const Octree::Node* nodes = this->octree->data().data();
+
+    if (this->traversal == SvoTraversal::Esvo) {
+        return render_esvo(ctx, nodes, ro, rd);
+    }
+
+    const float absorption = ctx.voxel_absorption_coeff(rd);
+    Vec3F color;
+
+    switch (this->traversal) {
+        case SvoTraversal::Naive:
+            color = trace_naive(ctx, nodes, ro, rd, absorption);
+            break;
+        case SvoTraversal::DepthFirst:
+            color = trace_df(ctx, nodes, ro, rd, absorption);
+            break;
+        default:
+        case SvoTraversal::Rope:
+            color = trace_rope(ctx, nodes, ro, rd, absorption);
+            break;
+    }
+
+    return color * ctx.voxel_emission_coeff(rd);
+}
+
+void CpuSvoAlgorithm::render_packet(const TraceContext& ctx, const RayPacket& packet, RayPacket::Colors& colors) const {
+    // The naive and rope traversals find each node from the root or its neighbor, which is different for every ray.
+    // Esvo rays are traced one by one as well, so that they keep checking the port of esvo.comp.
+    const bool df = this->traversal == SvoTraversal::DepthFirst;
+    if (!df || !render_df_packet(ctx, this->octree->data().data(), packet, colors)) {
+        CpuRenderAlgorithm::render_packet(ctx, packet, colors);
+    }
+}
+
+CpuCompactSvoAlgorithm::CpuCompactSvoAlgorithm(std::shared_ptr<CompactOctree> octree, SvoTraversal traversal):
+    octree(octree), traversal(traversal) {
+    if (traversal != SvoTraversal::DepthFirst && traversal != SvoTraversal::Esvo) {
+        throw Error("Compact octrees can only be traversed depth-first or with esvo");
+    }
+}
+
+Vec3F CpuCompactSvoAlgorithm::render_pixel(const TraceContext& ctx, Vec3F ro, Vec3F rd) const {
+    const CompactOctree::Node* nodes = this->octree->data().data();
+
+    if (this->traversal == SvoTraversal::Esvo) {
+        return render_esvo(ctx, nodes, ro, rd);
+    }
+
+    return trace_df(ctx, nodes, ro, rd, ctx.voxel_absorption_coeff(rd)) * ctx.voxel_emission_coeff(rd);
+}
+
+void CpuCompactSvoAlgorithm::render_packet(const TraceContext& ctx, const RayPacket& packet, RayPacket::Colors& colors) const {
+    // See CpuSvoAlgorithm::render_packet
+    const bool df = this->traversal == SvoTraversal::DepthFirst;
+    if (!df || !render_df_packet(ctx, this->octree->data().data(), packet, colors)) {
+        CpuRenderAlgorithm::render_packet(ctx, packet, colors);
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef _XENODON_RENDER_CPU_CPUSVOALGORITHM_H
+#define _XENODON_RENDER_CPU_CPUSVOALGORITHM_H
+
+#include <memory>
+#include "render/cpu/CpuRenderAlgorithm.h"
+#include "model/Octree.h"
+#include "model/CompactOctree.h"
+#include "math/Vec.h"
+
+// The octree traversal algorithms, each of which is a port of the shader of the same name.
+enum class SvoTraversal {
+    Naive, // svo_naive.comp
+    DepthFirst, // svo_df.comp and svo_df_compact.comp
+    Esvo, // esvo.comp and esvo_compact.comp
+    Rope // svo_rope.comp
+};
+
+class CpuSvoAlgorithm final: public CpuRenderAlgorithm {
+    std::shared_ptr<Octree> octree;
+    SvoTraversal traversal;
+
+public:
+    CpuSvoAlgorithm(std::shared_ptr<Octree> octree, SvoTraversal traversal);
+    Vec3F render_pixel(const TraceContext& ctx, Vec3F ro, Vec3F rd) const override;
+    void render_packet(const TraceContext& ctx, const RayPacket& packet, RayPacket::Colors& colors) const override;
+};
+
+// Compact octrees can only be traversed depth-first or with esvo, as on the GPU.
+class CpuCompactSvoAlgorithm final: public CpuRenderAlgorithm {
+    std::shared_ptr<CompactOctree> octree;
+    SvoTraversal traversal;
+
+public:
+    CpuCompactSvoAlgorithm(std::shared_ptr<CompactOctree> octree, SvoTraversal traversal);
+    Vec3F render_pixel(const TraceContext& ctx, Vec3F ro, Vec3F rd) const override;
+    void render_packet(const TraceContext& ctx, const RayPacket& packet, RayPacket::Colors& colors) const override;
+};
+
+#endif
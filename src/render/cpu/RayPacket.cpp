@@ -0,0 +1,52 @@
+#include "render/cpu/RayPacket.h"
+#include <vector>
+#include "core/Error.h"
+
+namespace {
+    std::vector<PacketIsa> detect_packet_isas() {
+        auto isas = std::vector<PacketIsa>{
+            {"scalar", 1}
+        };
+
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2")) {
+            isas.push_back({"avx2", 8});
+        }
+
+        if (__builtin_cpu_supports("avx512f")) {
+            isas.push_back({"avx512", 16});
+        }
+
+        return isas;
+    }
+
+    const std::vector<PacketIsa>& all_packet_isas() {
+        static const auto isas = detect_packet_isas();
+        return isas;
+    }
+}
+
+Span<PacketIsa> supported_packet_isas() {
+    return all_packet_isas();
+}
+
+const PacketIsa& find_packet_isa(std::string_view name) {
+    const auto& isas = all_packet_isas();
+    if (name.empty()) {
+        // Rays diverge more in packets of 16, which makes avx512 slower than avx2 on most volumes.
+        return isas.size() > 1 ? isas[1] : isas[0];
+    }
+
+    for (const auto& isa : isas) {
+        if (isa.name == name) {
+            return isa;
+        }
+    }
+
+    if (name == "avx2" || name == "avx512") {
+        throw Error("Instruction set '{}' is not supported by this host", name);
+    }
+
+    throw Error("Invalid instruction set '{}', expected 'scalar', 'avx2' or 'avx512'", name);
+}
@@ -0,0 +1,36 @@
+#ifndef _XENODON_RENDER_CPU_RAYPACKET_H
+#define _XENODON_RENDER_CPU_RAYPACKET_H
+
+#include <array>
+#include <string_view>
+#include <cstddef>
+#include "utility/Span.h"
+#include "math/Vec.h"
+
+// A packet of rays through neighbouring pixels, which all start at the camera. A packet holds one ray per
+// SIMD lane of the instruction set with which it is traced, see CpuRenderAlgorithm::render_packet.
+struct RayPacket {
+    constexpr const static size_t MAX_SIZE = 16;
+
+    using Colors = std::array<Vec3F, MAX_SIZE>;
+
+    Vec3F ro;
+    size_t size;
+    std::array<Vec3F, MAX_SIZE> rd;
+};
+
+// An instruction set with which ray packets can be traced, which determines the size of the packets.
+struct PacketIsa {
+    std::string_view name;
+
+    // 1 if rays are traced one by one
+    size_t packet_size;
+};
+
+// All instruction sets supported by the host, from the most portable to the fastest.
+Span<PacketIsa> supported_packet_isas();
+
+// The supported instruction set of the given name, or the default one if the name is empty.
+const PacketIsa& find_packet_isa(std::string_view name);
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef _XENODON_RENDER_CPU_SIMD_H
+#define _XENODON_RENDER_CPU_SIMD_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <x86intrin.h>
+#include "render/cpu/CpuRenderAlgorithm.h"
+#include "render/cpu/RayPacket.h"
+#include "math/Vec.h"
+
+// Vectors of one lane per ray of a packet, in terms of the vector extensions of gcc and clang. These are only used
+// by the packet kernels, which are compiled for their instruction set with __attribute__((target(...), flatten)).
+// The functions below are inlined into the kernels, so the ABI of passing vectors by value, which differs between
+// instruction sets, does not matter (gcc still warns about it, see meson.build).
+//
+// The operations mirror those of the scalar traversal functions (including std::min and std::max for NaN), so that
+// rays traced in packets give the same colors as rays traced one by one.
+namespace simd {
+    template <size_t N>
+    struct Lanes;
+
+    template <>
+    struct Lanes<8> {
+        typedef float Float __attribute__((vector_size(32)));
+        typedef int32_t Int __attribute__((vector_size(32)));
+    };
+
+    template <>
+    struct Lanes<16> {
+        typedef float Float __attribute__((vector_size(64)));
+        typedef int32_t Int __attribute__((vector_size(64)));
+    };
+
+    template <size_t N>
+    using Float = typename Lanes<N>::Float;
+
+    // Comparisons yield an Int of which each lane is either 0 or -1, which is used as mask.
+    template <size_t N>
+    using Int = typename Lanes<N>::Int;
+
+    template <typename V>
+    constexpr const size_t LANES = sizeof(V) / sizeof(int32_t);
+
+    template <typename V>
+    using Mask = decltype(V{} < V{});
+
+    template <typename V, typename T>
+    V broadcast(T x) {
+        V v;
+        for (size_t i = 0; i < LANES<V>; ++i) {
+            v[i] = x;
+        }
+
+        return v;
+    }
+
+    // Lanes are copied from and to arrays, rather than indexed directly, when many of them are used
+    // one by one, as indexing a vector with a variable is slow.
+    template <typename V, typename T>
+    V load(const std::array<T, LANES<V>>& values) {
+        V v;
+        std::memcpy(&v, values.data(), sizeof v);
+        return v;
+    }
+
+    template <typename V, typename T>
+    void store(std::array<T, LANES<V>>& values, const V& v) {
+        std::memcpy(values.data(), &v, sizeof v);
+    }
+
+    // Gather one component of the ray directions of a packet.
+    template <typename V>
+    V load_component(const std::array<Vec3F, RayPacket::MAX_SIZE>& v, size_t axis) {
+        V result;
+        for (size_t i = 0; i < LANES<V>; ++i) {
+            result[i] = v[i][axis];
+        }
+
+        return result;
+    }
+
+    // The lanes of a mask as bits, of which the lowest is the first lane.
+    __attribute__((target("avx2")))
+    inline uint32_t bitmask(const Int<8>& mask) {
+        return static_cast<uint32_t>(_mm256_movemask_ps(reinterpret_cast<__m256>(mask)));
+    }
+
+    __attribute__((target("avx512f")))
+    inline uint32_t bitmask(const Int<16>& mask) {
+        return _mm512_cmplt_epi32_mask(reinterpret_cast<__m512i>(mask), _mm512_setzero_si512());
+    }
+
+    template <typename V>
+    bool any(const V& mask) {
+        return bitmask(mask) != 0;
+    }
+
+    template <typename V>
+    V select(const Mask<V>& mask, const V& a, const V& b) {
+        using M = Mask<V>;
+        return reinterpret_cast<V>((reinterpret_cast<M>(a) & mask) | (reinterpret_cast<M>(b) & ~mask));
+    }
+
+    // See std::min
+    template <typename V>
+    V min(const V& a, const V& b) {
+        return select<V>(b < a, b, a);
+    }
+
+    // See std::max
+    template <typename V>
+    V max(const V& a, const V& b) {
+        return select<V>(a < b, b, a);
+    }
+
+    template <typename V>
+    V min_elem(const std::array<V, 3>& v) {
+        return min(v[0], min(v[1], v[2]));
+    }
+
+    template <typename V>
+    V max_elem(const std::array<V, 3>& v) {
+        return max(v[0], max(v[1], v[2]));
+    }
+
+    template <typename V>
+    V abs(const V& v) {
+        using M = Mask<V>;
+        return reinterpret_cast<V>(reinterpret_cast<M>(v) & broadcast<M>(0x7FFFFFFF));
+    }
+
+    // Convert to integers rounding towards zero, as static_cast<int> does.
+    template <typename V>
+    Mask<V> truncate(const V& v) {
+        return __builtin_convertvector(v, Mask<V>);
+    }
+
+    // Convert to integers rounding towards negative infinity, as static_cast<int>(std::floor(x)) does.
+    template <typename V>
+    Mask<V> floor(const V& v) {
+        const auto i = truncate(v);
+        return i + (__builtin_convertvector(i, V) > v);
+    }
+
+    template <typename V>
+    V to_float(const Mask<V>& v) {
+        return __builtin_convertvector(v, V);
+    }
+
+    // See TraceContext::accumulate. Only the lanes of `mask` are updated, and the mask of the lanes
+    // which became saturated is returned.
+    template <typename V>
+    Mask<V> accumulate(
+        const TraceContext& ctx,
+        std::array<V, 3>& total,
+        V& transmittance,
+        const std::array<V, 4>& voxel,
+        const V& dt,
+        const V& absorption,
+        const Mask<V>& mask
+    ) {
+        const auto zero = V{};
+
+        if (ctx.params.composite == 0) {
+            for (size_t i = 0; i < 3; ++i) {
+                total[i] += select<V>(mask, voxel[i] * dt, zero);
+            }
+
+            return Mask<V>{};
+        }
+
+        const V sigma = voxel[3] * absorption;
+        const V exponent = -sigma * dt;
+
+        // There is no vector exp, so only the lanes that are used are computed
+        V segment_transmittance = broadcast<V>(1.f);
+        for (uint32_t bits = bitmask(mask); bits != 0; bits &= bits - 1) {
+            const int lane = __builtin_ctz(bits);
+            segment_transmittance[lane] = std::exp(exponent[lane]);
+        }
+
+        const V weight = select<V>(sigma > zero, (1.f - segment_transmittance) / sigma, dt);
+
+        for (size_t i = 0; i < 3; ++i) {
+            total[i] += select<V>(mask, voxel[i] * (transmittance * weight), zero);
+        }
+
+        transmittance = select<V>(mask, transmittance * segment_transmittance, transmittance);
+        return mask & (transmittance < ctx.params.termination_threshold);
+    }
+}
+
+#endif
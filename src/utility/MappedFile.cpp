@@ -0,0 +1,64 @@
+#include "utility/MappedFile.h"
+#include <utility>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "core/Error.h"
+
+MappedFile::MappedFile():
+    ptr(nullptr), length(0) {
+}
+
+MappedFile::MappedFile(const std::filesystem::path& path):
+    ptr(nullptr), length(0) {
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw Error("Failed to open: {} (code {})", strerror(errno), errno);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == -1) {
+        int err = errno;
+        close(fd);
+        throw Error("Failed to stat: {} (code {})", strerror(err), err);
+    }
+
+    this->length = static_cast<size_t>(info.st_size);
+
+    // Mapping an empty file is not allowed, so leave the mapping empty
+    if (this->length > 0) {
+        void* ptr = mmap(nullptr, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) {
+            int err = errno;
+            close(fd);
+            throw Error("Failed to map: {} (code {})", strerror(err), err);
+        }
+
+        this->ptr = ptr;
+    }
+
+    // The mapping remains valid after the file descriptor is closed
+    close(fd);
+}
+
+MappedFile::MappedFile(MappedFile&& other):
+    ptr(other.ptr), length(other.length) {
+    other.ptr = nullptr;
+    other.length = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+    std::swap(this->ptr, other.ptr);
+    std::swap(this->length, other.length);
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    if (this->ptr != nullptr) {
+        munmap(this->ptr, this->length);
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef _XENODON_UTILITY_MAPPEDFILE_H
+#define _XENODON_UTILITY_MAPPEDFILE_H
+
+#include <filesystem>
+#include <cstddef>
+#include <cstdint>
+
+// A read-only, private memory mapping of an entire file. Pages are only read from disk
+// when they are first accessed.
+class MappedFile {
+    void* ptr;
+    size_t length;
+
+public:
+    MappedFile();
+    explicit MappedFile(const std::filesystem::path& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other);
+    MappedFile& operator=(MappedFile&& other);
+
+    ~MappedFile();
+
+    const uint8_t* data() const {
+        return static_cast<const uint8_t*>(this->ptr);
+    }
+
+    size_t size() const {
+        return this->length;
+    }
+
+    explicit operator bool() const {
+        return this->ptr != nullptr;
+    }
+};
+
+#endif
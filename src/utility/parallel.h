@@ -0,0 +1,74 @@
+#ifndef _XENODON_UTILITY_PARALLEL_H
+#define _XENODON_UTILITY_PARALLEL_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+#include <cstddef>
+
+inline size_t hardware_threads() {
+    return std::max(size_t{1}, static_cast<size_t>(std::thread::hardware_concurrency()));
+}
+
+// Call f(i) for every i in [0, n), using at most `threads` threads (including the calling thread).
+// Indices are handed out one by one, so the work per index does not need to be balanced.
+// If any invocation throws, the remaining indices are skipped and the first exception is
+// rethrown on the calling thread.
+template <typename F>
+void parallel_for(size_t threads, size_t n, F f) {
+    threads = std::min(std::max(threads, size_t{1}), n);
+
+    if (threads <= 1) {
+        for (size_t i = 0; i < n; ++i) {
+            f(i);
+        }
+
+        return;
+    }
+
+    auto next = std::atomic<size_t>(0);
+    auto error = std::exception_ptr();
+    auto error_mutex = std::mutex();
+
+    auto worker = [&] {
+        while (true) {
+            const size_t i = next++;
+            if (i >= n) {
+                return;
+            }
+
+            try {
+                f(i);
+            } catch (...) {
+                auto lock = std::lock_guard(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+
+                next = n;
+            }
+        }
+    };
+
+    auto workers = std::vector<std::thread>();
+    workers.reserve(threads - 1);
+
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back(worker);
+    }
+
+    worker();
+
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+#endif
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+
+# Renders the test volume from each pose of the test camera file with the headless backend,
+# and compares the frames against the reference images in tests/reference.
+# With --update, the reference images are rendered instead, with the headless backend, or with
+# the cpu backend if --cpu is also given. The cpu backend implements every shader independently
+# of Vulkan, and so does not require a GPU.
+#
+# The tolerances were chosen by rendering the references with the cpu backend built with fused
+# multiply-adds and with -ffast-math, and with every camera pose perturbed by up to 1e-5, which
+# are the kinds of rounding differences a GPU introduces. The largest difference of a channel was
+# 3, in 3 pixels, and the lowest PSNR 70 dB. A tolerance of 4 stays below the smallest color
+# difference of neighboring voxels of the test volume (6), so a ray which ends in the wrong voxel
+# still fails the test.
+
+import os
+import sys
+import argparse
+import subprocess
+
+TOLERANCE = 4
+MIN_PSNR = 60
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--xenodon', required=True, help='Path to the xenodon binary')
+parser.add_argument('--volume', required=True, help='Volume to render')
+parser.add_argument('--camera', required=True, help='Camera file with the poses to render')
+parser.add_argument('--headless-config', required=True, help='Headless config of the device to render on')
+parser.add_argument('--shader', required=True)
+parser.add_argument('--voxel-ratio', required=True)
+parser.add_argument('--reference', required=True, help='Output path format of the reference images')
+parser.add_argument('--output-dir', required=True, help='Directory to save the rendered frames in')
+parser.add_argument('--update', action='store_true', help='Render the reference images instead')
+parser.add_argument('--cpu', action='store_true', help='Render the reference images with the cpu backend')
+args = parser.parse_args()
+
+name = os.path.basename(args.reference)
+output = os.path.join(args.output_dir, name)
+
+if args.update and args.cpu:
+    backend = ['--cpu', '64x64']
+else:
+    backend = ['--headless', args.headless_config, '--no-pipeline-cache']
+
+if args.update:
+    output = args.reference
+
+os.makedirs(os.path.dirname(os.path.abspath(output)), exist_ok=True)
+
+render = subprocess.run([
+    args.xenodon, 'render', args.volume,
+    *backend,
+    '--camera', args.camera,
+    '--shader', args.shader,
+    '--voxel-ratio', args.voxel_ratio,
+    '--output', output,
+])
+
+if render.returncode != 0 or args.update:
+    sys.exit(render.returncode)
+
+compare = subprocess.run([
+    args.xenodon, 'compare',
+    '--tolerance', str(TOLERANCE),
+    '--min-psnr', str(MIN_PSNR),
+    args.reference, output,
+])
+sys.exit(compare.returncode)
@@ -0,0 +1,38 @@
+#!/usr/bin/env python3
+
+# Generates the small volume rendered by the render tests in tests/.
+# Usage: make-test-volume.py <output vol>
+# The volume is a 16x16x16 RGBA8 grid in the raw volume format (see Grid::save_volume),
+# containing a spherical shell around an empty cavity, and a solid block in a corner which
+# is partly outside the shell. The shell is colored by position, so that rays which
+# enter different voxels or nodes produce different colors.
+
+import math
+import struct
+import sys
+
+DIM = 16
+DATA_ALIGNMENT = 4096
+FORMAT_RGBA8 = 0
+
+def voxel(x, y, z):
+    if x >= 11 and y < 5 and z < 6:
+        return (200, 120, 40, 255)
+
+    r = math.sqrt((x + 0.5 - 8) ** 2 + (y + 0.5 - 8) ** 2 + (z + 0.5 - 8) ** 2)
+    if 3 < r < 7:
+        return (60 + x * 8, 40 + y * 6, 150 - z * 6, 255)
+
+    return (0, 0, 0, 0)
+
+header = b'XNDN-VOL' + struct.pack('<QQQIIQ', DIM, DIM, DIM, FORMAT_RGBA8, 0, DATA_ALIGNMENT)
+data = bytearray(header)
+data += bytes(DATA_ALIGNMENT - len(header))
+
+for z in range(DIM):
+    for y in range(DIM):
+        for x in range(DIM):
+            data += bytes(voxel(x, y, z))
+
+with open(sys.argv[1], 'wb') as f:
+    f.write(data)